@@ -16,15 +16,16 @@ static unsigned int instructionCountBreakpoint = 0;
 static bool bHitMemBreakpoint = false;
 static bool bHitPPUBreakpoint = false;
 
+// the trace follows the machine on the calling thread, batch runs step several at once
 #define NUM_TRACED 500
-static cpu_instr_history traceHistory[NUM_TRACED] = { 0 };
-static unsigned int traceNum;
-static unsigned int traceCount = 0;
-static unsigned int cpuInstructionCount = 0;
+static thread_local cpu_instr_history traceHistory[NUM_TRACED] = { 0 };
+static thread_local unsigned int traceNum;
+static thread_local unsigned int traceCount = 0;
+static thread_local unsigned int cpuInstructionCount = 0;
 void HitBreakpoint();
 void IllegalInstruction();
 void Do_PPUBreakpoint();
-static int traceLineRemaining = 0;
+static thread_local int traceLineRemaining = 0;
 #endif
 
 // the low 5 bits of the opcode determines the addressing mode with only 5 instruction exceptions (noted)
@@ -93,650 +94,661 @@ void cpu_6502::resolveFromP() {
 	mainCPU.carryResult = (mainCPU.P & ST_CRY);
 }
 
-FORCE_INLINE void writeAddr(unsigned int addr, unsigned int result) {
-	mainCPU.write(addr, result);
-
 #if TRACE_DEBUG
-	if (addr == memWriteBreakpoint) {
-		bHitMemBreakpoint = true;
-	}
+static thread_local unsigned int effAddr = -1;
+static thread_local unsigned int effByte = 0;
 #endif
-}
 
-FORCE_INLINE void latchWriteAddr(unsigned int addr, unsigned int result) {
-	mainCPU.accessTable[addr >> 13] = addr;
-	writeAddr(addr, result);
-}
+// The instruction helpers are members so the core reaches the machine through the pointer cpu6502_Step loads once (the
+// machine names resolve to the member here) instead of through thread local storage on every access. The calculator
+// has no pointer, its machine is at a fixed address
+struct cpu6502_exec {
+#if NES_MULTI_MACHINE
+	nes_machine* const nesCurrentMachine;
+#endif
 
-FORCE_INLINE void writeZero(unsigned int addr, unsigned int result) {
-	CPU_RAM(addr) = result;
+	FORCE_INLINE void writeAddr(unsigned int addr, unsigned int result) {
+		mainCPU.write(addr, result);
 
 #if TRACE_DEBUG
-	if (addr == memWriteBreakpoint) {
-		bHitMemBreakpoint = true;
-	}
+		if (addr == memWriteBreakpoint) {
+			bHitMemBreakpoint = true;
+		}
 #endif
-}
+	}
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// STORE / LOAD
+	FORCE_INLINE void latchWriteAddr(unsigned int addr, unsigned int result) {
+		mainCPU.accessTable[addr >> 13] = addr;
+		writeAddr(addr, result);
+	}
 
-// LDA #$NN (load A immediate)
-FORCE_INLINE void LDA(unsigned int data) {
-	mainCPU.A = data;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+	FORCE_INLINE void writeZero(unsigned int addr, unsigned int result) {
+		CPU_RAM(addr) = result;
 
-FORCE_INLINE void LDA_MEM(unsigned int address) {
-	LDA(mainCPU.read(address));
-}
+#if TRACE_DEBUG
+		if (addr == memWriteBreakpoint) {
+			bHitMemBreakpoint = true;
+		}
+#endif
+	}
 
-FORCE_INLINE void LDA_ZERO(unsigned int address) {
-	LDA(CPU_RAM(address));
-}
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// STORE / LOAD
 
-FORCE_INLINE void LDX(unsigned int data) {
-	mainCPU.X = data;
-	mainCPU.zeroResult = mainCPU.X;
-	mainCPU.negativeResult = mainCPU.X;
-}
+	// LDA #$NN (load A immediate)
+	FORCE_INLINE void LDA(unsigned int data) {
+		mainCPU.A = data;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-FORCE_INLINE void LDX_MEM(unsigned int address) {
-	LDX(mainCPU.read(address));
-}
+	FORCE_INLINE void LDA_MEM(unsigned int address) {
+		LDA(mainCPU.read(address));
+	}
 
-FORCE_INLINE void LDX_ZERO(unsigned int address) {
-	LDX(CPU_RAM(address));
-}
+	FORCE_INLINE void LDA_ZERO(unsigned int address) {
+		LDA(CPU_RAM(address));
+	}
 
-FORCE_INLINE void LDY(unsigned int data) {
-	mainCPU.Y = data;
-	mainCPU.zeroResult = mainCPU.Y;
-	mainCPU.negativeResult = mainCPU.Y;
-}
+	FORCE_INLINE void LDX(unsigned int data) {
+		mainCPU.X = data;
+		mainCPU.zeroResult = mainCPU.X;
+		mainCPU.negativeResult = mainCPU.X;
+	}
 
-FORCE_INLINE void LDY_MEM(unsigned int address) {
-	LDY(mainCPU.read(address));
-}
+	FORCE_INLINE void LDX_MEM(unsigned int address) {
+		LDX(mainCPU.read(address));
+	}
 
-FORCE_INLINE void LDY_ZERO(unsigned int address) {
-	LDY(CPU_RAM(address));
-}
+	FORCE_INLINE void LDX_ZERO(unsigned int address) {
+		LDX(CPU_RAM(address));
+	}
 
-FORCE_INLINE void STA_MEM(unsigned int address) {
-	latchWriteAddr(address, mainCPU.A);
-}
+	FORCE_INLINE void LDY(unsigned int data) {
+		mainCPU.Y = data;
+		mainCPU.zeroResult = mainCPU.Y;
+		mainCPU.negativeResult = mainCPU.Y;
+	}
 
-FORCE_INLINE void STA_ZERO(unsigned int address) {
-	writeZero(address, mainCPU.A);
-}
+	FORCE_INLINE void LDY_MEM(unsigned int address) {
+		LDY(mainCPU.read(address));
+	}
 
-FORCE_INLINE void STX_MEM(unsigned int address) {
-	latchWriteAddr(address, mainCPU.X);
-}
+	FORCE_INLINE void LDY_ZERO(unsigned int address) {
+		LDY(CPU_RAM(address));
+	}
 
-FORCE_INLINE void STX_ZERO(unsigned int address) {
-	writeZero(address, mainCPU.X);
-}
+	FORCE_INLINE void STA_MEM(unsigned int address) {
+		latchWriteAddr(address, mainCPU.A);
+	}
 
-FORCE_INLINE void STY_MEM(unsigned int address) {
-	latchWriteAddr(address, mainCPU.Y);
-}
+	FORCE_INLINE void STA_ZERO(unsigned int address) {
+		writeZero(address, mainCPU.A);
+	}
 
-FORCE_INLINE void STY_ZERO(unsigned int address) {
-	writeZero(address, mainCPU.Y);
-}
+	FORCE_INLINE void STX_MEM(unsigned int address) {
+		latchWriteAddr(address, mainCPU.X);
+	}
 
-FORCE_INLINE void TAX() {
-	mainCPU.X = mainCPU.A;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+	FORCE_INLINE void STX_ZERO(unsigned int address) {
+		writeZero(address, mainCPU.X);
+	}
 
-FORCE_INLINE void TXA() {
-	mainCPU.A = mainCPU.X;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+	FORCE_INLINE void STY_MEM(unsigned int address) {
+		latchWriteAddr(address, mainCPU.Y);
+	}
 
-FORCE_INLINE void TAY() {
-	mainCPU.Y = mainCPU.A;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+	FORCE_INLINE void STY_ZERO(unsigned int address) {
+		writeZero(address, mainCPU.Y);
+	}
 
-FORCE_INLINE void TYA() {
-	mainCPU.A = mainCPU.Y;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+	FORCE_INLINE void TAX() {
+		mainCPU.X = mainCPU.A;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-FORCE_INLINE void TSX() {
-	mainCPU.X = mainCPU.SP;
-	mainCPU.zeroResult = mainCPU.X;
-	mainCPU.negativeResult = mainCPU.X;
-}
+	FORCE_INLINE void TXA() {
+		mainCPU.A = mainCPU.X;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-FORCE_INLINE void TXS() {
-	mainCPU.SP = mainCPU.X;
-}
+	FORCE_INLINE void TAY() {
+		mainCPU.Y = mainCPU.A;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-FORCE_INLINE void PHA() {
-	mainCPU.push(mainCPU.A);
-}
+	FORCE_INLINE void TYA() {
+		mainCPU.A = mainCPU.Y;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-FORCE_INLINE void PLA() {
-	mainCPU.A = mainCPU.pop();
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+	FORCE_INLINE void TSX() {
+		mainCPU.X = mainCPU.SP;
+		mainCPU.zeroResult = mainCPU.X;
+		mainCPU.negativeResult = mainCPU.X;
+	}
 
-FORCE_INLINE void PHP() {
-	mainCPU.resolveToP();
-	mainCPU.push(mainCPU.P | ST_UNUSED | ST_BRK);
-}
+	FORCE_INLINE void TXS() {
+		mainCPU.SP = mainCPU.X;
+	}
 
-// PLP (pop processor status ignoring bit 4)
-FORCE_INLINE void PLP() {
-	mainCPU.P = mainCPU.pop() & ~(ST_BRK);
-	mainCPU.resolveFromP();
-}
+	FORCE_INLINE void PHA() {
+		mainCPU.push(mainCPU.A);
+	}
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// BRANCH / JUMP
+	FORCE_INLINE void PLA() {
+		mainCPU.A = mainCPU.pop();
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-FORCE_INLINE void takeBranch(unsigned int data) {
-	unsigned int oldPC = mainCPU.PC;
-	mainCPU.PC += (char) (data);
-	mainCPU.clocks++;
-	if ((oldPC ^ mainCPU.PC) & 0x100) mainCPU.clocks++;
-}
+	FORCE_INLINE void PHP() {
+		mainCPU.resolveToP();
+		mainCPU.push(mainCPU.P | ST_UNUSED | ST_BRK);
+	}
 
-FORCE_INLINE void BPL(unsigned int data) {
-	if (!(mainCPU.negativeResult & ST_NEG)) {
-		takeBranch(data);
+	// PLP (pop processor status ignoring bit 4)
+	FORCE_INLINE void PLP() {
+		mainCPU.P = mainCPU.pop() & ~(ST_BRK);
+		mainCPU.resolveFromP();
 	}
-}
 
-FORCE_INLINE void BMI(unsigned int data) {
-	if (mainCPU.negativeResult & ST_NEG) {
-		takeBranch(data);
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// BRANCH / JUMP
+
+	FORCE_INLINE void takeBranch(unsigned int data) {
+		unsigned int oldPC = mainCPU.PC;
+		mainCPU.PC += (char) (data);
+		mainCPU.clocks++;
+		if ((oldPC ^ mainCPU.PC) & 0x100) mainCPU.clocks++;
 	}
-}
 
-FORCE_INLINE void BVC(unsigned int data) {
-	if (!(mainCPU.P & ST_OVR)) {
-		takeBranch(data);
+	FORCE_INLINE void BPL(unsigned int data) {
+		if (!(mainCPU.negativeResult & ST_NEG)) {
+			takeBranch(data);
+		}
 	}
-}
 
-FORCE_INLINE void BVS(unsigned int data) {
-	if (mainCPU.P & ST_OVR) {
-		takeBranch(data);
+	FORCE_INLINE void BMI(unsigned int data) {
+		if (mainCPU.negativeResult & ST_NEG) {
+			takeBranch(data);
+		}
 	}
-}
 
-FORCE_INLINE void BCC(unsigned int data) {
-	if (mainCPU.carryResult == 0) {
-		takeBranch(data);
+	FORCE_INLINE void BVC(unsigned int data) {
+		if (!(mainCPU.P & ST_OVR)) {
+			takeBranch(data);
+		}
 	}
-}
 
-FORCE_INLINE void BCS(unsigned int data) {
-	if (mainCPU.carryResult) {
-		takeBranch(data);
+	FORCE_INLINE void BVS(unsigned int data) {
+		if (mainCPU.P & ST_OVR) {
+			takeBranch(data);
+		}
 	}
-}
 
-FORCE_INLINE void BNE(unsigned int data) {
-	if (mainCPU.zeroResult) {
-		takeBranch(data);
+	FORCE_INLINE void BCC(unsigned int data) {
+		if (mainCPU.carryResult == 0) {
+			takeBranch(data);
+		}
 	}
-}
 
-FORCE_INLINE void BEQ(unsigned int data) {
-	if (!mainCPU.zeroResult) {
-		takeBranch(data);
+	FORCE_INLINE void BCS(unsigned int data) {
+		if (mainCPU.carryResult) {
+			takeBranch(data);
+		}
 	}
-}
 
-FORCE_INLINE void JMP_MEM(unsigned int addr) {
-	// common infinite loop
-	if (mainCPU.PC == addr + 3) {
-		// skip ahead until next interrupt
-		for (; mainCPU.clocks < mainCPU.nextClocks;) {
-			mainCPU.clocks += 3;
+	FORCE_INLINE void BNE(unsigned int data) {
+		if (mainCPU.zeroResult) {
+			takeBranch(data);
 		}
 	}
 
-	mainCPU.PC = addr;
-}
+	FORCE_INLINE void BEQ(unsigned int data) {
+		if (!mainCPU.zeroResult) {
+			takeBranch(data);
+		}
+	}
 
-FORCE_INLINE void JSR_MEM(unsigned int addr) {
-	// JSR (subroutine)
-	mainCPU.PC--;
-	mainCPU.push(mainCPU.PC >> 8);
-	mainCPU.push(mainCPU.PC & 0xFF);
+	FORCE_INLINE void JMP_MEM(unsigned int addr) {
+		// common infinite loop
+		if (mainCPU.PC == addr + 3) {
+			// skip ahead until next interrupt
+			for (; mainCPU.clocks < mainCPU.nextClocks;) {
+				mainCPU.clocks += 3;
+			}
+		}
 
-	mainCPU.PC = addr;
-}
+		mainCPU.PC = addr;
+	}
 
-FORCE_INLINE void RTI() {
-	// RTI (return from interrupt)
-	// TODO : Non- delayed IRQ response behavior?
-	mainCPU.P = mainCPU.pop() & ~(ST_BRK);
-	mainCPU.PC = mainCPU.pop() | (mainCPU.pop() << 8);
-	mainCPU.resolveFromP();
-}
-			
-FORCE_INLINE void RTS() {
-	// RTS
-	mainCPU.PC = mainCPU.pop() | (mainCPU.pop() << 8);
-	mainCPU.PC++;
-}
+	FORCE_INLINE void JSR_MEM(unsigned int addr) {
+		// JSR (subroutine)
+		mainCPU.PC--;
+		mainCPU.push(mainCPU.PC >> 8);
+		mainCPU.push(mainCPU.PC & 0xFF);
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// ALU
-
-FORCE_INLINE void ADC(unsigned int data) {
-	unsigned int result = mainCPU.A + data + mainCPU.carryResult;
-	mainCPU.P =
-		(mainCPU.P & (ST_INT | ST_BRK | ST_BCD | ST_UNUSED)) |					// keep flags
-		(((mainCPU.A^result)&(data^result) & 0x80) >> (7 - ST_OVR_BIT));		// overflow (http://www.righto.com/2012/12/the-6502-overflow-flag-explained.html)
-	mainCPU.A = result & 0xFF;
-	mainCPU.carryResult = result >> 8;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+		mainCPU.PC = addr;
+	}
 
-FORCE_INLINE void ADC_MEM(unsigned int address) {
-	ADC(mainCPU.read(address));
-}
+	FORCE_INLINE void RTI() {
+		// RTI (return from interrupt)
+		// TODO : Non- delayed IRQ response behavior?
+		mainCPU.P = mainCPU.pop() & ~(ST_BRK);
+		mainCPU.PC = mainCPU.pop() | (mainCPU.pop() << 8);
+		mainCPU.resolveFromP();
+	}
+				
+	FORCE_INLINE void RTS() {
+		// RTS
+		mainCPU.PC = mainCPU.pop() | (mainCPU.pop() << 8);
+		mainCPU.PC++;
+	}
 
-FORCE_INLINE void ADC_ZERO(unsigned int address) {
-	ADC(CPU_RAM(address));
-}
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// ALU
+
+	FORCE_INLINE void ADC(unsigned int data) {
+		unsigned int result = mainCPU.A + data + mainCPU.carryResult;
+		mainCPU.P =
+			(mainCPU.P & (ST_INT | ST_BRK | ST_BCD | ST_UNUSED)) |					// keep flags
+			(((mainCPU.A^result)&(data^result) & 0x80) >> (7 - ST_OVR_BIT));		// overflow (http://www.righto.com/2012/12/the-6502-overflow-flag-explained.html)
+		mainCPU.A = result & 0xFF;
+		mainCPU.carryResult = result >> 8;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-FORCE_INLINE void SBC(unsigned int data) {
-	// TODO : possibly move overflow calculation to flag resolve?
-	unsigned int result = mainCPU.A - data - 1 + mainCPU.carryResult;
-	mainCPU.P =
-		(mainCPU.P & (ST_INT | ST_BRK | ST_BCD | ST_UNUSED)) |					// keep flags
-		(((mainCPU.A^result)&((~(data)) ^ result) & 0x80) >> (7 - ST_OVR_BIT));	// overflow (http://www.righto.com/2012/12/the-6502-overflow-flag-explained.html)
-	mainCPU.A = result & 0xFF;
-	mainCPU.carryResult = (~result & 0x100) >> 8;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+	FORCE_INLINE void ADC_MEM(unsigned int address) {
+		ADC(mainCPU.read(address));
+	}
 
-FORCE_INLINE void SBC_MEM(unsigned int address) {
-	SBC(mainCPU.read(address));
-}
+	FORCE_INLINE void ADC_ZERO(unsigned int address) {
+		ADC(CPU_RAM(address));
+	}
 
-FORCE_INLINE void SBC_ZERO(unsigned int address) {
-	SBC(CPU_RAM(address));
-}
+	FORCE_INLINE void SBC(unsigned int data) {
+		// TODO : possibly move overflow calculation to flag resolve?
+		unsigned int result = mainCPU.A - data - 1 + mainCPU.carryResult;
+		mainCPU.P =
+			(mainCPU.P & (ST_INT | ST_BRK | ST_BCD | ST_UNUSED)) |					// keep flags
+			(((mainCPU.A^result)&((~(data)) ^ result) & 0x80) >> (7 - ST_OVR_BIT));	// overflow (http://www.righto.com/2012/12/the-6502-overflow-flag-explained.html)
+		mainCPU.A = result & 0xFF;
+		mainCPU.carryResult = (~result & 0x100) >> 8;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-FORCE_INLINE void DEC_MEM(unsigned int address) {
-	unsigned int result = (mainCPU.readNonIO(address) - 1) & 0xFF;
-	mainCPU.zeroResult = result;
-	mainCPU.negativeResult = result;
-	writeAddr(address, result);
-}
+	FORCE_INLINE void SBC_MEM(unsigned int address) {
+		SBC(mainCPU.read(address));
+	}
 
-FORCE_INLINE void DEC_ZERO(unsigned int address) {
-	unsigned int result = (CPU_RAM(address) - 1) & 0xFF;
-	mainCPU.zeroResult = result;
-	mainCPU.negativeResult = result;
-	writeZero(address, result);
-}
+	FORCE_INLINE void SBC_ZERO(unsigned int address) {
+		SBC(CPU_RAM(address));
+	}
 
-FORCE_INLINE void INC_MEM(unsigned int address) {
-	unsigned int result = (mainCPU.readNonIO(address) + 1) & 0xFF;
-	mainCPU.zeroResult = result;
-	mainCPU.negativeResult = result;
-	writeAddr(address, result);
-}
+	FORCE_INLINE void DEC_MEM(unsigned int address) {
+		unsigned int result = (mainCPU.readNonIO(address) - 1) & 0xFF;
+		mainCPU.zeroResult = result;
+		mainCPU.negativeResult = result;
+		writeAddr(address, result);
+	}
 
-FORCE_INLINE void INC_ZERO(unsigned int address) {
-	unsigned int result = (CPU_RAM(address) + 1) & 0xFF;
-	mainCPU.zeroResult = result;
-	mainCPU.negativeResult = result;
-	writeZero(address, result);
-}
+	FORCE_INLINE void DEC_ZERO(unsigned int address) {
+		unsigned int result = (CPU_RAM(address) - 1) & 0xFF;
+		mainCPU.zeroResult = result;
+		mainCPU.negativeResult = result;
+		writeZero(address, result);
+	}
 
-FORCE_INLINE void DEX() {
-	// DEX (decrement X)
-	mainCPU.X = (mainCPU.X - 1) & 0xFF;
-	mainCPU.zeroResult = mainCPU.X;
-	mainCPU.negativeResult = mainCPU.X;
-}
+	FORCE_INLINE void INC_MEM(unsigned int address) {
+		unsigned int result = (mainCPU.readNonIO(address) + 1) & 0xFF;
+		mainCPU.zeroResult = result;
+		mainCPU.negativeResult = result;
+		writeAddr(address, result);
+	}
 
-FORCE_INLINE void INX() {
-	// INX (increment X)
-	mainCPU.X = (mainCPU.X + 1) & 0xFF;
-	mainCPU.zeroResult = mainCPU.X;
-	mainCPU.negativeResult = mainCPU.X;
-}
+	FORCE_INLINE void INC_ZERO(unsigned int address) {
+		unsigned int result = (CPU_RAM(address) + 1) & 0xFF;
+		mainCPU.zeroResult = result;
+		mainCPU.negativeResult = result;
+		writeZero(address, result);
+	}
 
-FORCE_INLINE void DEY() {
-	// DEY (decrement Y)
-	mainCPU.Y = (mainCPU.Y - 1) & 0xFF;
-	mainCPU.zeroResult = mainCPU.Y;
-	mainCPU.negativeResult = mainCPU.Y;
-}
+	FORCE_INLINE void DEX() {
+		// DEX (decrement X)
+		mainCPU.X = (mainCPU.X - 1) & 0xFF;
+		mainCPU.zeroResult = mainCPU.X;
+		mainCPU.negativeResult = mainCPU.X;
+	}
 
-FORCE_INLINE void INY() {
-	// INY (increment Y)
-	mainCPU.Y = (mainCPU.Y + 1) & 0xFF;
-	mainCPU.zeroResult = mainCPU.Y;
-	mainCPU.negativeResult = mainCPU.Y;
-}
+	FORCE_INLINE void INX() {
+		// INX (increment X)
+		mainCPU.X = (mainCPU.X + 1) & 0xFF;
+		mainCPU.zeroResult = mainCPU.X;
+		mainCPU.negativeResult = mainCPU.X;
+	}
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// COMPARE / TEST
+	FORCE_INLINE void DEY() {
+		// DEY (decrement Y)
+		mainCPU.Y = (mainCPU.Y - 1) & 0xFF;
+		mainCPU.zeroResult = mainCPU.Y;
+		mainCPU.negativeResult = mainCPU.Y;
+	}
 
-FORCE_INLINE void CMP(unsigned int data) {
-	mainCPU.carryResult = (data <= mainCPU.A) ? 1 : 0;
-	mainCPU.zeroResult = (mainCPU.A - data);
-	mainCPU.negativeResult = mainCPU.zeroResult;
-}
+	FORCE_INLINE void INY() {
+		// INY (increment Y)
+		mainCPU.Y = (mainCPU.Y + 1) & 0xFF;
+		mainCPU.zeroResult = mainCPU.Y;
+		mainCPU.negativeResult = mainCPU.Y;
+	}
 
-FORCE_INLINE void CMP_MEM(unsigned int addr) {
-	CMP(mainCPU.read(addr));
-}
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// COMPARE / TEST
 
-FORCE_INLINE void CMP_ZERO(unsigned int addr) {
-	CMP(CPU_RAM(addr));
-}
+	FORCE_INLINE void CMP(unsigned int data) {
+		mainCPU.carryResult = (data <= mainCPU.A) ? 1 : 0;
+		mainCPU.zeroResult = (mainCPU.A - data);
+		mainCPU.negativeResult = mainCPU.zeroResult;
+	}
 
-FORCE_INLINE void CPX(unsigned int data) {
-	mainCPU.carryResult = (data <= mainCPU.X) ? 1 : 0;
-	mainCPU.zeroResult = (mainCPU.X - data);
-	mainCPU.negativeResult = mainCPU.zeroResult;
-}
+	FORCE_INLINE void CMP_MEM(unsigned int addr) {
+		CMP(mainCPU.read(addr));
+	}
 
-FORCE_INLINE void CPX_MEM(unsigned int addr) {
-	CPX(mainCPU.read(addr));
-}
+	FORCE_INLINE void CMP_ZERO(unsigned int addr) {
+		CMP(CPU_RAM(addr));
+	}
 
-FORCE_INLINE void CPX_ZERO(unsigned int addr) {
-	CPX(CPU_RAM(addr));
-}
+	FORCE_INLINE void CPX(unsigned int data) {
+		mainCPU.carryResult = (data <= mainCPU.X) ? 1 : 0;
+		mainCPU.zeroResult = (mainCPU.X - data);
+		mainCPU.negativeResult = mainCPU.zeroResult;
+	}
 
-FORCE_INLINE void CPY(unsigned int data) {
-	mainCPU.carryResult = (data <= mainCPU.Y) ? 1 : 0;
-	mainCPU.zeroResult = (mainCPU.Y - data);
-	mainCPU.negativeResult = mainCPU.zeroResult;
-}
+	FORCE_INLINE void CPX_MEM(unsigned int addr) {
+		CPX(mainCPU.read(addr));
+	}
 
-FORCE_INLINE void CPY_MEM(unsigned int addr) {
-	CPY(mainCPU.read(addr));
-}
+	FORCE_INLINE void CPX_ZERO(unsigned int addr) {
+		CPX(CPU_RAM(addr));
+	}
 
-FORCE_INLINE void CPY_ZERO(unsigned int addr) {
-	CPY(CPU_RAM(addr));
-}
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// MISC
+	FORCE_INLINE void CPY(unsigned int data) {
+		mainCPU.carryResult = (data <= mainCPU.Y) ? 1 : 0;
+		mainCPU.zeroResult = (mainCPU.Y - data);
+		mainCPU.negativeResult = mainCPU.zeroResult;
+	}
 
-FORCE_INLINE void BRK() {
-	mainCPU.PC++;
+	FORCE_INLINE void CPY_MEM(unsigned int addr) {
+		CPY(mainCPU.read(addr));
+	}
 
-	// BRK moves forward an instruction
-	cpu6502_SoftwareInterrupt(0xFFFE);
-}
+	FORCE_INLINE void CPY_ZERO(unsigned int addr) {
+		CPY(CPU_RAM(addr));
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// MISC
 
-FORCE_INLINE void NOP() {
-}
+	FORCE_INLINE void BRK() {
+		mainCPU.PC++;
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// BITWISE
+		// BRK moves forward an instruction
+		cpu6502_SoftwareInterrupt(0xFFFE);
+	}
 
-FORCE_INLINE void ORA(unsigned int data) {
-	mainCPU.A = mainCPU.A | data;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+	FORCE_INLINE void NOP() {
+	}
 
-FORCE_INLINE void ORA_MEM(unsigned int address) {
-	ORA(mainCPU.read(address));
-}
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// BITWISE
 
-FORCE_INLINE void ORA_ZERO(unsigned int address) {
-	ORA(CPU_RAM(address));
-}
+	FORCE_INLINE void ORA(unsigned int data) {
+		mainCPU.A = mainCPU.A | data;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-FORCE_INLINE void AND(unsigned int data) {
-	mainCPU.A = mainCPU.A & data;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+	FORCE_INLINE void ORA_MEM(unsigned int address) {
+		ORA(mainCPU.read(address));
+	}
 
-FORCE_INLINE void AND_MEM(unsigned int address) {
-	AND(mainCPU.read(address));
-}
+	FORCE_INLINE void ORA_ZERO(unsigned int address) {
+		ORA(CPU_RAM(address));
+	}
 
-FORCE_INLINE void AND_ZERO(unsigned int address) {
-	AND(CPU_RAM(address));
-}
+	FORCE_INLINE void AND(unsigned int data) {
+		mainCPU.A = mainCPU.A & data;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-FORCE_INLINE void EOR(unsigned int data) {
-	mainCPU.A = mainCPU.A ^ data;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+	FORCE_INLINE void AND_MEM(unsigned int address) {
+		AND(mainCPU.read(address));
+	}
 
-FORCE_INLINE void EOR_MEM(unsigned int address) {
-	EOR(mainCPU.read(address));
-}
+	FORCE_INLINE void AND_ZERO(unsigned int address) {
+		AND(CPU_RAM(address));
+	}
 
-FORCE_INLINE void EOR_ZERO(unsigned int address) {
-	EOR(CPU_RAM(address));
-}
+	FORCE_INLINE void EOR(unsigned int data) {
+		mainCPU.A = mainCPU.A ^ data;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-FORCE_INLINE void ASL() {
-	mainCPU.carryResult = mainCPU.A >> 7;
-	mainCPU.A = (mainCPU.A << 1) & 0xFF;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
+	FORCE_INLINE void EOR_MEM(unsigned int address) {
+		EOR(mainCPU.read(address));
+	}
 
-FORCE_INLINE void ASL_MEM(unsigned int address) {
-	unsigned int data = mainCPU.readNonIO(address);
+	FORCE_INLINE void EOR_ZERO(unsigned int address) {
+		EOR(CPU_RAM(address));
+	}
 
-	mainCPU.carryResult = data >> 7;
-	data = (data << 1) & 0xFF;
-	mainCPU.zeroResult = data;
-	mainCPU.negativeResult = data;
+	FORCE_INLINE void ASL() {
+		mainCPU.carryResult = mainCPU.A >> 7;
+		mainCPU.A = (mainCPU.A << 1) & 0xFF;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-	writeAddr(address, data);
-}
+	FORCE_INLINE void ASL_MEM(unsigned int address) {
+		unsigned int data = mainCPU.readNonIO(address);
 
-FORCE_INLINE void ASL_ZERO(unsigned int address) {
-	unsigned int data = CPU_RAM(address);
+		mainCPU.carryResult = data >> 7;
+		data = (data << 1) & 0xFF;
+		mainCPU.zeroResult = data;
+		mainCPU.negativeResult = data;
 
-	mainCPU.carryResult = data >> 7;
-	int result = (data << 1) & 0xFF;
-	mainCPU.zeroResult = result;
-	mainCPU.negativeResult = result;
+		writeAddr(address, data);
+	}
 
-	writeZero(address, result);
-}
+	FORCE_INLINE void ASL_ZERO(unsigned int address) {
+		unsigned int data = CPU_RAM(address);
 
-FORCE_INLINE void LSR() {
-	mainCPU.carryResult = (mainCPU.A & 0x01);
-	mainCPU.A >>= 1;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = 0;
-}
+		mainCPU.carryResult = data >> 7;
+		int result = (data << 1) & 0xFF;
+		mainCPU.zeroResult = result;
+		mainCPU.negativeResult = result;
 
-FORCE_INLINE void LSR_MEM(unsigned int address) {
-	unsigned int data = mainCPU.readNonIO(address);
+		writeZero(address, result);
+	}
 
-	mainCPU.carryResult = (data & 0x01);
-	data >>= 1;
-	mainCPU.zeroResult = data;
-	mainCPU.negativeResult = 0;
+	FORCE_INLINE void LSR() {
+		mainCPU.carryResult = (mainCPU.A & 0x01);
+		mainCPU.A >>= 1;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = 0;
+	}
 
-	writeAddr(address, data);
-}
+	FORCE_INLINE void LSR_MEM(unsigned int address) {
+		unsigned int data = mainCPU.readNonIO(address);
 
-FORCE_INLINE void LSR_ZERO(unsigned int address) {
-	unsigned int data = CPU_RAM(address);
+		mainCPU.carryResult = (data & 0x01);
+		data >>= 1;
+		mainCPU.zeroResult = data;
+		mainCPU.negativeResult = 0;
 
-	mainCPU.carryResult = (data & 0x01);
-	data >>= 1;
-	mainCPU.zeroResult = data;
-	mainCPU.negativeResult = 0;
+		writeAddr(address, data);
+	}
 
-	writeZero(address, data);
-}
+	FORCE_INLINE void LSR_ZERO(unsigned int address) {
+		unsigned int data = CPU_RAM(address);
 
-FORCE_INLINE void ROL() {
-	mainCPU.A = (mainCPU.A << 1) | mainCPU.carryResult;
-	mainCPU.carryResult = mainCPU.A >> 8;
-	mainCPU.zeroResult = mainCPU.A & 0xFF;
-	mainCPU.A = mainCPU.zeroResult;
-	mainCPU.negativeResult = mainCPU.A;
-}
+		mainCPU.carryResult = (data & 0x01);
+		data >>= 1;
+		mainCPU.zeroResult = data;
+		mainCPU.negativeResult = 0;
 
-FORCE_INLINE void ROL_MEM(unsigned int address) {
-	unsigned int data = mainCPU.readNonIO(address);
+		writeZero(address, data);
+	}
 
-	data = (data << 1) | mainCPU.carryResult;
-	mainCPU.carryResult = data >> 8;
-	mainCPU.zeroResult = data & 0xFF;
-	mainCPU.negativeResult = data;
+	FORCE_INLINE void ROL() {
+		mainCPU.A = (mainCPU.A << 1) | mainCPU.carryResult;
+		mainCPU.carryResult = mainCPU.A >> 8;
+		mainCPU.zeroResult = mainCPU.A & 0xFF;
+		mainCPU.A = mainCPU.zeroResult;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-	writeAddr(address, data);
-}
+	FORCE_INLINE void ROL_MEM(unsigned int address) {
+		unsigned int data = mainCPU.readNonIO(address);
 
-FORCE_INLINE void ROL_ZERO(unsigned int address) {
-	unsigned int data = CPU_RAM(address);
+		data = (data << 1) | mainCPU.carryResult;
+		mainCPU.carryResult = data >> 8;
+		mainCPU.zeroResult = data & 0xFF;
+		mainCPU.negativeResult = data;
 
-	data = (data << 1) | mainCPU.carryResult;
-	mainCPU.carryResult = data >> 8;
-	mainCPU.zeroResult = data & 0xFF;
-	mainCPU.negativeResult = data;
+		writeAddr(address, data);
+	}
 
-	writeZero(address, data);
-}
+	FORCE_INLINE void ROL_ZERO(unsigned int address) {
+		unsigned int data = CPU_RAM(address);
 
+		data = (data << 1) | mainCPU.carryResult;
+		mainCPU.carryResult = data >> 8;
+		mainCPU.zeroResult = data & 0xFF;
+		mainCPU.negativeResult = data;
 
-FORCE_INLINE void ROR() {
-	unsigned int result = (mainCPU.A >> 1) | (mainCPU.carryResult << 7);
-	mainCPU.carryResult = mainCPU.A & 0x01;
+		writeZero(address, data);
+	}
 
-	mainCPU.A = result;
-	mainCPU.zeroResult = mainCPU.A;
-	mainCPU.negativeResult = mainCPU.A;
-}
 
-FORCE_INLINE void ROR_MEM(unsigned int address) {
-	unsigned int data = mainCPU.readNonIO(address);
+	FORCE_INLINE void ROR() {
+		unsigned int result = (mainCPU.A >> 1) | (mainCPU.carryResult << 7);
+		mainCPU.carryResult = mainCPU.A & 0x01;
 
-	unsigned int result = (data >> 1) | (mainCPU.carryResult << 7);
-	mainCPU.carryResult = data & 0x01;
-	mainCPU.zeroResult = result;
-	mainCPU.negativeResult = result;
+		mainCPU.A = result;
+		mainCPU.zeroResult = mainCPU.A;
+		mainCPU.negativeResult = mainCPU.A;
+	}
 
-	writeAddr(address, result);
-}
+	FORCE_INLINE void ROR_MEM(unsigned int address) {
+		unsigned int data = mainCPU.readNonIO(address);
 
-FORCE_INLINE void ROR_ZERO(unsigned int address) {
-	int data = CPU_RAM(address);
+		unsigned int result = (data >> 1) | (mainCPU.carryResult << 7);
+		mainCPU.carryResult = data & 0x01;
+		mainCPU.zeroResult = result;
+		mainCPU.negativeResult = result;
 
-	unsigned int result = (data >> 1) | (mainCPU.carryResult << 7);
-	mainCPU.carryResult = data & 0x01;
-	mainCPU.zeroResult = result;
-	mainCPU.negativeResult = result;
+		writeAddr(address, result);
+	}
 
-	writeZero(address, result);
-}
+	FORCE_INLINE void ROR_ZERO(unsigned int address) {
+		int data = CPU_RAM(address);
 
-FORCE_INLINE void BIT(unsigned int data) {
-	mainCPU.P =
-		(mainCPU.P & (ST_INT | ST_BCD | ST_BRK | ST_CRY | ST_UNUSED)) |		// keep flags
-		(data & (ST_OVR | ST_NEG));											// these are copied in (bits 6-7)
-	mainCPU.zeroResult = (data & mainCPU.A);
-	mainCPU.negativeResult = data;
-}
+		unsigned int result = (data >> 1) | (mainCPU.carryResult << 7);
+		mainCPU.carryResult = data & 0x01;
+		mainCPU.zeroResult = result;
+		mainCPU.negativeResult = result;
 
-FORCE_INLINE void BIT_MEM(unsigned int address) {
-	BIT(mainCPU.read(address));
-}
+		writeZero(address, result);
+	}
 
-FORCE_INLINE void BIT_ZERO(unsigned int address) {
-	BIT(CPU_RAM(address));
-}
+	FORCE_INLINE void BIT(unsigned int data) {
+		mainCPU.P =
+			(mainCPU.P & (ST_INT | ST_BCD | ST_BRK | ST_CRY | ST_UNUSED)) |		// keep flags
+			(data & (ST_OVR | ST_NEG));											// these are copied in (bits 6-7)
+		mainCPU.zeroResult = (data & mainCPU.A);
+		mainCPU.negativeResult = data;
+	}
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// STATUS FLAGS
+	FORCE_INLINE void BIT_MEM(unsigned int address) {
+		BIT(mainCPU.read(address));
+	}
 
-FORCE_INLINE void CLC() {
-	// (clear carry)
-	mainCPU.carryResult = 0;
-}
+	FORCE_INLINE void BIT_ZERO(unsigned int address) {
+		BIT(CPU_RAM(address));
+	}
 
-FORCE_INLINE void SEC() {
-	// (set carry)
-	mainCPU.carryResult = 1;
-}
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// STATUS FLAGS
 
-FORCE_INLINE void CLI() {
-	// (clear interrupt)
-	// TODO : Delayed IRQ response behavior?
-	mainCPU.P &= ~ST_INT;
-}
+	FORCE_INLINE void CLC() {
+		// (clear carry)
+		mainCPU.carryResult = 0;
+	}
 
-FORCE_INLINE void SEI() {
-	// (set interrupt)
-	mainCPU.P |= ST_INT;
-}
+	FORCE_INLINE void SEC() {
+		// (set carry)
+		mainCPU.carryResult = 1;
+	}
 
-FORCE_INLINE void CLV() {
-	// (clear overflow)
-	mainCPU.P &= ~ST_OVR;
-}
+	FORCE_INLINE void CLI() {
+		// (clear interrupt)
+		// TODO : Delayed IRQ response behavior?
+		mainCPU.P &= ~ST_INT;
+	}
 
-FORCE_INLINE void CLD() {
-	// (clear decimal)
-	mainCPU.P &= ~ST_BCD;
-}
+	FORCE_INLINE void SEI() {
+		// (set interrupt)
+		mainCPU.P |= ST_INT;
+	}
 
-FORCE_INLINE void SED() {
-	// (set decimal)
-	mainCPU.P |= ST_BCD;
-}
+	FORCE_INLINE void CLV() {
+		// (clear overflow)
+		mainCPU.P &= ~ST_OVR;
+	}
+
+	FORCE_INLINE void CLD() {
+		// (clear decimal)
+		mainCPU.P &= ~ST_BCD;
+	}
+
+	FORCE_INLINE void SED() {
+		// (set decimal)
+		mainCPU.P |= ST_BCD;
+	}
 
 #if TRACE_DEBUG
-static unsigned int effAddr = -1;
-static unsigned int effByte = 0;
-unsigned int eff_address(unsigned int addr) { effAddr = addr; if (effAddr < 0x2000 || effAddr >= 0x6000) effByte = mainCPU.readNonIO(effAddr); return effAddr; }
+	unsigned int eff_address(unsigned int addr) { effAddr = addr; if (effAddr < 0x2000 || effAddr >= 0x6000) effByte = mainCPU.readNonIO(effAddr); return effAddr; }
 #else
 #define eff_address(X) (X)
 #endif
 
-FORCE_INLINE void cpu6502_PerformInstruction() {
+	FORCE_INLINE void cpu6502_PerformInstruction() {
 #if TRACE_DEBUG
-	cpu_instr_history hist;
-	mainCPU.resolveToP();
-	memcpy(&hist.regs, &mainCPU, sizeof(cpu_6502));
+		cpu_instr_history hist;
+		mainCPU.resolveToP();
+		memcpy(&hist.regs, &mainCPU, sizeof(cpu_6502));
 
-	effByte = 0;
-	hist.instr = mainCPU.readNonIO(mainCPU.PC+0);
-	hist.data1 = mainCPU.readNonIO(mainCPU.PC+1);
-	hist.data2 = mainCPU.readNonIO(mainCPU.PC+2);
+		effByte = 0;
+		hist.instr = mainCPU.readNonIO(mainCPU.PC+0);
+		hist.data1 = mainCPU.readNonIO(mainCPU.PC+1);
+		hist.data2 = mainCPU.readNonIO(mainCPU.PC+2);
 #endif
 
 
-	unsigned char instr = mainCPU.readNonIO(mainCPU.PC++);
-	unsigned char data1 = mainCPU.readNonIO(mainCPU.PC++);
+		unsigned char instr = mainCPU.readNonIO(mainCPU.PC++);
+		unsigned char data1 = mainCPU.readNonIO(mainCPU.PC++);
 
-	// all instructions at least 2 clks
-	mainCPU.clocks += 2;
+		// all instructions at least 2 clks
+		mainCPU.clocks += 2;
 
 #define SKIP_LATCHING() goto SkipLatching;
 #define OPCODE_START(op,clk,sz) case op: { INSTR_TIMING(op); mainCPU.clocks += (clk-2);
@@ -818,73 +830,82 @@ FORCE_INLINE void cpu6502_PerformInstruction() {
 		SKIP_LATCHING(); \
 	OPCODE_END(spc)
 
-	switch (instr) {
-		#include "6502_opcodes.inl"
-		default:
-		{
+		switch (instr) {
+			#include "6502_opcodes.inl"
+			default:
+			{
 #if TRACE_DEBUG
-			IllegalInstruction();
+				IllegalInstruction();
 #else
-			DebugAssert(false);
+				DebugAssert(false);
 #endif
+			}
+		};
+
+		if (mainCPU.accessTable[0x2000 >> 13]) {
+			nesPPU.latchedReg(mainCPU.accessTable[0x2000 >> 13]);
+			mainCPU.accessTable[0x2000 >> 13] = 0;
+		} else if (mainCPU.accessTable[0x4000 >> 13]) {
+			mainCPU.latchedSpecial(mainCPU.accessTable[0x4000 >> 13]);
+			mainCPU.accessTable[0x4000 >> 13] = 0;
 		}
-	};
-
-	if (mainCPU.accessTable[0x2000 >> 13]) {
-		nesPPU.latchedReg(mainCPU.accessTable[0x2000 >> 13]);
-		mainCPU.accessTable[0x2000 >> 13] = 0;
-	} else if (mainCPU.accessTable[0x4000 >> 13]) {
-		mainCPU.latchedSpecial(mainCPU.accessTable[0x4000 >> 13]);
-		mainCPU.accessTable[0x4000 >> 13] = 0;
-	}
 
 SkipLatching:
 
-	// sanity checks
-	DebugAssert(mainCPU.carryResult == 0 || mainCPU.carryResult == 1);
+		// sanity checks
+		DebugAssert(mainCPU.carryResult == 0 || mainCPU.carryResult == 1);
 #if TRACE_DEBUG
-	if (instr == 0x60 && mainCPU.PC > 1) {
-		// RTS special case:
-		effAddr = (mainCPU.readNonIO(mainCPU.PC - 1) << 8) + mainCPU.readNonIO(mainCPU.PC - 2);
-	}
+		if (instr == 0x60 && mainCPU.PC > 1) {
+			// RTS special case:
+			effAddr = (mainCPU.readNonIO(mainCPU.PC - 1) << 8) + mainCPU.readNonIO(mainCPU.PC - 2);
+		}
 
-	hist.effAddr = effAddr;
-	hist.effByte = effByte;
+		hist.effAddr = effAddr;
+		hist.effByte = effByte;
 
-	traceHistory[traceNum++] = hist;
-	traceCount++;
-	if (traceNum == NUM_TRACED) traceNum = 0;
+		traceHistory[traceNum++] = hist;
+		traceCount++;
+		if (traceNum == NUM_TRACED) traceNum = 0;
 
-	if (traceLineRemaining) {
-		hist.output();
-		traceLineRemaining--;
-	}
+		if (traceLineRemaining) {
+			hist.output();
+			traceLineRemaining--;
+		}
 
-	if (hist.regs.PC == cpuBreakpoint) {
-		HitBreakpoint();
-	}
+		if (hist.regs.PC == cpuBreakpoint) {
+			HitBreakpoint();
+		}
 
-	if (bHitMemBreakpoint) {
-		HitBreakpoint();
-		bHitMemBreakpoint = false;
-	}
+		if (bHitMemBreakpoint) {
+			HitBreakpoint();
+			bHitMemBreakpoint = false;
+		}
 
-	if (bHitPPUBreakpoint) {
-		Do_PPUBreakpoint();
-		bHitPPUBreakpoint = false;
-	}
+		if (bHitPPUBreakpoint) {
+			Do_PPUBreakpoint();
+			bHitPPUBreakpoint = false;
+		}
 
 
-	cpuInstructionCount++;
-	if (instructionCountBreakpoint && cpuInstructionCount == instructionCountBreakpoint) {
-		HitBreakpoint();
-	}
+		cpuInstructionCount++;
+		if (instructionCountBreakpoint && cpuInstructionCount == instructionCountBreakpoint) {
+			HitBreakpoint();
+		}
 #endif
-}
+	}
+};
 
 void cpu6502_Step() {
 	TIME_SCOPE();
 
+#if NES_MULTI_MACHINE
+	// the calling thread's machine, loaded once for the instructions run below
+	NES_LOCAL_MACHINE();
+	cpu6502_exec exec = { nesCurrentMachine };
+#else
+	cpu6502_exec exec;
+#endif
+
 	// stop at next PPU or IRQ
 	mainCPU.nextClocks = mainCPU.ppuClocks;
 
@@ -903,7 +924,7 @@ void cpu6502_Step() {
 	}
 
 	for (; mainCPU.clocks < mainCPU.nextClocks;) {
-		cpu6502_PerformInstruction();
+		exec.cpu6502_PerformInstruction();
 	}
 
 	if (mainCPU.ppuNMI) {
@@ -113,7 +113,7 @@ void cpu6502_SoftwareInterrupt(unsigned int vectorAddress);
 #if NES
 #include "nes.h"
 #include "nes_cpu.h"
-extern nes_cpu mainCPU ALIGN(256);
+#include "nes_machine.h"
 #endif
 
 #define CPU_RAM(X) mainCPU.RAM[X]
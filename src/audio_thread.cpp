@@ -0,0 +1,348 @@
+// Host audio output thread, drains the sample ring filled by nes_audio_thread::frameEnded
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+
+#if APU_AUDIO_THREAD
+
+#include <windows.h>
+#include <mmsystem.h>
+#include "audio_thread.h"
+#include "capture_thread.h"
+#include "snd/snd.h"
+#include "scope_timer/scope_timer.h"
+
+nes_audio_thread nesAudioThread;
+
+// device buffers in flight, the device plays these while the next is filled
+#define AUDIO_DEVICE_BLOCKS 4
+#define AUDIO_DEVICE_BLOCK 512
+
+// largest mix per frame, anything past this is a stall the mixer snaps over
+#define AUDIO_MAX_FRAME 4096
+
+static HWAVEOUT waveDevice;
+static HANDLE waveEvent;
+static FILE* wavOut;
+static int32 wavBytes;
+
+static int mixBuffer[AUDIO_MAX_FRAME];
+
+static DWORD WINAPI AudioThreadProc(LPVOID) {
+	nesAudioThread.run();
+	return 0;
+}
+
+static void WriteLittleEndian(uint8* into, uint32 value, int numBytes) {
+	for (int i = 0; i < numBytes; i++) {
+		into[i] = value & 0xFF;
+		value >>= 8;
+	}
+}
+
+void WriteWAVHeader(FILE* file, int32 dataBytes) {
+	uint8 header[44];
+	memcpy(header, "RIFF", 4);
+	WriteLittleEndian(header + 4, 36 + dataBytes, 4);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	WriteLittleEndian(header + 16, 16, 4);
+	WriteLittleEndian(header + 20, 1, 2);					// PCM
+	WriteLittleEndian(header + 22, 1, 2);					// mono
+	WriteLittleEndian(header + 24, SOUND_RATE, 4);
+	WriteLittleEndian(header + 28, SOUND_RATE * 2, 4);
+	WriteLittleEndian(header + 32, 2, 2);
+	WriteLittleEndian(header + 34, 16, 2);
+	memcpy(header + 36, "data", 4);
+	WriteLittleEndian(header + 40, dataBytes, 4);
+
+	fseek(file, 0, SEEK_SET);
+	fwrite(header, 1, sizeof(header), file);
+}
+
+void nes_audio_thread::setSink(int32 type, const char* file) {
+	DebugAssert(thread == nullptr);
+
+	sink = type;
+	wavFile[0] = 0;
+	if (file && strlen(file) < sizeof(wavFile)) {
+		strcpy(wavFile, file);
+	}
+}
+
+void nes_audio_thread::start() {
+	DebugAssert(thread == nullptr);
+
+	activeSink = sink;
+	if (activeSink == AUDIO_SINK_DEVICE) {
+		WAVEFORMATEX format;
+		memset(&format, 0, sizeof(format));
+		format.wFormatTag = WAVE_FORMAT_PCM;
+		format.nChannels = 1;
+		format.nSamplesPerSec = SOUND_RATE;
+		format.wBitsPerSample = 16;
+		format.nBlockAlign = 2;
+		format.nAvgBytesPerSec = SOUND_RATE * 2;
+
+		waveEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+		if (waveOutOpen(&waveDevice, WAVE_MAPPER, &format, (DWORD_PTR) waveEvent, 0, CALLBACK_EVENT) != MMSYSERR_NOERROR) {
+			OutputLog("Audio: no wave out device, samples are discarded\n");
+			CloseHandle(waveEvent);
+			waveEvent = NULL;
+			activeSink = AUDIO_SINK_NULL;
+		}
+	} else if (activeSink == AUDIO_SINK_WAV) {
+		wavOut = wavFile[0] ? fopen(wavFile, "wb") : nullptr;
+		if (wavOut) {
+			// sizes are filled in on stop
+			wavBytes = 0;
+			WriteWAVHeader(wavOut, 0);
+		} else {
+			OutputLog("Audio: could not create '%s', samples are discarded\n", wavFile);
+			activeSink = AUDIO_SINK_NULL;
+		}
+	}
+
+	head = 0;
+	tail = 0;
+	lastSample = 0;
+	dcLevel = 0;
+	bStop = false;
+
+	// the device starts on silence at the target fill, so the controller only has to hold it there
+	targetFill = SOUND_RATE / 20 + AUDIO_DEVICE_BLOCK;
+	averageFill = targetFill << 16;
+	if (activeSink == AUDIO_SINK_DEVICE) {
+		memset(ring, 0, sizeof(int16) * targetFill);
+		head = targetFill;
+	}
+
+	thread = CreateThread(NULL, 0, AudioThreadProc, NULL, 0, NULL);
+}
+
+void nes_audio_thread::stop() {
+	if (thread == nullptr) {
+		return;
+	}
+
+	bStop = true;
+	WaitForSingleObject((HANDLE) thread, INFINITE);
+	CloseHandle((HANDLE) thread);
+	thread = nullptr;
+
+	if (activeSink == AUDIO_SINK_DEVICE) {
+		waveOutClose(waveDevice);
+		CloseHandle(waveEvent);
+		waveEvent = NULL;
+	} else if (activeSink == AUDIO_SINK_WAV) {
+		WriteWAVHeader(wavOut, wavBytes);
+		fclose(wavOut);
+		wavOut = nullptr;
+	}
+
+	// back to the nominal rate for whatever mixes next
+	nesAPU.setMixRate(SOUND_RATE);
+}
+
+int32 nes_audio_thread::controlRate() {
+	// only a device consumes at its own pace, files and null take everything
+	if (activeSink != AUDIO_SINK_DEVICE) {
+		return SOUND_RATE;
+	}
+
+	// the fill swings by a frame and a device block between calls, steer by its average
+	const int32 fill = int32(head - tail);
+	averageFill += ((fill << 16) - averageFill) >> 4;
+
+	// at most half a percent either way, which can't be heard as pitch
+	const int32 maxAdjust = SOUND_RATE / 200;
+	int32 adjust = int32((long long) maxAdjust * (targetFill - (averageFill >> 16)) / targetFill);
+	if (adjust > maxAdjust) adjust = maxAdjust;
+	if (adjust < -maxAdjust) adjust = -maxAdjust;
+
+	return SOUND_RATE + adjust;
+}
+
+void nes_audio_thread::frameEnded() {
+	if (thread == nullptr) {
+		return;
+	}
+
+	TIME_SCOPE();
+
+	// everything the CPU ran since the last frame, at the controlled rate. A captured WAV is written as SOUND_RATE, so
+	// the rate holds there while one is running (the device fill is still tracked)
+	int32 rate = controlRate();
+#if CAPTURE_THREAD
+	if (nesCapture.capturesAudio()) {
+		rate = SOUND_RATE;
+	}
+#endif
+	nesAPU.setMixRate(rate);
+
+	const int32 cpuRate = nesCart.isPAL ? 1662607 : 1789773;
+	const int32 clocks = int32(mainCPU.clocks - nesAPU.mixClock);
+	int32 length = int32((long long) clocks * rate / cpuRate);
+	if (length <= 0) {
+		return;
+	}
+	if (length > AUDIO_MAX_FRAME) {
+		length = AUDIO_MAX_FRAME;
+	}
+
+	// a capture takes the block as it is mixed
+	int* buffer = mixBuffer;
+#if CAPTURE_THREAD
+	if (int* captureBuffer = nesCapture.beginAudio(length)) {
+		buffer = captureBuffer;
+	}
+#endif
+
+	nesAPU.mix(buffer, length);
+
+	// fast forward makes more than plays, the overflow is dropped
+	push(buffer, length);
+
+#if CAPTURE_THREAD
+	nesCapture.endAudio(length);
+#endif
+}
+
+int32 nes_audio_thread::push(const int* samples, int32 count) {
+	const int32 space = AUDIO_RING_SIZE - int32(head - tail);
+	if (count > space) {
+		count = space;
+	}
+
+	uint32 pos = head;
+	for (int32 i = 0; i < count; i++, pos++) {
+		const int32 level = samples[i];
+		dcLevel += ((level << 16) - dcLevel) >> 10;
+
+		int32 sample = ((level - (dcLevel >> 16)) * 2 * volume) >> 3;
+		if (sample > 32767) sample = 32767;
+		if (sample < -32768) sample = -32768;
+		ring[pos & (AUDIO_RING_SIZE - 1)] = int16(sample);
+	}
+
+	// publish the samples only after they have been written
+	MemoryBarrier();
+	head = pos;
+	return count;
+}
+
+void nes_audio_thread::pop(int16* into, int32 count) {
+	int32 available = int32(head - tail);
+	if (available > count) {
+		available = count;
+	}
+
+	// read the samples before the slots are handed back
+	MemoryBarrier();
+
+	uint32 pos = tail;
+	for (int32 i = 0; i < available; i++, pos++) {
+		into[i] = ring[pos & (AUDIO_RING_SIZE - 1)];
+	}
+	if (available) {
+		lastSample = into[available - 1];
+	}
+
+	MemoryBarrier();
+	tail = pos;
+
+	// holding the last level on an underrun doesn't click like dropping to zero would
+	for (int32 i = available; i < count; i++) {
+		into[i] = lastSample;
+	}
+}
+
+void nes_audio_thread::volumeUp() {
+	if (volume < 16) {
+		volume++;
+	}
+}
+
+void nes_audio_thread::volumeDown() {
+	if (volume > 0) {
+		volume--;
+	}
+}
+
+void nes_audio_thread::run() {
+	switch (activeSink) {
+		case AUDIO_SINK_DEVICE:
+			runDevice();
+			break;
+		case AUDIO_SINK_WAV:
+			runWAV();
+			break;
+		default:
+			runNull();
+			break;
+	}
+}
+
+void nes_audio_thread::runDevice() {
+	static int16 blocks[AUDIO_DEVICE_BLOCKS][AUDIO_DEVICE_BLOCK];
+	WAVEHDR headers[AUDIO_DEVICE_BLOCKS];
+
+	for (int32 i = 0; i < AUDIO_DEVICE_BLOCKS; i++) {
+		memset(&headers[i], 0, sizeof(WAVEHDR));
+		headers[i].lpData = (LPSTR) blocks[i];
+		headers[i].dwBufferLength = sizeof(blocks[i]);
+		waveOutPrepareHeader(waveDevice, &headers[i], sizeof(WAVEHDR));
+
+		pop(blocks[i], AUDIO_DEVICE_BLOCK);
+		waveOutWrite(waveDevice, &headers[i], sizeof(WAVEHDR));
+	}
+
+	// refill blocks as the device finishes them
+	while (!bStop) {
+		WaitForSingleObject(waveEvent, 100);
+
+		for (int32 i = 0; i < AUDIO_DEVICE_BLOCKS; i++) {
+			if (headers[i].dwFlags & WHDR_DONE) {
+				headers[i].dwFlags &= ~WHDR_DONE;
+				pop(blocks[i], AUDIO_DEVICE_BLOCK);
+				waveOutWrite(waveDevice, &headers[i], sizeof(WAVEHDR));
+			}
+		}
+	}
+
+	waveOutReset(waveDevice);
+	for (int32 i = 0; i < AUDIO_DEVICE_BLOCKS; i++) {
+		waveOutUnprepareHeader(waveDevice, &headers[i], sizeof(WAVEHDR));
+	}
+}
+
+void nes_audio_thread::runWAV() {
+	int16 block[AUDIO_DEVICE_BLOCK];
+
+	// drains until stopped and the ring is empty, so the file has every sample made
+	for (;;) {
+		const int32 available = int32(head - tail);
+		if (available == 0) {
+			if (bStop)
+				break;
+			Sleep(1);
+			continue;
+		}
+
+		const int32 count = available < AUDIO_DEVICE_BLOCK ? available : AUDIO_DEVICE_BLOCK;
+		pop(block, count);
+
+		// WAV data is little endian, as is the host
+		fwrite(block, sizeof(int16), count, wavOut);
+		wavBytes += count * 2;
+	}
+}
+
+void nes_audio_thread::runNull() {
+	while (!bStop) {
+		tail = head;
+		Sleep(10);
+	}
+}
+
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "nes.h"
+
+// Audio output for the host build. The emulation thread mixes each frame's samples into a single producer, single
+// consumer ring and an output thread drains it to the sound device, a WAV file or nowhere. The mix rate is nudged
+// to hold the ring at a constant fill so the device clock and the emulation never drift apart.
+
+#if APU_AUDIO_THREAD
+
+#define AUDIO_RING_SIZE 16384			// samples (power of 2)
+
+enum nes_audio_sink {
+	AUDIO_SINK_DEVICE,				// default wave out device, falls back to null if it can't be opened
+	AUDIO_SINK_WAV,					// 16 bit mono WAV file, written as fast as samples come
+	AUDIO_SINK_NULL					// discarded
+};
+
+struct nes_audio_thread {
+	nes_audio_thread() : thread(nullptr), sink(AUDIO_SINK_DEVICE), volume(8) {
+		wavFile[0] = 0;
+	}
+
+	// picks where the next start() sends samples (file is only used for AUDIO_SINK_WAV)
+	void setSink(int32 type, const char* file);
+
+	void start();
+	void stop();
+
+	bool isActive() const {
+		return thread != nullptr;
+	}
+
+	// emulation thread side, mixes everything the CPU has run since the last call
+	void frameEnded();
+
+	void volumeUp();
+	void volumeDown();
+
+	// output thread side
+	void run();
+
+private:
+	// producer side, returns the number of samples that fit
+	int32 push(const int* samples, int32 count);
+
+	// consumer side, pads underruns with the last sample
+	void pop(int16* into, int32 count);
+
+	// mix rate that moves the ring toward its target fill
+	int32 controlRate();
+
+	void runDevice();
+	void runWAV();
+	void runNull();
+
+	void* thread;
+	volatile bool bStop;
+	int32 sink;
+	int32 activeSink;
+	char wavFile[256];
+
+	int16 ring[AUDIO_RING_SIZE];
+	volatile uint32 head;			// written by the emulation thread
+	volatile uint32 tail;			// written by the output thread
+	int16 lastSample;
+
+	// fill the rate controller aims for and its smoothed measure (16.16), both in samples
+	int32 targetFill;
+	int32 averageFill;
+
+	// one pole high pass, the APU levels all sit above zero (16.16)
+	int32 dcLevel;
+
+	// output gain in eighths
+	int32 volume;
+};
+
+extern nes_audio_thread nesAudioThread;
+
+// (re)writes the header of a 16 bit mono WAV file at the output rate, leaves the file at the start of the data
+void WriteWAVHeader(FILE* file, int32 dataBytes);
+
+#endif
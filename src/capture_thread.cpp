@@ -0,0 +1,214 @@
+// Host capture writer thread, streams the frames and audio blocks handed over by the emulation and render threads
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+
+#if CAPTURE_THREAD
+
+#include <windows.h>
+#include "capture_thread.h"
+#include "audio_thread.h"
+
+nes_capture_thread nesCapture;
+
+static DWORD WINAPI CaptureThreadProc(LPVOID) {
+	nesCapture.run();
+	return 0;
+}
+
+bool nes_capture_thread::start(int32 withVideoFormat, const char* videoFile, const char* wavFile, bool bWithEveryFrame) {
+	DebugAssert(thread == nullptr);
+
+	videoFormat = withVideoFormat;
+	videoOut = nullptr;
+	if (videoFormat != CAPTURE_VIDEO_NONE && videoFile) {
+		videoOut = fopen(videoFile, "wb");
+		if (videoOut == nullptr) {
+			OutputLog("Capture: could not create '%s'\n", videoFile);
+		}
+	}
+
+	// audio only arrives from the host audio thread, so there is none with sound off
+	audioOut = nullptr;
+	if (wavFile && nesAudioThread.isActive()) {
+		audioOut = fopen(wavFile, "wb");
+		if (audioOut) {
+			// sizes are filled in on stop
+			audioBytes = 0;
+			dcLevel = 0;
+			WriteWAVHeader(audioOut, 0);
+		} else {
+			OutputLog("Capture: could not create '%s'\n", wavFile);
+		}
+	}
+
+	if (videoOut == nullptr && audioOut == nullptr) {
+		return false;
+	}
+
+	if (videoOut && videoFormat == CAPTURE_VIDEO_Y4M) {
+		// exact NES frame rate, master clock over clocks per frame
+		if (nesCart.isPAL) {
+			fprintf(videoOut, "YUV4MPEG2 W%d H%d F3325214:66495 Ip A1:1 C444\n", CAPTURE_WIDTH, CAPTURE_HEIGHT);
+		} else {
+			fprintf(videoOut, "YUV4MPEG2 W%d H%d F3579546:59561 Ip A1:1 C444\n", CAPTURE_WIDTH, CAPTURE_HEIGHT);
+		}
+	}
+
+	bEveryFrame = bWithEveryFrame;
+	postedFrames = 0;
+	writtenFrames = 0;
+	audioHead = 0;
+	audioTail = 0;
+	bStop = false;
+
+	thread = CreateThread(NULL, 0, CaptureThreadProc, NULL, 0, NULL);
+	return true;
+}
+
+void nes_capture_thread::stop() {
+	if (thread == nullptr) {
+		return;
+	}
+
+	// the writer drains everything handed over before it exits
+	bStop = true;
+	WaitForSingleObject((HANDLE) thread, INFINITE);
+	CloseHandle((HANDLE) thread);
+	thread = nullptr;
+
+	if (videoOut) {
+		fclose(videoOut);
+		videoOut = nullptr;
+	}
+	if (audioOut) {
+		WriteWAVHeader(audioOut, audioBytes);
+		fclose(audioOut);
+		audioOut = nullptr;
+	}
+
+	OutputLog("Capture: %d frames, %d KB of audio\n", writtenFrames, audioBytes / 1024);
+}
+
+void nes_capture_thread::frameFinished() {
+	if (videoOut == nullptr) {
+		return;
+	}
+
+	// publish the finished buffer only after its pixels have been written
+	MemoryBarrier();
+	postedFrames = postedFrames + 1;
+
+	// the next frame draws over the buffer the writer had, wait until it is done with it
+	while (postedFrames - writtenFrames > 1) {
+		Sleep(0);
+	}
+}
+
+int* nes_capture_thread::beginAudio(int32 length) {
+	if (audioOut == nullptr) {
+		return nullptr;
+	}
+
+	DebugAssert(length <= CAPTURE_AUDIO_BLOCK);
+	while (audioHead - audioTail >= CAPTURE_AUDIO_BLOCKS) {
+		Sleep(0);
+	}
+	return audio[audioHead & (CAPTURE_AUDIO_BLOCKS - 1)].samples;
+}
+
+void nes_capture_thread::endAudio(int32 length) {
+	if (audioOut == nullptr) {
+		return;
+	}
+
+	audio[audioHead & (CAPTURE_AUDIO_BLOCKS - 1)].length = length;
+	MemoryBarrier();
+	audioHead = audioHead + 1;
+}
+
+void nes_capture_thread::run() {
+	for (;;) {
+		bool bIdle = true;
+
+		if (writtenFrames != postedFrames) {
+			// make sure the frame contents are visible before reading them
+			MemoryBarrier();
+			writeFrame(frames[writtenFrames & 1]);
+			MemoryBarrier();
+			writtenFrames = writtenFrames + 1;
+			bIdle = false;
+		}
+
+		if (audioTail != audioHead) {
+			MemoryBarrier();
+			writeAudio(audio[audioTail & (CAPTURE_AUDIO_BLOCKS - 1)]);
+			MemoryBarrier();
+			audioTail = audioTail + 1;
+			bIdle = false;
+		}
+
+		if (bIdle) {
+			if (bStop)
+				break;
+			Sleep(1);
+		}
+	}
+}
+
+void nes_capture_thread::writeFrame(const nes_capture_frame& frame) {
+	const int32 numPixels = CAPTURE_WIDTH * CAPTURE_HEIGHT;
+
+	if (videoFormat == CAPTURE_VIDEO_RGB565) {
+		fwrite(frame.pixels, sizeof(uint16), numPixels, videoOut);
+		return;
+	}
+
+	uint8* Y = outFrame;
+	uint8* U = outFrame + numPixels;
+	uint8* V = outFrame + numPixels * 2;
+	uint8* rgb = outFrame;
+	for (int32 i = 0; i < numPixels; i++) {
+		// 565 to 888 replicating the top bits into the low ones
+		const uint16 pixel = frame.pixels[i];
+		const int32 r = ((pixel >> 8) & 0xF8) | (pixel >> 13);
+		const int32 g = ((pixel >> 3) & 0xFC) | ((pixel >> 9) & 3);
+		const int32 b = ((pixel << 3) & 0xF8) | ((pixel >> 2) & 7);
+
+		if (videoFormat == CAPTURE_VIDEO_Y4M) {
+			// BT.601 studio range
+			Y[i] = uint8(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+			U[i] = uint8(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+			V[i] = uint8(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+		} else {
+			*rgb++ = uint8(r);
+			*rgb++ = uint8(g);
+			*rgb++ = uint8(b);
+		}
+	}
+
+	if (videoFormat == CAPTURE_VIDEO_Y4M) {
+		fwrite("FRAME\n", 1, 6, videoOut);
+	}
+	fwrite(outFrame, 1, numPixels * 3, videoOut);
+}
+
+void nes_capture_thread::writeAudio(const nes_capture_audio& block) {
+	int16 samples[CAPTURE_AUDIO_BLOCK];
+	for (int32 i = 0; i < block.length; i++) {
+		// same high pass as playback, without the volume
+		const int32 level = block.samples[i];
+		dcLevel += ((level << 16) - dcLevel) >> 10;
+
+		int32 sample = (level - (dcLevel >> 16)) * 2;
+		if (sample > 32767) sample = 32767;
+		if (sample < -32768) sample = -32768;
+		samples[i] = int16(sample);
+	}
+
+	fwrite(samples, sizeof(int16), block.length, audioOut);
+	audioBytes += block.length * 2;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "nes.h"
+
+// Audio and video capture for the host build, for regression runs, bug reports and bots. Scanlines are resolved
+// straight into one of two frame buffers the capture owns and each mixed audio block is mixed straight into a
+// capture block, so the emulation side never copies. A writer thread streams them to Y4M or raw video and WAV.
+
+#if CAPTURE_THREAD
+
+// the rendered part of the picture (scanlines 9-232, clipped to 240 wide like the screen)
+#define CAPTURE_WIDTH 240
+#define CAPTURE_HEIGHT 224
+#define CAPTURE_FIRST_SCANLINE 9
+
+#define CAPTURE_AUDIO_BLOCKS 8			// mixed blocks in flight (power of 2)
+#define CAPTURE_AUDIO_BLOCK 4096		// samples per block at most
+
+enum nes_capture_video {
+	CAPTURE_VIDEO_NONE,
+	CAPTURE_VIDEO_Y4M,				// 4:4:4 YUV4MPEG2
+	CAPTURE_VIDEO_RGB565,			// raw native endian 16 bit pixels
+	CAPTURE_VIDEO_RGB24				// raw 8 bit R, G, B
+};
+
+struct nes_capture_frame {
+	uint16 pixels[CAPTURE_WIDTH * CAPTURE_HEIGHT];
+};
+
+struct nes_capture_audio {
+	int samples[CAPTURE_AUDIO_BLOCK];
+	int32 length;
+};
+
+struct nes_capture_thread {
+	// video and audio files are each optional, returns false if neither could be created. With bEveryFrame the
+	// frames the display skips are still rendered so the video has all of them
+	bool start(int32 videoFormat, const char* videoFile, const char* wavFile, bool bEveryFrame);
+	void stop();
+
+	bool isActive() const {
+		return thread != nullptr;
+	}
+
+	bool capturesAudio() const {
+		return thread != nullptr && audioOut != nullptr;
+	}
+
+	bool wantsEveryFrame() const {
+		return thread != nullptr && videoOut != nullptr && bEveryFrame;
+	}
+
+	// render side (whichever thread resolves scanlines), where to put a scanline's pixels or null if not captured
+	FORCE_INLINE uint16* videoRow(int scanline) {
+		const int row = scanline - CAPTURE_FIRST_SCANLINE;
+		if (videoOut == nullptr || unsigned(row) >= CAPTURE_HEIGHT) {
+			return nullptr;
+		}
+		return frames[postedFrames & 1].pixels + row * CAPTURE_WIDTH;
+	}
+
+	// hands the drawn frame to the writer and starts on the other buffer
+	void frameFinished();
+
+	// emulation thread side, block to mix length samples into (null if audio isn't captured), then hand it over
+	int* beginAudio(int32 length);
+	void endAudio(int32 length);
+
+	// writer thread side
+	void run();
+
+private:
+	void writeFrame(const nes_capture_frame& frame);
+	void writeAudio(const nes_capture_audio& block);
+
+	void* thread;
+	volatile bool bStop;
+	bool bEveryFrame;
+
+	FILE* videoOut;
+	FILE* audioOut;
+	int32 videoFormat;
+	int32 audioBytes;
+	int32 dcLevel;
+
+	// the frame being drawn is frames[postedFrames & 1], the writer owns the other until it catches up
+	nes_capture_frame frames[2];
+	volatile uint32 postedFrames;
+	volatile uint32 writtenFrames;
+
+	nes_capture_audio audio[CAPTURE_AUDIO_BLOCKS];
+	volatile uint32 audioHead;		// written by the emulation thread
+	volatile uint32 audioTail;		// written by the writer thread
+
+	// converted output frame (planar for Y4M, packed for RGB24)
+	uint8 outFrame[CAPTURE_WIDTH * CAPTURE_HEIGHT * 3];
+};
+
+extern nes_capture_thread nesCapture;
+
+#endif
@@ -7,6 +7,9 @@
 #include "frontend.h"
 #include "imageDraw.h"
 #include "settings.h"
+#include "render_thread.h"
+#include "audio_thread.h"
+#include "capture_thread.h"
 
 /*
 Menu Layout
@@ -23,6 +26,12 @@ Menu Layout
 
 const bool bRebuildGfx = false;
 
+// writes a .nesz next to every .nes found (winsim only)
+const bool bPackROMs = false;
+
+// runs each game headless for this many frames when play starts and logs its speed (winsim only)
+const int32 benchmarkFrames = 0;
+
 bool shouldExit = false;
 
 struct foundFile {
@@ -109,7 +118,20 @@ static void FindFiles(const char* path, foundFile* toArray, int& numFound, int m
 	ret = Bfile_FindFirst((const char*)filter, &handle, (char*)found, &info);
 
 	while (ret == 0 && numFound < maxAllowed) {
-		Bfile_NameToStr_ncpy(toArray[numFound++].path, found, 48);
+		Bfile_NameToStr_ncpy(toArray[numFound].path, found, 48);
+
+		// some file systems match short extensions against longer ones (*.nes finding .nesz)
+		bool bDuplicate = false;
+		for (int i = 0; i < numFound; i++) {
+			if (!strcmp(toArray[i].path, toArray[numFound].path)) {
+				bDuplicate = true;
+				break;
+			}
+		}
+		if (!bDuplicate) {
+			numFound++;
+		}
+
 		ret = Bfile_FindNext(handle, (char*)found, (char*)&info);
 	};
 
@@ -124,6 +146,22 @@ foundFile* discoverFiles(int& numFound) {
 	if (!lastFound) {
 		numFound = 0;
 		FindFiles("\\\\fls0\\*.nes", files, numFound, 64);
+
+#if TARGET_WINSIM
+		if (bPackROMs) {
+			for (int i = 0; i < numFound; i++) {
+				char romFile[128];
+				char packedFile[128];
+				sprintf(romFile, "\\\\fls0\\%s", files[i].path);
+				sprintf(packedFile, "%sz", romFile);
+				if (strlen(strrchr(romFile, '.')) == 4) {
+					PackROM(romFile, packedFile);
+				}
+			}
+		}
+#endif
+
+		FindFiles("\\\\fls0\\*.nesz", files, numFound, 64);
 		lastFound = numFound;
 	}
 
@@ -139,22 +177,12 @@ static bool LoadROM(const char* filename, bool bShowCodes = true) {
 	char romFile[128];
 	sprintf(romFile, "\\\\fls0\\%s", filename);
 	if (nesCart.loadROM(romFile)) {
-		// check for game genie application and display
-		const char* code0 = nullptr;
-		const char* code1 = nullptr;
-		int32 numCodes = 0;
-		for (int i = 0; i < 10; i++) {
-			if (nesSettings.codes[i].isActive()) {
-				if (i == 0) code0 = nesSettings.codes[i].getText();
-				if (i == 1) code1 = nesSettings.codes[i].getText();
-				numCodes++;
-			} else
-				break;
-		}
+		// check for cheat code application and display
+		const int32 numCodes = nesCheats.numCodes;
 		if (numCodes && bShowCodes) {
 			char appliedText[32];
-			sprintf(appliedText, "Using %d Game Genie Code(s)", numCodes);
-			DrawInfoBox(appliedText, code0, code1);
+			sprintf(appliedText, "Using %d Cheat Code(s)", numCodes);
+			DrawInfoBox(appliedText, nesCheats.codes[0].text, numCodes > 1 ? nesCheats.codes[1].text : nullptr);
 		}
 
 		mainCPU.reset();
@@ -368,7 +396,7 @@ static void renderPalette() {
 			int gridX = 384 - (16 - x) * totalGrid;
 			int gridY = 4 + y * totalGrid;
 
-			PrizmImage::Draw_FilledRect(gridX+1, gridY+1, gridSize-2, gridSize-2, nesPPU.rgbPalette[x + y * 16]);
+			PrizmImage::Draw_FilledRect(gridX+1, gridY+1, gridSize-2, gridSize-2, nesPPU.rgbPaletteBank[0][x + y * 16]);
 			PrizmImage::Draw_BorderRect(gridX, gridY, gridSize, gridSize, 1, 0b0011100111000111);
 		}
 	}
@@ -392,6 +420,11 @@ static void Option_Detail(MenuOption* forOption, int x, int y, int textColor, bo
 		} else {
 			forOption->DrawHelp();
 		}
+
+		// the rewind budget is sized when the game runs, it may not have held this cart's states
+		if (type == ST_Rewind && nesRewind.bUnavailable && nesRewind.budgetSetting == nesSettings.GetSetting(ST_Rewind)) {
+			CalcType_Draw(&arial_small, "Not enough memory for this game!", 192, 45, COLOR_RED, 0, 0);
+		}
 	}
 }
 
@@ -804,26 +837,75 @@ void nes_frontend::Run() {
 	} while (true);
 }
 
+// runs the CPU to the next PPU / APU / IRQ event and handles it
+static FORCE_INLINE void StepMachine() {
+	NES_LOCAL_MACHINE();
+
+	cpu6502_Step();
+	if (mainCPU.clocks >= mainCPU.ppuClocks) nesPPU.step();
+	if (mainCPU.clocks >= mainCPU.apuClocks) nesAPU.step();
+
+	// both APU and PPU can trigger an immediate IRQ
+	if (mainCPU.irqMask) {
+		if ((mainCPU.irqMask & 1) && mainCPU.clocks >= mainCPU.irqClock[0]) cpu6502_IRQ(0);
+		else if ((mainCPU.irqMask & 2) && mainCPU.clocks >= mainCPU.irqClock[1]) cpu6502_IRQ(1);
+		else if ((mainCPU.irqMask & 4) && mainCPU.clocks >= mainCPU.irqClock[2]) cpu6502_IRQ(2);
+		else if ((mainCPU.irqMask & 8) && mainCPU.clocks >= mainCPU.irqClock[3]) cpu6502_IRQ(3);
+	}
+}
+
+void nes_frontend::RunFrame() {
+	nesPPU.bFrameEnded = false;
+	while (!nesPPU.bFrameEnded) {
+		StepMachine();
+	}
+}
+
 void nes_frontend::RunGameLoop() {
+#if TARGET_WINSIM
+	if (benchmarkFrames) {
+		nesHeadless.benchmark(benchmarkFrames);
+	}
+#endif
+
+#if PPU_RENDER_THREAD
+	nesRenderThread.start();
+#endif
+
 	while (!shouldExit) {
-		cpu6502_Step();
-		if (mainCPU.clocks >= mainCPU.ppuClocks) nesPPU.step();
-		if (mainCPU.clocks >= mainCPU.apuClocks) nesAPU.step();
-
-		// both APU and PPU can trigger an immediate IRQ
-		if (mainCPU.irqMask) {
-			if ((mainCPU.irqMask & 1) && mainCPU.clocks >= mainCPU.irqClock[0]) cpu6502_IRQ(0);
-			else if ((mainCPU.irqMask & 2) && mainCPU.clocks >= mainCPU.irqClock[1]) cpu6502_IRQ(1);
-			else if ((mainCPU.irqMask & 4) && mainCPU.clocks >= mainCPU.irqClock[2]) cpu6502_IRQ(2);
-			else if ((mainCPU.irqMask & 8) && mainCPU.clocks >= mainCPU.irqClock[3]) cpu6502_IRQ(3);
+		StepMachine();
+
+#if TARGET_WINSIM
+		if (nesPPU.bFrameEnded) {
+			nesPPU.bFrameEnded = false;
+#if APU_AUDIO_THREAD
+			// mixed before run ahead so the frames it throws away are never heard
+			nesAudioThread.frameEnded();
+#endif
+			nesRunAhead.frameEnded();
 		}
+#endif
 	}
 
+#if PPU_RENDER_THREAD
+	nesRenderThread.stop();
+#endif
+
+#if CAPTURE_THREAD
+	// files are completed when play stops
+	nesCapture.stop();
+#endif
+
 	nesCart.OnPause();
 	shouldExit = false;
 }
 
 void nes_frontend::ResetPressed() {
+#if PPU_RENDER_THREAD
+	// finish drawing before the info box goes over the screen
+	nesRenderThread.sync();
+#endif
+
 	int32 keyEntered =
 		DrawInfoBox("Reset Game?", "Press EXE to reset", "Any other key to continue.");
 
@@ -871,6 +953,7 @@ MenuOption remapOptions[] =
 	{ "Save State", "", false, Option_RemapKey, Option_GetKeyDetails, NES_SAVESTATE},
 	{ "Load State", "", false, Option_RemapKey, Option_GetKeyDetails, NES_LOADSTATE},
 	{ "Fast Fwd", "", false, Option_RemapKey, Option_GetKeyDetails, NES_FASTFORWARD},
+	{ "Rewind", "", false, Option_RemapKey, Option_GetKeyDetails, NES_REWIND},
 	{ "Volume Up", "", false, Option_RemapKey, Option_GetKeyDetails, NES_VOL_UP},
 	{ "Volume Down", "", false, Option_RemapKey, Option_GetKeyDetails, NES_VOL_DOWN},
 	{ "P2 A", "", false, Option_RemapKey, Option_GetKeyDetails, NES_P2_A},
@@ -50,6 +50,9 @@ public:
 	void SetMainMenu();
 	void Run();
 	void RunGameLoop();
+
+	// emulates until the current frame ends (after the keys for the next one are read)
+	void RunFrame();
 	void RenderTimeToBuffer(unsigned short* buffer);
 	void RenderFPS(int32 fps, unsigned short* buffer);
 
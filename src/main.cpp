@@ -34,6 +34,15 @@ int main(void) {
 	unsigned char stackBanks[STATIC_CACHED_ROM_BANKS * 8192] ALIGN(256);
 	nesCart.allocateBanks(stackBanks);
 
+#if TARGET_WINSIM
+	// regression runs go straight through the manifest instead of the menus
+	if (const char* batchManifest = getenv("NESIZM_BATCH")) {
+		const bool bPassed = RunBatch(batchManifest, getenv("NESIZM_BATCH_RESULTS"));
+		ScopeTimer::Shutdown();
+		return bPassed ? 0 : 1;
+	}
+#endif
+
 	nesFrontend.SetMainMenu();
 	nesFrontend.Run();
 
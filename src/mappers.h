@@ -56,225 +56,352 @@ inline void mapPPU(unsigned int startAddrHigh, unsigned int numKB, unsigned char
 	DebugAssert(startAddrHigh * 0x100 + numKB * 1024 <= 0x2000);
 	DebugAssert(numKB <= 4);
 
-	int page = (startAddrHigh & 0x10) >> 4;
-	startAddrHigh &= 0x0F;
-	memcpy_fast32(nesPPU.chrPages[page] + startAddrHigh * 0x100, ptr, numKB * 1024);
+	// 256 bytes at a time since the range may straddle 1 kb pages
+	for (unsigned int i = 0; i < numKB * 4; i++, startAddrHigh++, ptr += 0x100) {
+		memcpy_fast32(nesPPU.chrPages[startAddrHigh >> 2] + (startAddrHigh & 3) * 0x100, ptr, 0x100);
+	}
+}
+
+// mapper interfaces (defined in each mapper file, listed in nes_cart.cpp)
+extern const nes_mapper Mapper1_MMC1;
+extern const nes_mapper Mapper4_MMC3;
+extern const nes_mapper Mapper9_MMC2;
+extern const nes_mapper Mapper34_BNROM;
+extern const nes_mapper Mapper64_Rambo1;
+extern const nes_mapper Mapper67_Sunsoft3;
+extern const nes_mapper Mapper68_Sunsoft4;
+extern const nes_mapper Mapper69_Sunsoft;
+extern const nes_mapper Mapper163_Nanjing;
+
+// discrete logic boards (mapper_discrete.cpp)
+extern const nes_mapper Mapper0_NROM;
+extern const nes_mapper Mapper2_UNROM;
+extern const nes_mapper Mapper3_CNROM;
+extern const nes_mapper Mapper7_AOROM;
+extern const nes_mapper Mapper11_ColorDreams;
+extern const nes_mapper Mapper38_BitCorp;
+extern const nes_mapper Mapper66_GXROM;
+extern const nes_mapper Mapper70_Bandai;
+extern const nes_mapper Mapper71_Camerica;
+extern const nes_mapper Mapper79_AVE;
+extern const nes_mapper Mapper93_Sunsoft2;
+extern const nes_mapper Mapper94_UN1ROM;
+extern const nes_mapper Mapper101_JF10;
+extern const nes_mapper Mapper107_MagicDragon;
+extern const nes_mapper Mapper133_Sachen3009;
+extern const nes_mapper Mapper140_JF11;
+extern const nes_mapper Mapper145_SA72007;
+extern const nes_mapper Mapper148_SA0037;
+extern const nes_mapper Mapper149_SA0036;
+extern const nes_mapper Mapper152_Bandai;
+extern const nes_mapper Mapper180_UNROM;
+extern const nes_mapper Mapper240;
+extern const nes_mapper Mapper241;
+
+// typed view of the cart register storage for the mapper in use. Each state keeps the register order the FCEUX save
+// state code reads and writes them in
+template<typename T>
+FORCE_INLINE T& MapperState() {
+	CT_ASSERT(sizeof(T) <= sizeof(nesCart.registers));
+	return *(T*) nesCart.registers;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // MMC1
 
-// register 0 holds board disambiguation
-// 0 : S*ROM (most common formats with same interface. This includes SNROM whose RAM enable bit won't be implemented)
-// 1 : SOROM (extra RAM bank, bit 3 of chr bank select selects RAM bank)
-// 2 : SUROM (512 KB PRG ROM, high chr bank bit selects bank)
-// 3 : SXROM (32 KB RAM, bits 3-4 of chr bank select selects RAM bank high bits)
-#define MMC1_BOARD_TYPE nesCart.registers[0]
-#define MMC1_S_ROM 0
-#define MMC1_SOROM 1
-#define MMC1_SUROM 2
-#define MMC1_SXROM 3
+struct nes_mmc1_state {
+	// board disambiguation
+	// 0 : S*ROM (most common formats with same interface. This includes SNROM whose RAM enable bit won't be implemented)
+	// 1 : SOROM (extra RAM bank, bit 3 of chr bank select selects RAM bank)
+	// 2 : SUROM (512 KB PRG ROM, high chr bank bit selects bank)
+	// 3 : SXROM (32 KB RAM, bits 3-4 of chr bank select selects RAM bank high bits)
+	unsigned int boardType;
 
-// register 1 holds the shift register bit
-#define MMC1_SHIFT_BIT nesCart.registers[1]
+	// shift register bit and value
+	unsigned int shiftBit;
+	unsigned int shiftValue;
 
-// register 2 holds the shift register value
-#define MMC1_SHIFT_VALUE nesCart.registers[2]
+	unsigned int prgBankMode;
+	unsigned int chrBankMode;
 
-// register 3 holds PRG bank mode
-#define MMC1_PRG_BANK_MODE nesCart.registers[3]
+	// RAM chip enable bit (0 = enabled)
+	unsigned int ramDisable;
 
-// register 4 holds CHR bank mode
-#define MMC1_CHR_BANK_MODE nesCart.registers[4]
+	// bank containing the ram
+	unsigned int ramBank;
 
-// register 5 holds the RAM chip enable bit (0 = enabled)
-#define MMC1_RAM_DISABLE nesCart.registers[5]
+	// PRG bank in lower and higher 16 KB
+	unsigned int prgBank1;
+	unsigned int prgBank2;
+};
 
-// register 6 holds the bank containing the ram
-#define MMC1_RAM_BANK nesCart.registers[6]
+#define MMC1_STATE MapperState<nes_mmc1_state>()
 
-// register 7 holds the PRG bank in lower 16 KB
-#define MMC1_PRG_BANK_1 nesCart.registers[7]
+#define MMC1_BOARD_TYPE MMC1_STATE.boardType
+#define MMC1_S_ROM 0
+#define MMC1_SOROM 1
+#define MMC1_SUROM 2
+#define MMC1_SXROM 3
 
-// register 8 holds the PRG bank in higher 16 KB 
-#define MMC1_PRG_BANK_2 nesCart.registers[8]
+#define MMC1_SHIFT_BIT MMC1_STATE.shiftBit
+#define MMC1_SHIFT_VALUE MMC1_STATE.shiftValue
+#define MMC1_PRG_BANK_MODE MMC1_STATE.prgBankMode
+#define MMC1_CHR_BANK_MODE MMC1_STATE.chrBankMode
+#define MMC1_RAM_DISABLE MMC1_STATE.ramDisable
+#define MMC1_RAM_BANK MMC1_STATE.ramBank
+#define MMC1_PRG_BANK_1 MMC1_STATE.prgBank1
+#define MMC1_PRG_BANK_2 MMC1_STATE.prgBank2
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// CNROM (switchable CHR banks)
+// Discrete logic boards (single latch, see mapper_discrete.cpp)
+
+struct nes_discrete_state {
+	// last value written to the bank latch (saved as the FCEUX LATC chunk)
+	unsigned int latch;
+
+	// last value written to a separate mirroring register, 0x100 set once written
+	unsigned int mirrorLatch;
+};
 
-// registers[0] = current mapped CHR bank
-#define CNROM_CUR_CHR_BANK nesCart.registers[0]
+#define DISCRETE_LATCH MapperState<nes_discrete_state>().latch
+#define DISCRETE_MIRROR_LATCH MapperState<nes_discrete_state>().mirrorLatch
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // MMC3 (most popular mapper with IRQ)
 
-// register 0-7 holds the 8 bank registers
-#define MMC3_BANK_REG nesCart.registers
+struct nes_mmc3_state {
+	// the 8 bank registers
+	unsigned int bankReg[8];
 
-// register 8 is the bank select register (control values)
-#define MMC3_BANK_SELECT nesCart.registers[8]
+	// bank select register (control values)
+	unsigned int bankSelect;
 
-// register 9 is the IRQ counter latch value (the set value on reload)
-#define MMC3_IRQ_SET nesCart.registers[9]
+	// IRQ counter latch value (the set value on reload)
+	unsigned int irqSet;
 
-// register 10 is the IRQ counter reload flag
-#define MMC3_IRQ_RELOAD nesCart.registers[10]
+	// IRQ counter reload flag
+	unsigned int irqReload;
 
-// register 11 is the actual IRQ counter value
-#define MMC3_IRQ_COUNTER nesCart.registers[11]
+	// actual IRQ counter value
+	unsigned int irqCounter;
 
-// register 12 is the IRQ interrupt triggle enable/disable flag
-#define MMC3_IRQ_ENABLE nesCart.registers[12]
+	// IRQ interrupt trigger enable/disable flag
+	unsigned int irqEnable;
 
-// register 13 is the IRQ latch (when set, IRQ is dispatched with each A12 jump)
-#define MMC3_IRQ_LATCH nesCart.registers[13]
+	// IRQ latch (when set, IRQ is dispatched with each A12 jump)
+	unsigned int irqLatch;
 
-// registers 16-19 contain an integer of the last time the IRQ counter was reset, used to fix IRQ timing since we are cheating by performing logic at beginning ot scanline
-#define MMC3_IRQ_LASTSET *((unsigned int*) &nesCart.registers[16])
+	unsigned int unused[2];
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// AOROM (switches nametables for single screen mirroring)
+	// last time the IRQ counter was reset, used to fix IRQ timing since we are cheating by performing logic at beginning ot scanline
+	unsigned int irqLastSet;
+};
+
+#define MMC3_STATE MapperState<nes_mmc3_state>()
 
-// registers[0] = current nametable page (1 or 0)
-#define AOROM_CUR_NAMETABLE nesCart.registers[0]
+#define MMC3_BANK_REG MMC3_STATE.bankReg
+#define MMC3_BANK_SELECT MMC3_STATE.bankSelect
+#define MMC3_IRQ_SET MMC3_STATE.irqSet
+#define MMC3_IRQ_RELOAD MMC3_STATE.irqReload
+#define MMC3_IRQ_COUNTER MMC3_STATE.irqCounter
+#define MMC3_IRQ_ENABLE MMC3_STATE.irqEnable
+#define MMC3_IRQ_LATCH MMC3_STATE.irqLatch
+#define MMC3_IRQ_LASTSET MMC3_STATE.irqLastSet
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // MMC2 (Punch Out mapper)
 
-// register 0 is the current low CHR map latch value : 0 = FD, 1 = FE
-#define MMC2_LOLATCH nesCart.registers[0]
-
-// register 1 is the current high CHR map latch value : 0 = FD, 1 = FE
-#define MMC2_HILATCH nesCart.registers[1]
-
-// register 2 is the current bank copied into the PRG select
-#define MMC2_PRG_SELECT nesCart.registers[2]
+struct nes_mmc2_state {
+	// current low and high CHR map latch values : 0 = FD, 1 = FE
+	unsigned int loLatch;
+	unsigned int hiLatch;
 
-// register 3 is the current 4K CHR bank selected for low CHR map, latched with FD
-#define MMC2_CHR_LOW_FD nesCart.registers[3]
+	// current bank copied into the PRG select
+	unsigned int prgSelect;
 
-// register 4 is the current 4K CHR bank selected for low CHR map, latched with FE
-#define MMC2_CHR_LOW_FE nesCart.registers[4]
+	// current 4K CHR banks selected for the low and high CHR maps, latched with FD and FE
+	unsigned int chrLowFD;
+	unsigned int chrLowFE;
+	unsigned int chrHighFD;
+	unsigned int chrHighFE;
+};
 
-// register 5 is the current 4K CHR bank selected for high CHR map, latched with FD
-#define MMC2_CHR_HIGH_FD nesCart.registers[5]
+#define MMC2_STATE MapperState<nes_mmc2_state>()
 
-// register 6 is the current 4K CHR bank selected for high CHR map, latched with FE
-#define MMC2_CHR_HIGH_FE nesCart.registers[6]
-
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Color Dreams Mapper 11
-
-#define Mapper11_PRG_SELECT nesCart.registers[0]
-
-#define Mapper11_CHR_SELECT nesCart.registers[1]
+#define MMC2_LOLATCH MMC2_STATE.loLatch
+#define MMC2_HILATCH MMC2_STATE.hiLatch
+#define MMC2_PRG_SELECT MMC2_STATE.prgSelect
+#define MMC2_CHR_LOW_FD MMC2_STATE.chrLowFD
+#define MMC2_CHR_LOW_FE MMC2_STATE.chrLowFE
+#define MMC2_CHR_HIGH_FD MMC2_STATE.chrHighFD
+#define MMC2_CHR_HIGH_FE MMC2_STATE.chrHighFE
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // BNROM/NINA-1 Mapper 34
 
-#define Mapper34_PRG_BANK nesCart.registers[0]
-#define Mapper34_CHR1 nesCart.registers[1]
-#define Mapper34_CHR2 nesCart.registers[2]
+struct nes_mapper34_state {
+	unsigned int prgBank;
+	unsigned int chr1;
+	unsigned int chr2;
+};
+
+#define Mapper34_PRG_BANK MapperState<nes_mapper34_state>().prgBank
+#define Mapper34_CHR1 MapperState<nes_mapper34_state>().chr1
+#define Mapper34_CHR2 MapperState<nes_mapper34_state>().chr2
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Rambo-1 Mapper 64
 
-#define Mapper64_BANK_SELECT nesCart.registers[0]
-#define Mapper64_R0 nesCart.registers[1]
-#define Mapper64_R1 nesCart.registers[2]
-#define Mapper64_R2 nesCart.registers[3]
-#define Mapper64_R3 nesCart.registers[4]
-#define Mapper64_R4 nesCart.registers[5]
-#define Mapper64_R5 nesCart.registers[6]
-#define Mapper64_R6 nesCart.registers[7]
-#define Mapper64_R7 nesCart.registers[8]
-#define Mapper64_R8 nesCart.registers[9]
-#define Mapper64_R9 nesCart.registers[10]
-#define Mapper64_RF nesCart.registers[11]
-
-#define Mapper64_IRQ_LATCH nesCart.registers[12]
-#define Mapper64_IRQ_MODE nesCart.registers[13]
-#define Mapper64_IRQ_ENABLE nesCart.registers[14]
-#define Mapper64_IRQ_COUNT nesCart.registers[15]
-#define Mapper64_IRQ_CLOCKS nesCart.registers[16]
+struct nes_mapper64_state {
+	unsigned int bankSelect;
+
+	// R0 - R9, RF
+	unsigned int regs[11];
+
+	unsigned int irqLatch;
+	unsigned int irqMode;
+	unsigned int irqEnable;
+	unsigned int irqCount;
+	unsigned int irqClocks;
+};
+
+#define Mapper64_STATE MapperState<nes_mapper64_state>()
+
+#define Mapper64_BANK_SELECT Mapper64_STATE.bankSelect
+#define Mapper64_R0 Mapper64_STATE.regs[0]
+#define Mapper64_R1 Mapper64_STATE.regs[1]
+#define Mapper64_R2 Mapper64_STATE.regs[2]
+#define Mapper64_R3 Mapper64_STATE.regs[3]
+#define Mapper64_R4 Mapper64_STATE.regs[4]
+#define Mapper64_R5 Mapper64_STATE.regs[5]
+#define Mapper64_R6 Mapper64_STATE.regs[6]
+#define Mapper64_R7 Mapper64_STATE.regs[7]
+#define Mapper64_R8 Mapper64_STATE.regs[8]
+#define Mapper64_R9 Mapper64_STATE.regs[9]
+#define Mapper64_RF Mapper64_STATE.regs[10]
+
+#define Mapper64_IRQ_LATCH Mapper64_STATE.irqLatch
+#define Mapper64_IRQ_MODE Mapper64_STATE.irqMode
+#define Mapper64_IRQ_ENABLE Mapper64_STATE.irqEnable
+#define Mapper64_IRQ_COUNT Mapper64_STATE.irqCount
+#define Mapper64_IRQ_CLOCKS Mapper64_STATE.irqClocks
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Sunsoft 3 Mapper 67
 
-#define Mapper67_CHR0 nesCart.registers[0]
-#define Mapper67_CHR1 nesCart.registers[1]
-#define Mapper67_CHR2 nesCart.registers[2]
-#define Mapper67_CHR3 nesCart.registers[3]
+struct nes_mapper67_state {
+	unsigned int chr[4];
+
+	unsigned int irqWriteToggle;
+	unsigned int irqLastSet;
+	unsigned int irqCounter;
+	unsigned int irqEnable;
+
+	unsigned int prg;
+};
+
+#define Mapper67_STATE MapperState<nes_mapper67_state>()
 
-#define Mapper67_IRQ_WriteToggle nesCart.registers[4]
-#define Mapper67_IRQ_LastSet nesCart.registers[5]
-#define Mapper67_IRQ_Counter nesCart.registers[6]
-#define Mapper67_IRQ_Enable nesCart.registers[7]
+#define Mapper67_CHR0 Mapper67_STATE.chr[0]
+#define Mapper67_CHR1 Mapper67_STATE.chr[1]
+#define Mapper67_CHR2 Mapper67_STATE.chr[2]
+#define Mapper67_CHR3 Mapper67_STATE.chr[3]
 
-#define Mapper67_PRG nesCart.registers[8]
+#define Mapper67_IRQ_WriteToggle Mapper67_STATE.irqWriteToggle
+#define Mapper67_IRQ_LastSet Mapper67_STATE.irqLastSet
+#define Mapper67_IRQ_Counter Mapper67_STATE.irqCounter
+#define Mapper67_IRQ_Enable Mapper67_STATE.irqEnable
+
+#define Mapper67_PRG Mapper67_STATE.prg
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Sunsoft 4 Mapper 68
 
-#define Mapper68_CHR0 nesCart.registers[0]
-#define Mapper68_CHR1 nesCart.registers[1]
-#define Mapper68_CHR2 nesCart.registers[2]
-#define Mapper68_CHR3 nesCart.registers[3]
+struct nes_mapper68_state {
+	unsigned int chr[4];
+
+	// nametable banks and mode
+	unsigned int nt0;
+	unsigned int nt1;
+	unsigned int ntm;
+
+	unsigned int unused;
+
+	unsigned int prg;
+};
 
-#define Mapper68_NT0 nesCart.registers[4]
-#define Mapper68_NT1 nesCart.registers[5]
-#define Mapper68_NTM nesCart.registers[6]
+#define Mapper68_STATE MapperState<nes_mapper68_state>()
 
-#define Mapper68_PRG nesCart.registers[8]
+#define Mapper68_CHR0 Mapper68_STATE.chr[0]
+#define Mapper68_CHR1 Mapper68_STATE.chr[1]
+#define Mapper68_CHR2 Mapper68_STATE.chr[2]
+#define Mapper68_CHR3 Mapper68_STATE.chr[3]
+
+#define Mapper68_NT0 Mapper68_STATE.nt0
+#define Mapper68_NT1 Mapper68_STATE.nt1
+#define Mapper68_NTM Mapper68_STATE.ntm
+
+#define Mapper68_PRG Mapper68_STATE.prg
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Sunsoft 5 Mapper 69
 
-#define Mapper69_CHAR0 nesCart.registers[0]
-#define Mapper69_CHAR1 nesCart.registers[1]
-#define Mapper69_CHAR2 nesCart.registers[2]
-#define Mapper69_CHAR3 nesCart.registers[3]
-#define Mapper69_CHAR4 nesCart.registers[4]
-#define Mapper69_CHAR5 nesCart.registers[5]
-#define Mapper69_CHAR6 nesCart.registers[6]
-#define Mapper69_CHAR7 nesCart.registers[7]
+struct nes_mapper69_state {
+	// registers written by commands 0-F : CHR 0-7, PRG 0-3, nametable, IRQ control, counter low and high
+	unsigned int commandRegs[16];
 
-#define Mapper69_PRG0 nesCart.registers[8]
-#define Mapper69_PRG1 nesCart.registers[9]
-#define Mapper69_PRG2 nesCart.registers[10]
-#define Mapper69_PRG3 nesCart.registers[11]
+	unsigned int command;
+	unsigned int param;
 
-#define Mapper69_NT nesCart.registers[12]
-#define Mapper69_IRQCONTROL nesCart.registers[13]
-#define Mapper69_COUNTERLO nesCart.registers[14]
-#define Mapper69_COUNTERHI nesCart.registers[15]
+	// next IRQ in cpu clocks
+	unsigned int irq;
 
-#define Mapper69_COMMAND nesCart.registers[16]
-#define Mapper69_PARAM nesCart.registers[17]
+	// counter value at last set
+	unsigned int lastCounter;
 
-// next IRQ in cpu clocks
-#define Mapper69_IRQ nesCart.registers[18]
+	// last clks used for counter value
+	unsigned int lastCounterClk;
+};
 
-// counter value at last set
-#define Mapper69_LASTCOUNTER nesCart.registers[19]
+#define Mapper69_STATE MapperState<nes_mapper69_state>()
 
-// last clks used for counter value
-#define Mapper69_LASTCOUNTERCLK nesCart.registers[20]
+#define Mapper69_CHAR0 Mapper69_STATE.commandRegs[0]
+#define Mapper69_CHAR1 Mapper69_STATE.commandRegs[1]
+#define Mapper69_CHAR2 Mapper69_STATE.commandRegs[2]
+#define Mapper69_CHAR3 Mapper69_STATE.commandRegs[3]
+#define Mapper69_CHAR4 Mapper69_STATE.commandRegs[4]
+#define Mapper69_CHAR5 Mapper69_STATE.commandRegs[5]
+#define Mapper69_CHAR6 Mapper69_STATE.commandRegs[6]
+#define Mapper69_CHAR7 Mapper69_STATE.commandRegs[7]
 
-/////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Mapper79 (American Video Entertainment)
+#define Mapper69_PRG0 Mapper69_STATE.commandRegs[8]
+#define Mapper69_PRG1 Mapper69_STATE.commandRegs[9]
+#define Mapper69_PRG2 Mapper69_STATE.commandRegs[10]
+#define Mapper69_PRG3 Mapper69_STATE.commandRegs[11]
+
+#define Mapper69_NT Mapper69_STATE.commandRegs[12]
+#define Mapper69_IRQCONTROL Mapper69_STATE.commandRegs[13]
+#define Mapper69_COUNTERLO Mapper69_STATE.commandRegs[14]
+#define Mapper69_COUNTERHI Mapper69_STATE.commandRegs[15]
 
-#define Mapper79_CONTROL_PRG nesCart.registers[0]
-#define Mapper79_CONTROL_CHAR nesCart.registers[1]
+#define Mapper69_COMMAND Mapper69_STATE.command
+#define Mapper69_PARAM Mapper69_STATE.param
+#define Mapper69_IRQ Mapper69_STATE.irq
+#define Mapper69_LASTCOUNTER Mapper69_STATE.lastCounter
+#define Mapper69_LASTCOUNTERCLK Mapper69_STATE.lastCounterClk
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Nanjing Mapper 163
 
-// register 0-7 holds the 8 registers (following FCEUX model). I do use REG[4] to indicate copy protection paging
-#define Mapper163_REG nesCart.registers
+struct nes_mapper163_state {
+	// the 8 registers (following FCEUX model). I do use REG[4] to indicate copy protection paging
+	unsigned int reg[8];
 
-// strobe register for write protection
-#define Mapper163_STROBE nesCart.registers[8]
+	// strobe and trigger registers for write protection
+	unsigned int strobe;
+	unsigned int trigger;
+};
 
-// trigger register for write protection
-#define Mapper163_TRIGGER nesCart.registers[9]
+#define Mapper163_REG MapperState<nes_mapper163_state>().reg
+#define Mapper163_STROBE MapperState<nes_mapper163_state>().strobe
+#define Mapper163_TRIGGER MapperState<nes_mapper163_state>().trigger
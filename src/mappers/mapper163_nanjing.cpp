@@ -50,12 +50,13 @@ void nes_cart::Mapper163_ScanlineClock() {
 	// if high bit of reg 1 is set, then first 4 KB of CHR RAM are mirrored for first half of screen and then this is swapped
 	if (Mapper163_REG[1] & 0x80) {
 		const int chrPage = nesCart.cachedBankCount + 1;
+		nesPPU.catchUp();
 		if (nesPPU.scanline == 240) {
-			nesPPU.chrPages[0] = nesCart.cache[chrPage].ptr;
-			nesPPU.chrPages[1] = nesCart.cache[chrPage].ptr;
+			nesPPU.mapChrPages(0, nesCart.cache[chrPage].ptr, 4);
+			nesPPU.mapChrPages(4, nesCart.cache[chrPage].ptr, 4);
 		} else if (nesPPU.scanline == 128) {
-			nesPPU.chrPages[0] = nesCart.cache[chrPage].ptr + 0x1000;
-			nesPPU.chrPages[1] = nesCart.cache[chrPage].ptr + 0x1000;
+			nesPPU.mapChrPages(0, nesCart.cache[chrPage].ptr + 0x1000, 4);
+			nesPPU.mapChrPages(4, nesCart.cache[chrPage].ptr + 0x1000, 4);
 		}
 	}
 }
@@ -75,8 +76,7 @@ void nes_cart::Mapper163_Update() {
 	// not using the chr flip mode
 	if ((Mapper163_REG[1] & 0x80) == 0) {
 		const int chrPage = cachedBankCount + 1;
-		nesPPU.chrPages[0] = cache[chrPage].ptr;
-		nesPPU.chrPages[1] = cache[chrPage].ptr + 0x1000;
+		nesPPU.mapChrPages(0, cache[chrPage].ptr, 8);
 	}
 
 	// update protect page values
@@ -98,11 +98,7 @@ void nes_cart::setupMapper163_Nanjing() {
 	// these carts only use CHR RAM
 	DebugAssert(!numCHRBanks);
 	// chr map uses best bank for chr caching locality:
-	nesPPU.chrPages[0] = cache[chrPage].ptr;
-	nesPPU.chrPages[1] = cache[chrPage].ptr + 0x1000;
-
-	scanlineClock = nes_cart::Mapper163_ScanlineClock;
-	writeSpecial = Mapper163_writeSpecial;
+	nesPPU.mapChrPages(0, cache[chrPage].ptr, 8);
 
 	// RAM bank if one is set up
 	if (numRAMBanks == 1) {
@@ -122,4 +118,11 @@ void nes_cart::setupMapper163_Nanjing() {
 	Mapper163_STROBE = 1;
 
 	Mapper163_Update();
-}
\ No newline at end of file
+}
+
+const nes_mapper Mapper163_Nanjing = {
+	"Nanjing", 163, -1,
+	&nes_cart::setupMapper163_Nanjing,
+	Mapper163_writeSpecial, nes_cart::Mapper163_ScanlineClock, nullptr,
+	nullptr, nullptr, &nes_cart::Mapper163_Update
+};
@@ -169,8 +169,6 @@ void nes_cart::MMC1_StateLoaded() {
 }
 
 void nes_cart::setupMapper1_MMC1() {
-	writeSpecial = MMC1_writeSpecial;
-
 	// disambiguate board type
 	if (numRAMBanks == 2) {
 		// SOROM
@@ -198,8 +196,7 @@ void nes_cart::setupMapper1_MMC1() {
 		cachedBankCount--;
 
 		// chr map uses best bank for chr caching locality:
-		nesPPU.chrPages[0] = cache[cachedBankCount].ptr;
-		nesPPU.chrPages[1] = cache[cachedBankCount].ptr + 0x1000;
+		nesPPU.mapChrPages(0, cache[cachedBankCount].ptr, 8);
 	}
 
 	// RAM bank (first index if applicable) set up at 0x6000
@@ -215,3 +212,10 @@ void nes_cart::setupMapper1_MMC1() {
 	MapProgramBanks(0, 0, 2);
 	MapProgramBanks(2, numPRGBanks * 2 - 2, 2);
 }
+
+const nes_mapper Mapper1_MMC1 = {
+	"MMC1", 1, -1,
+	&nes_cart::setupMapper1_MMC1,
+	MMC1_writeSpecial, nullptr, nullptr,
+	nullptr, nullptr, &nes_cart::MMC1_StateLoaded
+};
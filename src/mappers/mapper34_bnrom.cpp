@@ -55,8 +55,6 @@ void BNROM_writeSpecial(unsigned int address, unsigned char value) {
 }
 
 void nes_cart::setupMapper34_BNROM() {
-	writeSpecial = BNROM_writeSpecial;
-
 	cachedBankCount = availableROMBanks;
 
 	// read CHR bank (ROM or RAM) directly into PPU chrMap
@@ -67,8 +65,7 @@ void nes_cart::setupMapper34_BNROM() {
 	} else {
 		cachedBankCount--;
 		int chrBank = cachedBankCount;
-		nesPPU.chrPages[0] = cache[chrBank].ptr;
-		nesPPU.chrPages[1] = cache[chrBank].ptr + 0x1000;
+		nesPPU.mapChrPages(0, cache[chrBank].ptr, 8);
 	}
 
 	// map first 32 KB of PRG mamory to 80-FF by default
@@ -79,3 +76,10 @@ void nes_cart::setupMapper34_BNROM() {
 		mainCPU.setMapKB(0x60, 8, cache[availableROMBanks].ptr);
 	}
 }
+
+const nes_mapper Mapper34_BNROM = {
+	"BNROM", 34, -1,
+	&nes_cart::setupMapper34_BNROM,
+	BNROM_writeSpecial, nullptr, nullptr,
+	nullptr, nullptr, &nes_cart::Mapper34_Sync
+};
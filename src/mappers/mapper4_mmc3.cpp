@@ -200,8 +200,7 @@ void nes_cart::MMC3_ScanlineClock() {
 		int numSprites = 0;
 		int scanlineOffset = nesPPU.scanline - 2;
 
-		extern uint8 fetchMask[272];
-		for (int b = fetchMask[nesPPU.scanline]; b; b = b >> 1) {
+		for (int b = nesPPU.fetchMask[nesPPU.scanline]; b; b = b >> 1) {
 			if (!(b & 1)) {
 				curObj -= 32;
 				continue;
@@ -269,9 +268,6 @@ void nes_cart::MMC3_ScanlineClock() {
 }
 
 void nes_cart::setupMapper4_MMC3() {
-	writeSpecial = MMC3_writeSpecial;
-	scanlineClock = MMC3_ScanlineClock;
-
 	cachedBankCount = availableROMBanks;
 
 	// map first 8 KB of CHR memory to ppu chr if not ram
@@ -288,3 +284,21 @@ void nes_cart::setupMapper4_MMC3() {
 	// this will set up all non permanent memory
 	MMC3_UpdateMapping(-1);
 }
+
+bool nes_cart::MMC3_IRQReached() {
+	MMC3_IRQ_LATCH = 0;
+
+	mainCPU.ackIRQ(0);
+	return true;
+}
+
+void nes_cart::MMC3_RollbackClocks(unsigned int clockCount) {
+	MMC3_IRQ_LASTSET -= clockCount;
+}
+
+const nes_mapper Mapper4_MMC3 = {
+	"MMC3", 4, -1,
+	&nes_cart::setupMapper4_MMC3,
+	MMC3_writeSpecial, nes_cart::MMC3_ScanlineClock, nullptr,
+	&nes_cart::MMC3_IRQReached, &nes_cart::MMC3_RollbackClocks, &nes_cart::MMC3_StateLoaded
+};
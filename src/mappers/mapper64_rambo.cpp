@@ -129,8 +129,6 @@ void Mapper64_writeSpecial(unsigned int address, unsigned char value) {
 }
 
 void nes_cart::setupMapper64_Rambo1() {
-	writeSpecial = Mapper64_writeSpecial;
-
 	cachedBankCount = availableROMBanks;
 
 	DebugAssert(numCHRBanks > 0);
@@ -181,8 +179,7 @@ void nes_cart::Mapper64_ScanlineClock() {
 		int numSprites = 0;
 		int scanlineOffset = nesPPU.scanline - 2;
 
-		extern uint8 fetchMask[272];
-		for (int b = fetchMask[nesPPU.scanline]; b; b = b >> 1) {
+		for (int b = nesPPU.fetchMask[nesPPU.scanline]; b; b = b >> 1) {
 			if (!(b & 1)) {
 				curObj -= 32;
 				continue;
@@ -242,3 +239,34 @@ void nes_cart::Mapper64_ScanlineClock() {
 		}
 	}
 }
+
+bool nes_cart::Mapper64_IRQReached() {
+	if (Mapper64_IRQ_MODE == 1) {
+		// set next IRQ breakpoint
+		Mapper64_IRQ_CLOCKS = mainCPU.irqClock[0] + Mapper64_IRQ_COUNT + 4;
+		if (Mapper64_IRQ_ENABLE) {
+			mainCPU.setIRQ(0, Mapper64_IRQ_CLOCKS);
+			return true;
+		}
+
+		mainCPU.ackIRQ(0);
+		return false;
+	}
+
+	mainCPU.ackIRQ(0);
+	return true;
+}
+
+void nes_cart::Mapper64_RollbackClocks(unsigned int clockCount) {
+	if (Mapper64_IRQ_CLOCKS) {
+		Mapper64_IRQ_CLOCKS -= clockCount;
+	}
+}
+
+// starts in scanline IRQ mode, the scanline hook is removed while in CPU cycle mode
+const nes_mapper Mapper64_Rambo1 = {
+	"RAMBO-1", 64, -1,
+	&nes_cart::setupMapper64_Rambo1,
+	Mapper64_writeSpecial, nes_cart::Mapper64_ScanlineClock, nullptr,
+	&nes_cart::Mapper64_IRQReached, &nes_cart::Mapper64_RollbackClocks, &nes_cart::Mapper64_StateLoaded
+};
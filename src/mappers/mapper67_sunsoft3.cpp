@@ -106,8 +106,6 @@ void Mapper67_writeSpecial(unsigned int address, unsigned char value) {
 }
 
 void nes_cart::setupMapper67_Sunsoft3() {
-	writeSpecial = Mapper67_writeSpecial;
-
 	cachedBankCount = availableROMBanks;
 
 	DebugAssert(numCHRBanks > 0);
@@ -125,3 +123,20 @@ void nes_cart::setupMapper67_Sunsoft3() {
 		mainCPU.setMapKB(0x60, 8, cache[availableROMBanks].ptr);
 	}
 }
+
+bool nes_cart::Mapper67_IRQReached() {
+	Mapper67_IRQ_Counter = 0xFFFF;
+	Mapper67_IRQ_Enable = 0;
+	return true;
+}
+
+void nes_cart::Mapper67_RollbackClocks(unsigned int clockCount) {
+	Mapper67_IRQ_LastSet -= clockCount;
+}
+
+const nes_mapper Mapper67_Sunsoft3 = {
+	"Sunsoft-3", 67, -1,
+	&nes_cart::setupMapper67_Sunsoft3,
+	Mapper67_writeSpecial, nullptr, nullptr,
+	&nes_cart::Mapper67_IRQReached, &nes_cart::Mapper67_RollbackClocks, &nes_cart::Mapper67_StateLoaded
+};
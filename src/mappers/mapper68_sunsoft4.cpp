@@ -17,8 +17,8 @@ void nes_cart::Mapper68_Update(bool bMapNametables) {
 
 	if (bMapNametables && (Mapper68_NTM & 0x10)) {
 		// map a cached bank for nametable ROM into nametable memory
-		unsigned char* table0 = cacheSingleCHRBank(Mapper68_NT0 / 8) + 1024 * (Mapper68_NT0 & 7);
-		unsigned char* table1 = cacheSingleCHRBank(Mapper68_NT1 / 8) + 1024 * (Mapper68_NT1 & 7);
+		unsigned char* table0 = chrCachePages[cacheCHRPage(Mapper68_NT0)].ptr;
+		unsigned char* table1 = chrCachePages[cacheCHRPage(Mapper68_NT1)].ptr;
 		memcpy_fast32(nesPPU.nameTables, table0, 1024);
 		memcpy_fast32(nesPPU.nameTables+1, table1, 1024);
 	}
@@ -102,8 +102,6 @@ void Mapper68_writeSpecial(unsigned int address, unsigned char value) {
 }
 
 void nes_cart::setupMapper68_Sunsoft4() {
-	writeSpecial = Mapper68_writeSpecial;
-
 	// will use cache[cachedBankCount] as nametable RAM swap
 	cachedBankCount = availableROMBanks - 1;
 
@@ -122,3 +120,10 @@ void nes_cart::setupMapper68_Sunsoft4() {
 		mainCPU.setMapKB(0x60, 8, cache[availableROMBanks].ptr);
 	}
 }
+
+const nes_mapper Mapper68_Sunsoft4 = {
+	"Sunsoft-4", 68, -1,
+	&nes_cart::setupMapper68_Sunsoft4,
+	Mapper68_writeSpecial, nullptr, nullptr,
+	nullptr, nullptr, &nes_cart::Mapper68_StateLoaded
+};
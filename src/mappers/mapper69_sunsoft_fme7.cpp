@@ -6,7 +6,7 @@
 
 void nes_cart::Mapper69_RunCommand(bool bIsForceUpdate) {
 	if (!bIsForceUpdate) {
-		nesCart.registers[Mapper69_COMMAND] = Mapper69_PARAM;
+		Mapper69_STATE.commandRegs[Mapper69_COMMAND] = Mapper69_PARAM;
 	}
 
 	if (Mapper69_COMMAND < 8 || bIsForceUpdate) {
@@ -130,13 +130,17 @@ void Mapper69_writeSpecial(unsigned int address, unsigned char value) {
 		} else if (address < 0xC000) {
 			Mapper69_PARAM = value;
 			nesCart.Mapper69_RunCommand(false);
-		} 
+		} else if (address < 0xE000) {
+			// 5B audio register select
+			nesAPU.writeExpansion(0, value);
+		} else {
+			// 5B audio register data
+			nesAPU.writeExpansion(1, value);
+		}
 	}
 }
 
 void nes_cart::setupMapper69_Sunsoft() {
-	writeSpecial = Mapper69_writeSpecial;
-
 	cachedBankCount = availableROMBanks;
 
 	DebugAssert(numCHRBanks > 0);
@@ -160,4 +164,33 @@ void nes_cart::setupMapper69_Sunsoft() {
 	Mapper69_PRG3 = 2;
 
 	Mapper69_RunCommand(true);
+
+	nesAPU.setupExpansion(APU_EXP_SUNSOFT5B);
+}
+
+void nes_cart::Mapper69_StateLoaded() {
+	Mapper69_RunCommand(true);
 }
+
+bool nes_cart::Mapper69_IRQReached() {
+	if ((Mapper69_IRQCONTROL & 0x1) == 0) {
+		mainCPU.ackIRQ(0);
+		return false;
+	}
+
+	mainCPU.ackIRQ(0);
+	return true;
+}
+
+void nes_cart::Mapper69_RollbackClocks(unsigned int clockCount) {
+	if (Mapper69_LASTCOUNTERCLK) {
+		Mapper69_LASTCOUNTERCLK -= clockCount;
+	}
+}
+
+const nes_mapper Mapper69_Sunsoft = {
+	"Sunsoft FME-7", 69, -1,
+	&nes_cart::setupMapper69_Sunsoft,
+	Mapper69_writeSpecial, nullptr, nullptr,
+	&nes_cart::Mapper69_IRQReached, &nes_cart::Mapper69_RollbackClocks, &nes_cart::Mapper69_StateLoaded
+};
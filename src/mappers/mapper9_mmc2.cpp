@@ -123,9 +123,6 @@ void MMC2_writeSpecial(unsigned int address, unsigned char value) {
 }
 
 void nes_cart::setupMapper9_MMC2() {
-	writeSpecial = MMC2_writeSpecial;
-	renderLatch = MMC2_renderLatch;
-
 	cachedBankCount = availableROMBanks;
 
 	MMC2_LOLATCH = 0;
@@ -152,3 +149,10 @@ void nes_cart::setupMapper9_MMC2() {
 		mainCPU.setMapKB(0x60, 8, cache[availableROMBanks].ptr);
 	}
 }
+
+const nes_mapper Mapper9_MMC2 = {
+	"MMC2/MMC4", 9, 10,
+	&nes_cart::setupMapper9_MMC2,
+	MMC2_writeSpecial, nullptr, MMC2_renderLatch,
+	nullptr, nullptr, &nes_cart::MMC2_StateLoaded
+};
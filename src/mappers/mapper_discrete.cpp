@@ -0,0 +1,292 @@
+#include "mappers.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Discrete logic boards
+//
+// Boards built from a latch (and maybe a decoder) where a write just splits the value into bank selects. Each board
+// is a descriptor of compile time constants, the write handler and setup are instantiated per board so unused fields
+// compile away and nothing is decoded at runtime.
+
+// no board selects anything by default
+struct nes_discrete_board {
+	enum {
+		// bank latch decode : (address & RegMask) == RegMatch
+		RegMask = 0x8000,
+		RegMatch = 0x8000,
+
+		// written value is ANDed with the ROM byte at the address (latch in ROM space only)
+		BusConflict = 0,
+
+		// 16 KB PRG select at 80-BF with the last bank fixed at C0-FF (or at C0-FF with the first fixed at 80-BF)
+		PRG16Mask = 0,
+		PRG16Upper = 0,
+
+		// 32 KB PRG select
+		PRG32Mask = 0,
+
+		// 8 KB CHR ROM select
+		CHR8Mask = 0,
+
+		// one screen mirroring select, from the bank latch or a separate register when MirrorRegMask is set
+		MirrorMask = 0,
+		MirrorRegMask = 0,
+		MirrorRegMatch = 0,
+	};
+};
+
+// shift of the lowest set bit of a field mask
+template<unsigned int Mask>
+struct FieldShift {
+	enum { value = (Mask & 1) ? 0 : 1 + FieldShift<(Mask >> 1)>::value };
+};
+
+template<>
+struct FieldShift<0> {
+	enum { value = 0 };
+};
+
+#define DISCRETE_FIELD(Value, Mask) (((Value) & (Mask)) >> FieldShift<(Mask)>::value)
+
+template<class Board>
+FORCE_INLINE void Discrete_MapMirror(unsigned int value) {
+	nesPPU.setMirrorType((value & Board::MirrorMask) ? nes_mirror_type::MT_SINGLE_UPPER : nes_mirror_type::MT_SINGLE);
+}
+
+template<class Board>
+FORCE_INLINE void Discrete_MapLatch(unsigned int value) {
+	if (Board::PRG16Mask != 0) {
+		const unsigned int bank = DISCRETE_FIELD(value, Board::PRG16Mask) & (nesCart.numPRGBanks - 1);
+		nesCart.MapProgramBanks(Board::PRG16Upper != 0 ? 2 : 0, bank * 2, 2);
+	}
+
+	if (Board::PRG32Mask != 0) {
+		const unsigned int bank = (DISCRETE_FIELD(value, Board::PRG32Mask) * 4) & (nesCart.numPRGBanks * 2 - 1);
+		nesCart.MapProgramBanks(0, bank, 4);
+	}
+
+	if (Board::CHR8Mask != 0 && nesCart.numCHRBanks) {
+		const unsigned int bank = DISCRETE_FIELD(value, Board::CHR8Mask) & (nesCart.numCHRBanks - 1);
+		nesCart.MapCharacterBanks(0, bank * 8, 8);
+	}
+
+	if (Board::MirrorMask != 0 && Board::MirrorRegMask == 0) {
+		Discrete_MapMirror<Board>(value);
+	}
+}
+
+template<class Board>
+void Discrete_writeSpecial(unsigned int address, unsigned char value) {
+	// bus conflicts are only emulated against ROM
+	CT_ASSERT(Board::BusConflict == 0 || (Board::RegMatch & 0x8000) != 0);
+
+	if ((address & Board::RegMask) == Board::RegMatch) {
+		if (Board::BusConflict != 0) {
+			value &= mainCPU.readNonIO(address);
+		}
+
+		DISCRETE_LATCH = value;
+		Discrete_MapLatch<Board>(value);
+	} else if (Board::MirrorRegMask != 0 && (address & Board::MirrorRegMask) == Board::MirrorRegMatch) {
+		// marked as written, the header mirroring stands until then
+		DISCRETE_MIRROR_LATCH = value | 0x100;
+		Discrete_MapMirror<Board>(value);
+	} else if (address >= 0x6000 && address < 0x8000 && nesCart.numRAMBanks) {
+		// RAM
+		mainCPU.writeDirect(address, value);
+	}
+}
+
+template<class Board>
+void nes_cart::Discrete_StateLoaded() {
+	Discrete_MapLatch<Board>(DISCRETE_LATCH);
+
+	if (Board::MirrorRegMask != 0 && DISCRETE_MIRROR_LATCH) {
+		Discrete_MapMirror<Board>(DISCRETE_MIRROR_LATCH);
+	}
+}
+
+template<class Board>
+void nes_cart::setupDiscrete() {
+	cachedBankCount = availableROMBanks;
+
+	// CHR ROM starts at the first bank, otherwise a cache bank is used as CHR RAM
+	if (numCHRBanks) {
+		MapCharacterBanks(0, 0, 8);
+	} else {
+		cachedBankCount--;
+		nesPPU.mapChrPages(0, cache[cachedBankCount].ptr, 8);
+	}
+
+	if (Board::PRG16Mask != 0) {
+		// first 16 KB to 80-BF and last 16 KB to C0-FF, one of them switchable
+		MapProgramBanks(0, 0, 2);
+		MapProgramBanks(2, Board::PRG16Upper != 0 ? 0 : numPRGBanks * 2 - 2, 2);
+	} else if (numPRGBanks == 1) {
+		// 16 KB mirrored
+		MapProgramBanks(0, 0, 2);
+		MapProgramBanks(2, 0, 2);
+	} else {
+		// first 32 KB of PRG memory to 80-FF
+		MapProgramBanks(0, 0, 4);
+	}
+
+	if (Board::MirrorMask != 0 && Board::MirrorRegMask == 0) {
+		nesPPU.setMirrorType(nes_mirror_type::MT_SINGLE);
+	}
+
+	// RAM bank if one is set up
+	if (numRAMBanks == 1) {
+		mainCPU.setMapKB(0x60, 8, cache[availableROMBanks].ptr);
+	}
+}
+
+#define DISCRETE_MAPPER(Interface, Name, Number, Board)		\
+	const nes_mapper Interface = {							\
+		Name, Number, -1,									\
+		&nes_cart::setupDiscrete<Board>,					\
+		Discrete_writeSpecial<Board>, nullptr, nullptr,		\
+		nullptr, nullptr, &nes_cart::Discrete_StateLoaded<Board>,	\
+		true												\
+	}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Boards
+
+// Mapper 0 : no registers at all
+struct NROM_Board : nes_discrete_board {
+	enum { RegMask = 0, RegMatch = 1 };
+};
+
+// Mapper 2 : the AND of a bus conflict is left out since UNROM 512 boards share the number
+struct UNROM_Board : nes_discrete_board {
+	enum { PRG16Mask = 0xFF };
+};
+
+// Mapper 3 : bus conflicts are needed for Cybernoid
+struct CNROM_Board : nes_discrete_board {
+	enum { BusConflict = 1, CHR8Mask = 0xFF };
+};
+
+// Mapper 7 : AMROM/ANROM have bus conflicts but AOROM does not
+struct AOROM_Board : nes_discrete_board {
+	enum { PRG32Mask = 0x0F, MirrorMask = 0x10 };
+};
+
+// Mapper 11
+struct ColorDreams_Board : nes_discrete_board {
+	enum { PRG32Mask = 0x03, CHR8Mask = 0xF0 };
+};
+
+// Mapper 38 : Bit Corp UNL-PCI556
+struct BitCorp_Board : nes_discrete_board {
+	enum { RegMask = 0xF000, RegMatch = 0x7000, PRG32Mask = 0x03, CHR8Mask = 0x0C };
+};
+
+// Mapper 66
+struct GXROM_Board : nes_discrete_board {
+	enum { BusConflict = 1, PRG32Mask = 0x30, CHR8Mask = 0x03 };
+};
+
+// Mapper 70 : Bandai 74161/32
+struct Bandai74161_Board : nes_discrete_board {
+	enum { BusConflict = 1, PRG16Mask = 0xF0, CHR8Mask = 0x0F };
+};
+
+// Mapper 71 : bank select at C000-FFFF, Firehawk selects its screen at 9000
+struct Camerica_Board : nes_discrete_board {
+	enum { RegMask = 0xC000, RegMatch = 0xC000, PRG16Mask = 0x0F, MirrorMask = 0x10, MirrorRegMask = 0xF000, MirrorRegMatch = 0x9000 };
+};
+
+// Mapper 79 : AVE NINA-03/06, register at 4100-5FFF where A8 is set
+struct AVE_Board : nes_discrete_board {
+	enum { RegMask = 0xE100, RegMatch = 0x4100, PRG32Mask = 0x08, CHR8Mask = 0x07 };
+};
+
+// Mapper 93 : Sunsoft-2 on the Sunsoft-3R board, CHR RAM (the enable bit is ignored)
+struct Sunsoft2_Board : nes_discrete_board {
+	enum { BusConflict = 1, PRG16Mask = 0x70 };
+};
+
+// Mapper 94 : UN1ROM (Senjou no Ookami)
+struct UN1ROM_Board : nes_discrete_board {
+	enum { BusConflict = 1, PRG16Mask = 0x1C };
+};
+
+// Mapper 101 : JF-10 (Urusei Yatsura) as commonly dumped
+struct JF10_Board : nes_discrete_board {
+	enum { RegMask = 0xE000, RegMatch = 0x6000, CHR8Mask = 0xFF };
+};
+
+// Mapper 107 : Magic Dragon, the fields overlap
+struct MagicDragon_Board : nes_discrete_board {
+	enum { PRG32Mask = 0xFE, CHR8Mask = 0xFF };
+};
+
+// Mapper 133 : Sachen 3009 / SA72008
+struct Sachen3009_Board : nes_discrete_board {
+	enum { RegMask = 0xE100, RegMatch = 0x4100, PRG32Mask = 0x04, CHR8Mask = 0x03 };
+};
+
+// Mapper 140 : Jaleco JF-11/14, GXROM fields at 6000-7FFF
+struct JF11_Board : nes_discrete_board {
+	enum { RegMask = 0xE000, RegMatch = 0x6000, PRG32Mask = 0x30, CHR8Mask = 0x0F };
+};
+
+// Mapper 145 : Sachen SA-72007
+struct SA72007_Board : nes_discrete_board {
+	enum { RegMask = 0xE100, RegMatch = 0x4100, CHR8Mask = 0x80 };
+};
+
+// Mapper 148 : Sachen SA-0037 / Tengen 800008
+struct SA0037_Board : nes_discrete_board {
+	enum { BusConflict = 1, PRG32Mask = 0x08, CHR8Mask = 0x07 };
+};
+
+// Mapper 149 : Sachen SA-0036
+struct SA0036_Board : nes_discrete_board {
+	enum { BusConflict = 1, CHR8Mask = 0x80 };
+};
+
+// Mapper 152 : Bandai 74161/32 with one screen mirroring
+struct Bandai74161Mirror_Board : nes_discrete_board {
+	enum { BusConflict = 1, PRG16Mask = 0x70, CHR8Mask = 0x0F, MirrorMask = 0x80 };
+};
+
+// Mapper 180 : UNROM with the switchable bank at C000 (Crazy Climber)
+struct UNROMUpper_Board : nes_discrete_board {
+	enum { PRG16Mask = 0x07, PRG16Upper = 1 };
+};
+
+// Mapper 240 : register at 4020-5FFF
+struct Mapper240_Board : nes_discrete_board {
+	enum { RegMask = 0xE000, RegMatch = 0x4000, PRG32Mask = 0xF0, CHR8Mask = 0x0F };
+};
+
+// Mapper 241 : BxROM like with CHR RAM
+struct Mapper241_Board : nes_discrete_board {
+	enum { PRG32Mask = 0xFF };
+};
+
+DISCRETE_MAPPER(Mapper0_NROM, "NROM", 0, NROM_Board);
+DISCRETE_MAPPER(Mapper2_UNROM, "UNROM", 2, UNROM_Board);
+DISCRETE_MAPPER(Mapper3_CNROM, "CNROM", 3, CNROM_Board);
+DISCRETE_MAPPER(Mapper7_AOROM, "AOROM", 7, AOROM_Board);
+DISCRETE_MAPPER(Mapper11_ColorDreams, "Color Dreams", 11, ColorDreams_Board);
+DISCRETE_MAPPER(Mapper38_BitCorp, "Bit Corp", 38, BitCorp_Board);
+DISCRETE_MAPPER(Mapper66_GXROM, "GXROM", 66, GXROM_Board);
+DISCRETE_MAPPER(Mapper70_Bandai, "Bandai 74161", 70, Bandai74161_Board);
+DISCRETE_MAPPER(Mapper71_Camerica, "Camerica", 71, Camerica_Board);
+DISCRETE_MAPPER(Mapper79_AVE, "AVE", 79, AVE_Board);
+DISCRETE_MAPPER(Mapper93_Sunsoft2, "Sunsoft-2", 93, Sunsoft2_Board);
+DISCRETE_MAPPER(Mapper94_UN1ROM, "UN1ROM", 94, UN1ROM_Board);
+DISCRETE_MAPPER(Mapper101_JF10, "JF-10", 101, JF10_Board);
+DISCRETE_MAPPER(Mapper107_MagicDragon, "Magic Dragon", 107, MagicDragon_Board);
+DISCRETE_MAPPER(Mapper133_Sachen3009, "Sachen 3009", 133, Sachen3009_Board);
+DISCRETE_MAPPER(Mapper140_JF11, "JF-11/14", 140, JF11_Board);
+DISCRETE_MAPPER(Mapper145_SA72007, "SA-72007", 145, SA72007_Board);
+DISCRETE_MAPPER(Mapper148_SA0037, "SA-0037", 148, SA0037_Board);
+DISCRETE_MAPPER(Mapper149_SA0036, "SA-0036", 149, SA0036_Board);
+DISCRETE_MAPPER(Mapper152_Bandai, "Bandai 74161 1-screen", 152, Bandai74161Mirror_Board);
+DISCRETE_MAPPER(Mapper180_UNROM, "UNROM (C000)", 180, UNROMUpper_Board);
+DISCRETE_MAPPER(Mapper240, "Mapper 240", 240, Mapper240_Board);
+DISCRETE_MAPPER(Mapper241, "Mapper 241", 241, Mapper241_Board);
@@ -33,6 +33,7 @@ enum NesKeys {
 	NES_P2_DOWN,
 	NES_P2_LEFT,
 	NES_P2_RIGHT,
+	NES_REWIND,
 	NES_MAX_KEYS
 };
 
@@ -44,19 +45,309 @@ bool keyDown_fast(unsigned char keyCode);
 #define MAX_CACHED_ROM_BANKS 32
 #define STATIC_CACHED_ROM_BANKS 24
 
+// 8 KB cached banks given over to 1 KB CHR ROM pages (fewer if the whole CHR ROM is smaller)
+#define CHR_CACHE_BANKS 6
+#define MAX_CHR_CACHE_PAGES (CHR_CACHE_BANKS * 8)
+
+#define BANK_CACHE_HASH_SIZE 64		// power of 2
+
 struct nes_cached_bank {
 	unsigned char* ptr;
-	int32 request;
+	int32 key;				// cart bank held (8 KB PRG or 1 KB CHR index), -1 if empty
+
+	// links are entry indices, -1 terminates
+	int16 prev;				// LRU list towards most recently used
+	int16 next;				// LRU list towards least recently used
+	int16 hashNext;			// hash chain
+
+	// number of current mappings using this entry, pinned entries are kept out of the LRU list
+	uint16 pinCount;
+
+	// filled speculatively and not requested since
+	bool bPrefetched;
+
+	// frame of the last request
+	uint32 useFrame;
+};
+
+// LRU over an array of cached banks with a hash index on the bank key, so lookup, touch and eviction are all O(1)
+struct nes_bank_cache {
+	nes_cached_bank* entries;
+	int count;
+	int16 mru;
+	int16 lru;
+	int16 hash[BANK_CACHE_HASH_SIZE];
+
+	// requests served from the cache and ones that had to be read, since the machine was made
+	uint32 hits;
+	uint32 misses;
+
+	// takes over the given entries (with ptr already set) as empty and unpinned
+	void reset(nes_cached_bank* withEntries, int withCount);
+
+	// returns the entry holding key and marks it most recently used, or -1 if not cached
+	int find(int32 key);
+
+	// same as find without touching the LRU
+	int peek(int32 key) const;
+
+	// re-keys the least recently used unpinned entry to key (caller reads the data), evictedKey is the key it held
+	int evict(int32 key, int32& evictedKey);
+
+	// least recently used unpinned entry (-1 if everything is pinned)
+	int oldest() const {
+		return lru;
+	}
+
+	// pinned entries are mapped somewhere and can't be evicted
+	void pin(int index);
+	void unpin(int index);
+
+	// changes the key an entry is found under (-1 to hold nothing)
+	void rekey(int index, int32 key);
+
+private:
+	void unlink(int index);
+	void linkFront(int index);
+	void hashRemove(int index);
+};
+
+#define PREFETCH_PRG_BANKS 256			// 8 KB PRG banks with learned transitions (2 MB)
+#define PREFETCH_CHR_PAGES 1024			// 1 KB CHR pages with learned transitions (1 MB)
+#define PREFETCH_COLD_FRAMES 30			// cached banks untouched this long may be replaced by a prefetch
+#define PREFETCH_CONFIDENCE 2			// transitions are prefetched from this confidence up
+
+// which bank tends to be requested after another one
+struct nes_bank_transition {
+	int16 next;					// -1 if nothing learned yet
+	uint8 confidence;			// saturating 0-3, prefetched from PREFETCH_CONFIDENCE up
+	uint8 phase;				// scanline / 8 the transition was last seen at (soonest needed are prefetched first)
+};
+
+// learns per game bank transitions from cache requests and fills cold cache slots with the likely next banks during idle time
+struct nes_bank_prefetcher {
+	nes_bank_transition prg[PREFETCH_PRG_BANKS];
+	nes_bank_transition chr[PREFETCH_CHR_PAGES];
+	int32 lastPRG;
+	int32 lastCHR;
+	bool bDirty;				// predictions changed since loaded or saved (a new successor, or one crossing PREFETCH_CONFIDENCE)
+
+	// accuracy
+	uint32 issued;
+	uint32 used;
+	uint32 wasted;
+
+	// average cycles a cache miss stalls for, and the total avoided by used prefetches
+	uint32 prgMissCycles;
+	uint32 chrMissCycles;
+	uint32 stallCyclesSaved;
+
+	// PRG bank being read in a piece at a time, into a pinned entry that holds no key until it is complete
+	int16 fillEntry;			// prgCache entry, -1 if none
+	int32 fillKey;
+	int32 fillOffset;
+
+	void reset();
+	void train(bool bCHR, int32 key);
+
+	// prefetched entry was requested (or evicted unused)
+	void onRequested(nes_cached_bank& entry, bool bCHR);
+	void onEvicted(const nes_cached_bank& entry);
+
+	// folds a measured miss into the average miss cost
+	void onMiss(bool bCHR, uint32 cycles);
+
+	// shows miss cost and accuracy on the last row of the debug timings screen (F2), and in the log
+	void report();
+};
 
-	int32 prgIndex;
-	int16 chrIndex[8];
+// a Game Genie code (6 or 8 letters) or a raw AAAA:VV / AAAA?CC:VV code, raw codes below 8000 freeze RAM
+struct nes_cheat {
+	uint16 address;
+	uint8 value;
+	uint8 compare;
+	bool bCompare;				// only patch where the ROM holds the compare value
+	bool bRAM;					// written every frame instead of patching ROM
+	char text[12];				// as given, for display
+};
+
+// ROM patch within one 8 KB PRG bank
+struct nes_bank_patch {
+	uint16 offset;				// CPU window (bits 13-14) and offset in the bank, sorted on this
+	uint8 compare;
+	uint8 value;
+	bool bCompare;
+};
+
+struct nes_cart;
+
+// Cheat codes for the loaded cart. ROM codes become per PRG bank patch lists that are applied to a private copy of
+// a bank when it is mapped at a patched window (the cached or resident bank itself is never touched)
+struct nes_cheats {
+	nes_cheat* codes;
+	int32 numCodes;
+	int32 maxCodes;
+
+	// patches for 8 KB PRG bank b are patches[patchStart[b], patchStart[b + 1])
+	nes_bank_patch* patches;
+	int32* patchStart;
+	uint8* patchWindows;		// per bank, bit mask of the CPU windows it has patches for
+	int32 numPatchBanks;
+
+	// frozen RAM as (address << 8) | value, written once per frame
+	uint32* ramFreezes;
+	int32 numRAMFreezes;
+
+	// drops all codes and patch tables
+	void clear();
+
+	// parses one code, returns false if it isn't one
+	static bool parse(const char* text, nes_cheat& into);
+
+	// adds every code in a .gg style text (one code per line, anything after it is a comment), returns the number added
+	int32 parseText(const char* text, int32 length);
+
+	// loads the optional .gg file next to the ROM
+	void load(const char* romFile);
+
+	// builds the per bank patch lists for the cart's PRG ROM, dropping compare codes that can't match where the ROM
+	// is readable in place
+	void buildPatches(const nes_cart& cart);
 
-	void clear() {
-		request = -1;
-		prgIndex = -2;
+	FORCE_INLINE bool hasPatches(int32 bank, int32 window) const {
+		return bank < numPatchBanks && (patchWindows[bank] & (1 << window));
 	}
+
+	// applies the patches of a bank mapped at the given window to a copy of it
+	void patchBank(int32 bank, int32 window, uint8* data) const;
+
+	// writes the frozen RAM values
+	void applyRAM() const;
+};
+
+// span of one packed delta in the rewind history
+struct nes_rewind_entry {
+	int32 offset;
+	int32 size;
+};
+
+// rewind history. A snapshot is taken every few frames and kept as an XOR delta against the one before it with the
+// unchanged runs packed out, so older states are rebuilt by applying deltas to the newest snapshot
+struct nes_rewind {
+	uint8* memory;					// one allocation for everything below, sized from the rewind setting
+	int32 budgetSetting;			// setting the memory was sized for
+	bool bUnavailable;				// the setting is on but no budget held this cart's states
+
+	uint8* current;					// newest snapshot
+	uint8* next;
+	int32 stateSize;
+	bool bHasCurrent;
+
+	// packed deltas as whole entries in a byte ring, entries[] is a ring of their spans oldest first
+	uint8* history;
+	int32 historySize;
+	int32 head;						// end of the newest entry
+	nes_rewind_entry* entries;
+	int32 maxEntries;
+	int32 oldestEntry;
+	int32 numEntries;
+
+	int32 framesToCapture;
+
+	// drops the history and frees the memory (a new cart has a different state layout)
+	void clear();
+
+	// once per frame after keys are cached, steps back while the rewind key is held and captures otherwise
+	void frame();
+
+	// sizes the buffers for the given setting (or the next size up when the state is too large for it), false if
+	// rewind is off or doesn't fit
+	bool allocate(int32 setting);
+
+	void capture();
+	bool stepBack();
+
+	// returns the offset of room for an entry of up to the given size, dropping the oldest entries as needed
+	int32 reserve(int32 size);
+	void evictOldest();
 };
 
+extern nes_rewind nesRewind;
+
+#if TARGET_WINSIM
+// run ahead (host only) hides the frames of input lag games add themselves. After the keys are read the machine is
+// snapshotted, the next frames are emulated with only the last one presented, then the snapshot is restored
+struct nes_run_ahead {
+	uint8* state;
+	int32 stateSize;
+	int32 gameFrames;			// override from the ROM's .cfg file, -1 to use the setting
+
+	void clear();
+
+	// reads the optional per game override next to the ROM
+	void load(const char* romFile);
+
+	int32 getFrames() const;
+
+	// called by the game loop each time a real frame has ended
+	void frameEnded();
+};
+
+extern nes_run_ahead nesRunAhead;
+
+struct nes_ppu;
+
+// headless mode (host only) runs the machine as fast as it goes for bots and batch tests. Frames are skipped with only
+// what the CPU can observe of them rendered (sprite 0 hits, MMC2/4 latches), nothing is mixed and nothing is presented
+// or paced, except for the frames asked for with requestFrame()
+struct nes_headless {
+	bool bActive;
+	bool bFrameRequested;
+
+	// frame hash, over the NES colors of the displayed scanlines (so it doesn't depend on the LCD palette or output scaling)
+	bool bHashRequested;
+	bool bHashing;
+	uint32 frameHash;
+
+	void start();
+	void stop();
+
+	// the next frame to begin is rendered and presented (or captured) as usual
+	void requestFrame();
+
+	// the next frame to begin is hashed into frameHash, which is complete once that frame has ended
+	void requestFrameHash();
+
+	// called by the PPU as a frame begins, and with each rendered scanline of a hashed frame
+	void beginFrame();
+	void hashScanline(const nes_ppu& ppu);
+
+	// runs the loaded game headless for the given number of frames, logs and returns the emulated frame rate
+	int32 benchmark(int32 numFrames);
+};
+#endif
+
+// .nesz packed ROM container: "NESZ", version byte, 3 pad bytes, the original 16 byte iNES header, the original file size,
+// then a 6 byte (offset, size) entry per unit, all big endian. PRG is split into 4 KB units and CHR into 1 KB pages, each
+// zx7 compressed on its own (stored raw if that doesn't help) and never crossing a 4 KB file block, so a cache miss
+// unpacks straight from the mapped file blocks
+#define PACKED_ROM_VERSION 1
+#define PACKED_ROM_INDEX 28
+#define PACKED_ROM_ENTRY 6
+#define PACKED_PRG_UNIT 4096
+#define PACKED_CHR_UNIT 1024
+
+#if TARGET_WINSIM
+// host side packing tool, writes the .nesz for the given .nes file
+bool PackROM(const char* romFile, const char* packedFile);
+
+// host side batch runner, runs each task of the manifest on a machine of its own across all cores and writes the results
+// as JSON (to resultsFile, or the manifest name with .json added). Returns true if every task passed
+bool RunBatch(const char* manifestFile, const char* resultsFile);
+#endif
+
+struct nes_mapper;
+
 // specifications about the cart, rom file, mapper, etc
 struct nes_cart {
 	nes_cart();
@@ -67,8 +358,12 @@ struct nes_cart {
 	char romFile[128];				// file name, if this is set, then the cart is setup to run 
 	char savFile[128];				// cached .sav file name for writing to .SAV on exit
 
+	// name of the cart's save file with the given extension (".sav", ".fcs", ".bpf"), all are kept next to the ROM
+	static void GetSaveFileName(const char* withFile, const char* extension, char* intoFile);
+
 	int mapper;						// mapper ID used with ROM
 	int subMapper;					// subMapper (iNES 2.0 only, -1 if unused)
+	const nes_mapper* mapperInterface;	// hooks for the mapper in use (null if unsupported)
 	int numPRGBanks;				// num 16 kb Program ROM banks
 	int numCHRBanks;				// num 8 kb CHR ROM banks (0 means CHR RAM)
 	int numRAMBanks;				// num 8 kb RAM banks
@@ -76,6 +371,7 @@ struct nes_cart {
 	int isBatteryBacked;			// 0 if no battery backup
 	int isPAL;						// 1 if PAL, 0 if NTSC
 	int isLowPRGROM;				// 1 if low prg rom at 0x6000 is available
+	int isCompressed;				// 1 if loaded from a .nesz container
 
 	// up to 32 internal registers
 	unsigned int registers[32];
@@ -83,12 +379,18 @@ struct nes_cart {
 	// bank index storage for program memory (which 8 KB from cart at 0x8000, 0xA000, 0xC000, amd 0xE000). Index 5 is for mappers that map to 0x6000 (only used if isLowPRGROM is true)
 	int32 programBanks[5];
 
+	// prg cache entry pinned by each program bank (-1 if none)
+	int16 programBankEntries[5];
+
 	// chr rom index map (which 1 KB from cart at 0x0000 - 0x1FFF in ppu memory)
 	int16 chrBanks[8];
 
 	// when chrBanks is dirty, actual bank data is set to the chrPages at the start of the rendered scanline
 	bool bDirtyChrBanks;
 
+	// chr cache entry pinned by each PPU chr page as of the last commit (-1 if it must be looked up again)
+	int16 chrPageEntries[8];
+
 	// whether chr bank pages should be swapped (for MMC2/3 support)
 	bool bSwapChrPages;
 
@@ -107,10 +409,14 @@ struct nes_cart {
 	nes_cached_bank cache[MAX_CACHED_ROM_BANKS];
 
 	// common bank caching set up. Caching is used for PRG and CHR. RAM is stored permanently in memory
-	int requestIndex;
-
-	// number of 8 KB banks to use for PRG & CHR (some cached banks are used for permanently mapped RAM, etc)
+	// cached banks [chrCacheBanks, cachedBankCount) are used for PRG (some cached banks are used for permanently mapped RAM, etc)
 	int cachedBankCount;
+	nes_bank_cache prgCache;
+
+	// the first cached banks hold CHR ROM in 1 KB pages with their own LRU
+	int chrCacheBanks;
+	nes_cached_bank chrCachePages[MAX_CHR_CACHE_PAGES];
+	nes_bank_cache chrCache;
 
 	// returns hash of RAM contents
 	uint32 GetRAMHash();
@@ -127,14 +433,36 @@ struct nes_cart {
 	// writes the save state for this cart. Requires block addresses to be reset
 	bool SaveState();
 
+	// size of the state image SaveToMemory writes for this cart
+	int32 GetStateSize();
+
+	// serializes the whole machine state into buffer in a single pass, returns the size written or 0 if it doesn't fit
+	int32 SaveToMemory(uint8* buffer, int32 capacity);
+
+	// restores a state image from SaveToMemory (or an uncompressed FCEUX state), returns false on bad data. The bank
+	// caches are only flushed when the restored bank mapping differs from the current one
+	bool LoadFromMemory(const uint8* buffer, int32 size);
+
 	// uncaches all cached block data and resets program banks
 	void FlushCache();
 
 	// direct memory block support (direct memcpy from ROM, prevents OS call to read game data as needed)
 	unsigned char* blocks[1024];	
 	bool BuildFileBlocks();
+
+	// builds blocks again after the file system may have moved the file (save written, resumed from menu)
+	void RebuildFileBlocks();
+
+	// whole ROM file when it is resident in addressable memory, banks are then mapped in place rather than cached
+	const unsigned char* romImage;
+	unsigned char* romImageAlloc;			// host side copy backing romImage, if any
 	void BlockRead(unsigned char* intoMem, int size, int offset);
 
+	// reads whole PRG/CHR units at the given iNES file offset, unpacking them if the ROM is compressed
+	void ReadROM(unsigned char* intoMem, int size, int offset);
+	void UnpackUnit(unsigned char* intoMem, int unit, int unitSize);
+	bool ValidatePackedIndex(int fileSize);
+
 	// called on all writes over 0x4020
 	void(*writeSpecial)(unsigned int address, unsigned char value);
 
@@ -146,24 +474,37 @@ struct nes_cart {
 
 	void clearCacheData();
 
-	// returns whether the bank given is in use by the memory map
-	bool isBankUsed(int index);
+	// sets up the PRG cache over [chrCacheBanks, cachedBankCount) once the mapper has claimed its permanent banks
+	void resetPRGCache();
 
-	// finds least recently requested bank that is currently unused
+	// finds least recently requested bank (index into cache[]) that is currently unused
 	int findOldestUnusedBank();
 
-	// caches an 8 KB PRG bank (so index up to 2 * numPRGBanks), returns result bank memory pointer
-	unsigned char* cachePRGBank(int index);
+	// caches an 8 KB PRG bank (so index up to 2 * numPRGBanks), returns prgCache entry. With a patch window the entry
+	// is a separate copy with the cheat patches for that CPU window applied
+	int cachePRGBank(int index, int patchWindow = -1);
+
+	// caches a 1 KB CHR page (so index up to 8 * numCHRBanks), returns chrCache entry
+	int cacheCHRPage(int32 index);
 
-	// caches a 8 KB CHR bank based on the given 1 KB indices, returns result bank memory pointer
-	unsigned char* cacheCHRBank(int16* indices);
+	// bank prefetching (see nes_prefetch.cpp)
+	nes_bank_prefetcher prefetcher;
 
-	// caches a single 8 KB CHR bank based on the 8 KB index, returns result bank memory pointer
-	unsigned char* cacheSingleCHRBank(int16 index);
+	// reads a piece of a predicted bank into a cold cache slot (a whole CHR page, or PRG in units of a few KB so one call
+	// stays well under the frame wait it runs in), returns false if there was nothing to do
+	bool PrefetchIdle();
+	void ContinuePRGFill();
+
+	// learned transitions are kept with the cart's other save files (.bpf)
+	void LoadPrefetchStats(const char* withFile);
+	void SavePrefetchStats();
 
 	// sets up bank pointers with the given allocated data
 	void allocateBanks(unsigned char* staticAlloced);
 
+	// frees the heap banks allocateBanks added (the static ones stay with the caller)
+	void releaseBanks();
+
 	// Loads a ROM from the given file path
 	bool loadROM(const char* withFile);
 
@@ -180,55 +521,49 @@ struct nes_cart {
 	void rollbackClocks(unsigned int clockCount);
 
 	// various mapper setups and functions
-	void setupMapper0_NROM();
+	template<class Board> void setupDiscrete();
+	template<class Board> void Discrete_StateLoaded();
 
 	void setupMapper1_MMC1();
 	void MMC1_Write(unsigned int addr, int regValue);
 	void MMC1_SetRAMBank(int value);
 	void MMC1_StateLoaded();
 
-	void setupMapper2_UNROM();
-
-	void setupMapper3_CNROM();
-
 	void setupMapper4_MMC3();
 	void MMC3_UpdateMapping(int regNumber);
 	static void MMC3_ScanlineClock();
 	void MMC3_StateLoaded();
-
-	void setupMapper7_AOROM();
-	void AOROM_StateLoaded();
+	bool MMC3_IRQReached();
+	void MMC3_RollbackClocks(unsigned int clockCount);
 
 	void setupMapper9_MMC2();
 	void MMC2_StateLoaded();
 
-	void setupMapper11_ColorDreams();
-
 	void setupMapper34_BNROM();
 	void Mapper34_Sync();
 
-	void setupMapper71_Camerica();
-
 	void setupMapper64_Rambo1();
 	void Mapper64_Update();
 	static void Mapper64_ScanlineClock();
 	void Mapper64_StateLoaded();
+	bool Mapper64_IRQReached();
+	void Mapper64_RollbackClocks(unsigned int clockCount);
 
 	void setupMapper67_Sunsoft3();
 	void Mapper67_Update();
 	void Mapper67_StateLoaded();
+	bool Mapper67_IRQReached();
+	void Mapper67_RollbackClocks(unsigned int clockCount);
 
 	void setupMapper68_Sunsoft4();
 	void Mapper68_Update(bool bMapNametables);
 	void Mapper68_StateLoaded();
 
-	void setupMapper66_GXROM();
-
 	void setupMapper69_Sunsoft();
 	void Mapper69_RunCommand(bool bIsForceUpdate);
-
-	void setupMapper79_AVE();
-	void Mapper79_Update();
+	void Mapper69_StateLoaded();
+	bool Mapper69_IRQReached();
+	void Mapper69_RollbackClocks(unsigned int clockCount);
 
 	void setupMapper163_Nanjing();
 	void Mapper163_Update();
@@ -238,13 +573,39 @@ struct nes_cart {
 	uint8* GetWRAM();
 };
 
+// mapper interface, each mapper file defines one for the boards it handles (see nesMappers in nes_cart.cpp). Hooks a
+// mapper doesn't need are null
+struct nes_mapper {
+	const char* name;
+	int number;						// iNES mapper number
+	int aliasNumber;				// another number for the same board (-1 if none)
+
+	// sets up banks and memory mapping for the loaded ROM
+	void(nes_cart::*setup)();
+
+	// per access hooks, installed on the cart before setup (see writeSpecial, scanlineClock and renderLatch)
+	void(*write)(unsigned int address, unsigned char value);
+	void(*scanline)();
+	void(*chrLatch)(unsigned int ppuAddress);
+
+	// IRQ clocks reached, return false to not cancel the IRQ request (the IRQ is acked if null)
+	bool(nes_cart::*irqReached)();
+
+	// rollback clock based counters by the given amount
+	void(nes_cart::*rollbackClocks)(unsigned int clockCount);
+
+	// remaps banks from the mapper registers after a state load
+	void(nes_cart::*stateLoaded)();
+
+	// single latch discrete board, its state is DISCRETE_LATCH (see mapper_discrete.cpp)
+	bool bDiscrete;
+};
+
 struct nes_nametable {
 	unsigned char table[960];
 	unsigned char attr[64];
 };
 
-extern nes_cart nesCart;
-
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // PPU
 
@@ -285,6 +646,15 @@ namespace nes_mirror_type {
 	};
 }
 
+// defer visible scanline rendering until visible PPU state changes or vblank, rendering the backlog in one batch
+#define PPU_CATCHUP_RENDER 1
+
+// render visible scanlines on a separate thread from per scanline state snapshots (host only, see render_thread.h)
+#define PPU_RENDER_THREAD TARGET_WINSIM
+
+// stream rendered frames and mixed audio to files from a writer thread (host only, see capture_thread.h)
+#define CAPTURE_THREAD TARGET_WINSIM
+
 struct nes_ppu {
 	// registers (some of them map to $2000-$2007, but this is handled case by case)
 	unsigned char PPUCTRL;			// $2000
@@ -316,12 +686,47 @@ struct nes_ppu {
 	// up to four name tables potentially (most games use 2)
 	nes_nametable* nameTables;
 
-	// character memory split into 4 kb pages (0x0000 and 0x1000)
-	unsigned char* chrPages[2];
+	// character memory split into 1 kb pages (0x0000, 0x0400, ... 0x1C00)
+	unsigned char* chrPages[8];
+
+	// pattern data for a tile in the given 4 kb pattern table (0 or 1)
+	FORCE_INLINE unsigned char* chrTile(unsigned int table, unsigned int tile) const {
+		return chrPages[(table << 2) | (tile >> 6)] + ((tile & 0x3F) << 4);
+	}
+
+	// points numKB consecutive pages at contiguous memory (CHR RAM, etc)
+	FORCE_INLINE void mapChrPages(int page, unsigned char* ptr, int numKB) {
+		for (int i = 0; i < numKB; i++) {
+			chrPages[page + i] = ptr + 0x400 * i;
+		}
+	}
 
 	// current scanline (0 = prerender line, 1 = first real scanline)
 	unsigned int scanline;
 
+	// visible scanlines whose rendering has been deferred (see PPU_CATCHUP_RENDER)
+	unsigned int firstPendingScanline;
+	unsigned int numPendingScanlines;
+
+	// scanlines stepped ahead of the CPU in one batch while rendering is disabled, until batchEndScanline
+	unsigned int batchStartScanline;
+	unsigned int batchStartClock;
+	unsigned int batchEndScanline;
+	bool batchSkipFrame;
+	void batchScanlines(bool bSkippedFrame);
+	void splitScanlineBatch();
+
+	// renders any deferred scanlines, must be called before anything the renderer reads is modified
+	inline void catchUp() {
+		if (batchEndScanline) {
+			splitScanlineBatch();
+		}
+		if (numPendingScanlines) {
+			renderPendingScanlines();
+		}
+	}
+	void renderPendingScanlines();
+
 	// scanline offset (used for some backgrounds)
 	int scanlineOffset;
 
@@ -331,8 +736,13 @@ struct nes_ppu {
 	// pointer to buffer representing palette entries for current scanline
 	uint8* scanlineBuffer;
 
-	// pointer to function to render current scanline to scanline buffer (based on mirror mode)
-	void(*renderScanline)(nes_ppu& ppu);
+	// pointer to function to render current scanline to scanline buffer (based on mirror mode, latch, sprite size, and clipping)
+	typedef void(*scanlineRenderer)(nes_ppu& ppu);
+	scanlineRenderer renderScanline;
+	int renderScanlineKey;
+
+	// selects the specialized scanline renderer, call whenever one of its inputs may have changed
+	void updateRenderScanline();
 
 	// palette ram (first 16 bytes are BG, second are OBJ palettes)
 	unsigned char palette[0x20];
@@ -340,19 +750,71 @@ struct nes_ppu {
 	// oam data
 	unsigned char oam[0x100];
 	bool dirtyOAM;
+
+	// mask of which sprites to check per scanline (bit 0 = sprites 56-63, bit 1 = sprites 48-55, and so on)
+	uint8 fetchMask[272];
+
+	// sprite scanline buffer with padding to allow fast rendering with clipping, and its 8 pixel column mask
+	uint8 oamScanlineBuffer[256 + 8];
+	uint8 spriteMask[33];
+
+	// set when nametable, CHR RAM, palette or OAM contents are written (consumed by the render thread)
+	bool dirtyVideoMemory;
 	
-	// working palette (actual LCD colors of each palette entry from palette[], accounts for background color mirroring)
-	uint16 workingPalette[0x20];
+	// working palettes (actual LCD colors of each palette entry from palette[], accounts for background color mirroring),
+	// one per emphasis / grayscale combination so PPUMASK changes only need to select another bank
+	uint16 workingPaletteBank[16][0x20];
+	uint16* workingPalette;
 	bool dirtyPalette;
 
 	// current frame
 	unsigned int frameCounter;
 	unsigned int autoFrameSkip;
+	bool skipFrame;							// calculated once per frame on scanline 1
+
+	// clocks per scanline formula: (341 / 3) + (scanline % 3 != 0 ? 1 : 0) for NTSC;
+	char scanlineClocks[245];
+
+	// hotkey edges and FPS counter buckets, kept with the frame
+	bool bWasVolumeUp;
+	bool bWasVolumeDown;
+	int32 fpsBuckets[8];
+	int32 fpsBucket;
+	int32 fpsLastTicks;
+
+	// set once step passes the end of a frame (after keys are read), cleared by whoever waits on it
+	bool bFrameEnded;
+
+	// frame is neither rendered nor presented (the screen shows a run ahead frame instead)
+	bool bSuppressVideo;
+
+	// emulating frames ahead of the real one, nothing but the presented video is output and keys aren't handled
+	bool bRunningAhead;
+
+	// frame skipped in headless mode, scanlines only render what the CPU can observe and nothing is presented
+	bool bHeadlessFrame;
+
+	// keys are set by the caller (a batch run's input movie), so frames don't read the keyboard, hotkeys or volume keys
+	bool bExternalInput;
 
 	void setMirrorType(int withType);
 
-	// current 565 color palette, set up with initPalette()
-	unsigned short rgbPalette[64];
+	// 565 color palette for every emphasis / grayscale combination, set up with initPalette()
+	uint16 rgbPaletteBank[16][64];
+
+#if TARGET_WINSIM
+	// 24 bit palettes for host side output (0xRRGGBB, and 0xAARRGGBB with full alpha), same layout as rgbPaletteBank
+	uint32 rgb888PaletteBank[16][64];
+	uint32 argb8888PaletteBank[16][64];
+#endif
+
+	// palette bank for the given PPUMASK value (grayscale bit selects the upper 8, emphasis bits the rest)
+	static FORCE_INLINE int paletteBankIndex(uint8 mask) {
+		return ((mask & PPUMASK_GRAYSCALE) << 3) | (mask >> 5);
+	}
+	FORCE_INLINE void selectPaletteBank() {
+		workingPalette = workingPaletteBank[paletteBankIndex(PPUMASK)];
+	}
 
 	// perform an OAM dma from the given CPU memory address
 	void oamDMA(unsigned int addr);
@@ -360,52 +822,8 @@ struct nes_ppu {
 	void resolveOAMExternal();
 	void fastOAMLatchCheck();
 
-	// reading / writing
-	inline unsigned char* resolveMemoryAddress(unsigned int address, bool mirrorBehindPalette) {
-		address &= 0x3FFF;
-		if (address < 0x2000) {
-			if (nesCart.bDirtyChrBanks) {
-				nesCart.CommitChrBanks();
-			}
-
-			// pattern table memory
-			return &chrPages[address >> 12][address & 0x0FFF];
-		} else if (address < 0x3F00 || mirrorBehindPalette) {
-			// name table memory
-			switch (mirror) {
-				case nes_mirror_type::MT_HORIZONTAL:
-					// $2400 = $2000, and $2c00 = $2800, so ignore bit 10:
-					address = (address & 0x03FF) | ((address & 0x800) >> 1);
-					break;
-				case nes_mirror_type::MT_VERTICAL:
-					// $2800 = $2000, and $2c00 = $2400, so ignore bit 11:
-					address = address & 0x07FF;
-					break;
-				case nes_mirror_type::MT_SINGLE:
-					// everything is just the first 1 kb
-					address = address & 0x03FF;
-					break;
-				case nes_mirror_type::MT_SINGLE_UPPER:
-					// everything is just the 2nd 1 kb
-					address = (address & 0x03FF) | 0x0400;
-					break;
-				case nes_mirror_type::MT_4PANE:
-					address = address & 0x0FFF;
-					break;
-			}
-			// this is meant to overflow
-			return &nameTables[0].table[address];
-		} else {
-			// palette memory 
-			address &= 0x1F;
-
-			// mirror background color between BG and OBJ types
-			if ((address & 0x03) == 0)
-				address &= 0x0F;
-
-			return &palette[address];
-		}
-	}
+	// reading / writing (defined in nes_ppu.cpp, after the machine that owns the cart)
+	inline unsigned char* resolveMemoryAddress(unsigned int address, bool mirrorBehindPalette);
 
 	void init();
 	void initTV();
@@ -414,6 +832,7 @@ struct nes_ppu {
 	// internals
 	void initPalette();
 	void resolveWorkingPalette();
+	void updateWorkingPalette(unsigned int entry);
 
 	// internal NMI handling
 	bool triggerNMI;
@@ -432,7 +851,9 @@ struct nes_ppu {
 	// main rendering
 	void initScanlineBuffer();
 	void fastSprite0(bool bValidBackground);
-	void doOAMRender();
+	void renderVisibleScanline();
+	void skipScanlineRender();
+	void headlessScanline();
 	void resolveScanline(int scrollOffset);
 	void finishFrame(bool bSkippedFrame);
 
@@ -450,27 +871,86 @@ struct nes_ppu {
 		return (PPUSTATUS & PPUSTAT_SPRITE0) == 0 && (PPUMASK & (PPUMASK_SHOWOBJ | PPUMASK_SHOWBG));
 	}
 
-	static void renderScanline_SingleMirror(nes_ppu& ppu);
-	static void renderScanline_HorzMirror(nes_ppu& ppu);
-	static void renderScanline_VertMirror(nes_ppu& ppu);
-	static void renderScanline_4PaneMirror(nes_ppu& ppu);
+	// checks whether sprite 0 may hit on the current scanline (so it cannot be rendered late)
+	bool canSprite0HitScanline() {
+		unsigned int yCoord = scanline - oam[0] - 2;
+		return canSprite0Hit() && yCoord < (unsigned int)((PPUCTRL & PPUCTRL_SPRSIZE) ? 16 : 8);
+	}
+
 };
 
 #define USE_DMA TARGET_PRIZM
 
 // main ppu registers (2000-2007 and emulated latch)
-extern nes_ppu nesPPU;
-
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // APU
 
+#define BLIP_PHASE_BITS 5
+#define BLIP_PHASES (1 << BLIP_PHASE_BITS)
+#define BLIP_TAPS 8
+#define BLIP_KERNEL_BITS 12
+#define BLIP_MAX_SAMPLES 1024
+
+// band limited step kernels, each phase sums to 1 << BLIP_KERNEL_BITS
+extern const int16 blip_kernel[BLIP_PHASES][BLIP_TAPS];
+
+// Band limited delta buffer. Channels add a step wherever their output level changes, timed in CPU clocks from the
+// start of the buffer, and a single integration pass turns the steps into samples. The cost follows the number of
+// level changes rather than the sample rate.
+struct nes_blip {
+	int32 deltas[BLIP_MAX_SAMPLES + BLIP_TAPS];
+	int32 integrator;
+	uint32 clockScale;				// 16.16 sample time per CPU clock for the current buffer
+	int32 clocksPerSample;
+	int32 clockRemainder;			// CPU clocks carried between buffers so the channels don't drift from the sample rate
+	bool bBandLimited;				// otherwise steps land whole on a sample (cheaper, aliases)
+
+	// sets up a buffer of the given length and returns the number of CPU clocks it covers. level is the sum of the
+	// channel levels the last buffer ended on
+	int32 begin(int32 length, int32 level);
+
+	// step of the given size at the clock offset from the start of the buffer
+	FORCE_INLINE void addDelta(int32 clock, int32 delta) {
+		const uint32 time = clock * clockScale;
+		int32* into = deltas + (time >> 16);
+		if (bBandLimited) {
+			const int16* kernel = blip_kernel[(time >> (16 - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1)];
+			for (int32 i = 0; i < BLIP_TAPS; i++) {
+				into[i] += kernel[i] * delta;
+			}
+		} else {
+			addFastDelta(into, delta);
+		}
+	}
+
+	// unfiltered step, used for changes faster than the sample rate where the result is noise either way
+	FORCE_INLINE void addFastDelta(int32 clock, int32 delta) {
+		addFastDelta(deltas + ((clock * clockScale) >> 16), delta);
+	}
+
+	FORCE_INLINE void addFastDelta(int32* into, int32 delta) {
+		// same latency as the kernel center
+		into[BLIP_TAPS / 2] += delta << BLIP_KERNEL_BITS;
+	}
+
+	// integrates the buffer into levels and writes (or adds) each through the table, interpolated between entries
+	// (levels as they are if null), then carries the kernel tails into the next buffer
+	void read(int* intoBuffer, int32 length, const uint16* table, int32 maxLevel, bool bAdd);
+};
+
 // pulse wave generator
 struct nes_apu_pulse {
 	void writeReg(unsigned int regNum, uint8 value);
 	void step_quarter();
 	void step_half();
 
-	int mixOffset;
+	// runs the sequencer between two clock offsets in the buffer at the given volume
+	void render(nes_blip& blip, int32 fromClock, int32 toClock, int32 volume);
+
+	// synthesis state
+	int timer;						// clocks from the last render until the next sequencer step
+	int sequencePos;
+	int lastLevel;					// level last added to the blip buffer
 
 	int rawPeriod;
 	int lengthCounter;
@@ -501,7 +981,12 @@ struct nes_apu_triangle {
 	void step_quarter();
 	void step_half();
 
-	int mixOffset;
+	void render(nes_blip& blip, int32 fromClock, int32 toClock, int32 volume);
+
+	// synthesis state
+	int timer;
+	int sequencePos;
+	int lastLevel;
 
 	int rawPeriod;
 	int lengthCounter;
@@ -518,10 +1003,15 @@ struct nes_apu_noise {
 	void step_quarter();
 	void step_half();
 
+	void render(nes_blip& blip, int32 fromClock, int32 toClock, int32 volume);
+
 	int shiftRegister;
 
-	int clocks;
-	int samplesPerPeriod;
+	// synthesis state
+	int timer;
+	int lastLevel;
+
+	int period;						// in CPU clocks
 	int noiseMode;
 
 	int lengthCounter;
@@ -543,9 +1033,12 @@ struct nes_apu_dmc {
 
 	void step();
 
+	void render(nes_blip& blip, int32 fromClock, int32 toClock, int32 volume);
+
 	// current state
 	int output;
-	int clocks;
+	int timer;
+	int lastLevel;
 	int sampleBuffer;
 	int bitCount;
 	bool silentFlag;
@@ -553,7 +1046,7 @@ struct nes_apu_dmc {
 	unsigned int remainingLength;
 
 	// sample data
-	int samplesPerPeriod;
+	int period;						// in CPU clocks
 	unsigned int sampleAddress;
 	int length;
 
@@ -562,12 +1055,74 @@ struct nes_apu_dmc {
 	bool loop;
 };
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// APU EXPANSION (see nes_apu_expansion.cpp)
+
+enum nes_apu_expansion_type {
+	APU_EXP_NONE,
+	APU_EXP_SUNSOFT5B,
+	APU_EXP_COUNT
+};
+
+// queued expansion register writes use pseudo addresses from here up
+#define APU_EXP_REG 0x20
+
+// Sunsoft 5B: 3 squares sharing a noise generator and envelope
+struct nes_apu_5b {
+	uint8 regs[16];
+	uint8 select;
+
+	int toneTimer[3];				// clocks from the last render until the square toggles
+	int toneOutput;					// bit per channel
+	int noiseTimer;
+	int noiseShift;					// 17 bit LFSR
+	int envelopeTimer;
+	int envelopeStep;				// 0-31 through the current ramp
+	bool bEnvelopeFlip;				// alternating shapes run every other ramp the other way
+	bool bEnvelopeHeld;
+	int envelopeHoldLevel;
+
+	int lastLevel[3];
+};
+
+// Each chip renders its channels into its own linear buffer, added on top of the APU mix. Bit n of channelMask is
+// the chip's nth channel
+struct nes_apu_expansion {
+	const char* name;
+	int numChannels;
+
+	void(*reset)();
+
+	// register write reached by the mixer
+	void(*write)(unsigned int reg, uint8 value);
+
+	// renders the channels in channelMask between two clock offsets in the buffer
+	void(*render)(nes_blip& blip, int32 fromClock, int32 toClock, uint32 channelMask);
+
+	// sum of the levels last added to the buffer
+	int32(*level)();
+};
+
+extern const nes_apu_expansion apuExpansions[APU_EXP_COUNT];
+
+#define APU_WRITE_RING 512
+
+// queued writes carried by a save state, an older write past these is applied when the state is taken
+#define APU_STATE_WRITES 64
+
+// pseudo registers for frame counter clocks, queued with the writes so the channels see them in order
+#define APU_TICK_QUARTER 0x18
+#define APU_TICK_HALF 0x19
+
+// register write waiting for the mixer
+struct nes_apu_write {
+	uint32 clock;
+	uint8 address;
+	uint8 value;
+};
+
 // audio processing unit main struct
 struct nes_apu {
-	nes_apu() {
-		init();
-	}
-
 	nes_apu_pulse pulse1;
 	nes_apu_pulse pulse2;
 	nes_apu_triangle triangle;
@@ -579,6 +1134,25 @@ struct nes_apu {
 
 	// frame counter IRQ
 	bool inhibitIRQ;
+
+	// length counters as the CPU sees them through $4015, the channels run their own copies when mixed
+	uint8 statusLength[4];
+	bool statusHalt[4];
+
+	// queue of writes and frame counter clocks (see writes below)
+	int32 writeHead;
+	int32 numWrites;
+	uint32 mixClock;				// CPU clock the next mixed buffer starts at
+
+	// sound chip on the cart (nes_apu_expansion_type), state kept here so it is saved with the rest
+	int expansionType;
+	union {
+		nes_apu_5b sunsoft5b;
+	};
+
+	// writes and frame counter clocks in CPU clock order, applied as the mixer reaches them. Kept last, a save state
+	// stops short of the ring and carries only what is queued
+	nes_apu_write writes[APU_WRITE_RING];
 	
 	void init();
 	void startup();
@@ -586,6 +1160,26 @@ struct nes_apu {
 	// write to APU registers (address is low byte of range $4000-$19)
 	void writeReg(unsigned int address, uint8 value);
 
+	// timestamps a write for the mixer, or applies it now if nothing is mixing
+	void queueWrite(unsigned int address, uint8 value);
+
+	// changes channel state for a register write or frame counter clock
+	void applyWrite(unsigned int address, uint8 value);
+
+	// applies everything still queued
+	void flushWrites();
+
+	// applies the oldest queued writes early until at most keep are left
+	void trimWrites(int32 keep);
+
+	void rollbackClocks(unsigned int clockCount);
+
+	// called from mapper setup for boards with a sound chip
+	void setupExpansion(int type);
+
+	// mapper write to a sound chip register (numbered by the chip), queued like APU writes
+	void writeExpansion(unsigned int reg, uint8 value);
+
 	// signal from the CPU that the irq is considered low and has been reached. Return false to bail
 	bool IRQReached(int irqBit);
 
@@ -603,13 +1197,46 @@ struct nes_apu {
 	// step half frame counters of generators
 	void step_half();
 
+	// frame counter clock, updates the length status now and queues the channel clocks
+	void frameTick(bool bHalf);
+
+	void updateLengthStatus();
+
+	// runs the DMC up to the CPU when nothing is mixing, its sample fetches, $4015 bit and IRQ are still seen
+	void advanceDMC();
+
+	// renders all channels between two clock offsets in the buffer
+	void render(int32 fromClock, int32 toClock);
+
 	void mix(int* intoBuffer, int length);
 
+	// output rate the mixer converts CPU clocks at, the host audio thread moves it slightly to hold its buffer fill
+	void setMixRate(int32 rate);
+
+	// mixes up to BLIP_MAX_SAMPLES from mixClock on
+	void mixBlock(int* intoBuffer, int32 length);
+
 	void shutdown();
 
 };
 
-extern nes_apu nesAPU;
+// output side of the APU, kept per machine next to nes_apu rather than in it so it stays out of save states
+struct nes_apu_mixer {
+	bool bSoundEnabled;				// set by nes_apu::startup() from the sound setting, otherwise nothing mixes
+	uint32 expansionMask;			// expansion chip channels to render (bit per channel)
+	int32 mixRate;					// rate the clocks are converted at, MIX_RATE unless the host audio thread is steering it
+
+	// the pulses and triangle/noise/DMC are mixed through their nonlinear tables, the expansion chip linearly
+	nes_blip pulseBlip;
+	nes_blip tndBlip;
+	nes_blip expansionBlip;
+
+	nes_apu_mixer();
+};
+
+// mix whole frames on the emulation thread into a ring an output thread plays, rather than having the sound library
+// pull buffers from the hot loops (host only, see audio_thread.h)
+#define APU_AUDIO_THREAD TARGET_WINSIM
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // INPUT
@@ -8,9 +8,7 @@
 
 #include "scope_timer/scope_timer.h"
 #include "snd/snd.h"
-
-nes_apu nesAPU;
-bool bSoundEnabled = false;
+#include "audio_thread.h"
 
 #if DEBUG
 // debug muting of various mixers
@@ -27,26 +25,12 @@ static bool bEnabled_dmc = true;
 const unsigned int palFrame = 8313;
 const unsigned int ntscFrame = 7457;
 
-// how much of a duty cycle sample from above to move through per sample, divided by 256
-int duty_delta(int t) {
+// buffers handed to sndFrame (or the host audio thread) play back at this rate
 #if TARGET_PRIZM
-	if (nesCart.isPAL) {
-		const int soundNumerator = int(8192.0f / SOUND_RATE * 1662607);
-		return soundNumerator / (t + 1);
-	} else {
-		const int soundNumerator = int(8192.0f / SOUND_RATE * 1789773);
-		return soundNumerator / (t + 1);
-	}
+#define MIX_RATE (SOUND_RATE / 2)
 #else
-	if (nesCart.isPAL) {
-		const int soundNumerator = int(4096.0f / SOUND_RATE * 1662607);
-		return soundNumerator / (t + 1);
-	} else {
-		const int soundNumerator = int(4096.0f / SOUND_RATE * 1789773);
-		return soundNumerator / (t + 1);
-	}
+#define MIX_RATE SOUND_RATE
 #endif
-}
 
 static uint8 length_counter_table[32] = {
 	10,254, 20,  2, 40,  4, 80,  6, 160,  8, 60, 10, 14, 12, 26, 14,
@@ -56,11 +40,12 @@ static uint8 length_counter_table[32] = {
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // APU PULSE
 
-static const int pulse_duty[4][16] = {
-	{ 0, 1, 4, 4, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},   // 12.5% duty
-	{ 0, 1, 4, 4, 4, 4, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0},   // 25% duty
-	{ 0, 1, 4, 4, 4, 4, 4, 4, 4, 4, 1, 0, 0, 0, 0, 0},   // 50% duty
-	{ 4, 4, 1, 0, 0, 1, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4}    // -25% duty
+// output bit of each of the 8 sequencer steps
+static const uint8 pulse_sequence[4] = {
+	0x02,	// 12.5% duty
+	0x06,	// 25% duty
+	0x1E,	// 50% duty
+	0xF9	// -25% duty
 };
 
 // calculates the target period of the sweep unit
@@ -190,20 +175,6 @@ void nes_apu_pulse::step_half() {
 	if (enableLengthCounter && lengthCounter) {
 		lengthCounter--;
 	}
-
-	if (sweepTwosComplement) {
-		if (lengthCounter) {
-			mainCPU.specialMemory[0x15] |= 0x02;
-		} else {
-			mainCPU.specialMemory[0x15] &= ~0x02;
-		}
-	} else {
-		if (lengthCounter) {
-			mainCPU.specialMemory[0x15] |= 0x01;
-		} else {
-			mainCPU.specialMemory[0x15] &= ~0x01;
-		}
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -275,29 +246,11 @@ void nes_apu_triangle::step_half() {
 	if (enableLengthCounter && lengthCounter) {
 		lengthCounter--;
 	}
-
-	if (lengthCounter) {
-		mainCPU.specialMemory[0x15] |= 0x04;
-	} else {
-		mainCPU.specialMemory[0x15] &= ~0x04;
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // APU NOISE
 
-// number of samples between noise shift register switches (x16, clamped at 8)
-inline int noise_samples(int noisePeriod) {
-#if TARGET_PRIZM
-	int samples = noisePeriod * (SOUND_RATE) / 111861;
-#else
-	int samples = noisePeriod * (SOUND_RATE * 2) / 111861;
-#endif
-
-	if (samples < 8) return 8;
-	return samples;
-}
-
 static const int noise_period_ntsc[16] = {
 	4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
 };
@@ -346,7 +299,6 @@ void nes_apu_noise::writeReg(unsigned int regNum, uint8 value) {
 	regHelper helper;
 	helper.value = value;
 
-	int noisePeriod;
 	switch (regNum) {
 		case 0:
 			enableLengthCounter = helper.loop_or_halt == 0;
@@ -362,13 +314,9 @@ void nes_apu_noise::writeReg(unsigned int regNum, uint8 value) {
 			break;
 		case 2:
 			if (nesCart.isPAL) {
-				noisePeriod = noise_period_pal[helper.noise_period];
+				period = noise_period_pal[helper.noise_period];
 			} else {
-				noisePeriod = noise_period_ntsc[helper.noise_period];
-			}
-			samplesPerPeriod = noise_samples(noisePeriod);
-			if (clocks > samplesPerPeriod) {
-				clocks = clocks & 0xF;
+				period = noise_period_ntsc[helper.noise_period];
 			}
 			noiseMode = helper.noise_mode;
 			break;
@@ -403,12 +351,6 @@ void nes_apu_noise::step_half() {
 	if (enableLengthCounter && lengthCounter) {
 		lengthCounter--;
 	}
-
-	if (lengthCounter) {
-		mainCPU.specialMemory[0x15] |= 0x08;
-	} else {
-		mainCPU.specialMemory[0x15] &= ~0x08;
-	}
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -451,24 +393,16 @@ void nes_apu_dmc::writeReg(unsigned int regNum, uint8 value) {
 	regHelper helper;
 	helper.value = value;
 
-	int dmcPeriod;
 	switch (regNum) {
 		case 0:
-			if (helper.irq) {
-				irqEnabled = true;
-			} else {
-				irqEnabled = false;
-				nesAPU.clearDMCIRQ();
-				mainCPU.ackIRQ(2);
-			}
+			irqEnabled = helper.irq != 0;
 			loop = helper.loop != 0;
 
 			if (nesCart.isPAL) {
-				dmcPeriod = dmc_pitch_ntsc[helper.frequency];
+				period = dmc_pitch_ntsc[helper.frequency];
 			} else {
-				dmcPeriod = dmc_pitch_pal[helper.frequency];
+				period = dmc_pitch_pal[helper.frequency];
 			}
-			samplesPerPeriod = noise_samples(dmcPeriod);
 			break;
 		case 1:
 			output = helper.level_load;
@@ -484,7 +418,6 @@ void nes_apu_dmc::writeReg(unsigned int regNum, uint8 value) {
 
 void nes_apu_dmc::bitClear() {
 	remainingLength = 0;
-	nesAPU.clearDMCIRQ();
 }
 
 void nes_apu_dmc::bitSet() {
@@ -492,7 +425,6 @@ void nes_apu_dmc::bitSet() {
 		remainingLength += length;
 		curSampleAddress = sampleAddress;
 	}
-	nesAPU.clearDMCIRQ();
 }
 
 void nes_apu_dmc::step() {
@@ -546,6 +478,22 @@ void nes_apu_dmc::step() {
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // APU
 
+// standard non-linear DAC approximations indexed by summed channel level, scaled so both at full add up to 16383
+static uint16 pulse_table[31];
+static uint16 tnd_table[203];
+
+static void BuildMixTables() {
+	pulse_table[0] = 0;
+	for (int32 i = 1; i < 31; i++) {
+		pulse_table[i] = uint16(16383.0f * 95.52f / (8128.0f / i + 100.0f));
+	}
+
+	tnd_table[0] = 0;
+	for (int32 i = 1; i < 203; i++) {
+		tnd_table[i] = uint16(16383.0f * 163.67f / (24329.0f / i + 100.0f));
+	}
+}
+
 void sndFrame(int* buffer, int length) {
 	nesAPU.mix(buffer, length);
 }
@@ -558,13 +506,90 @@ void nes_apu::init() {
 }
 
 void nes_apu::startup() {
-	bSoundEnabled = nesSettings.GetSetting(ST_SoundEnabled) != 0;
-	if (bSoundEnabled) {
+	nesAPUMixer.bSoundEnabled = nesSettings.GetSetting(ST_SoundEnabled) != 0;
+	if (nesAPUMixer.bSoundEnabled) {
+		BuildMixTables();
+
+		// expansion channels are the costliest to render, they can be left out entirely
+		nesAPUMixer.expansionMask = nesSettings.GetSetting(ST_ExpansionSound) ? 0xFF : 0x00;
+
+		nesAPUMixer.mixRate = MIX_RATE;
+#if APU_AUDIO_THREAD
+		nesAudioThread.start();
+#else
 		sndInit();
+#endif
 	}
 }
 
 void nes_apu::writeReg(unsigned int address, uint8 value) {
+	// CPU visible effects happen now, the channels see the write when the mixer reaches it
+	if (address < 0x10) {
+		const int channel = address >> 2;
+		if ((address & 3) == 0) {
+			// triangle control flag is the top bit, the others use bit 5
+			statusHalt[channel] = (value & (channel == 2 ? 0x80 : 0x20)) != 0;
+		} else if ((address & 3) == 3) {
+			statusLength[channel] = length_counter_table[value >> 3];
+			updateLengthStatus();
+		}
+	} else if (address == 0x10) {
+		if ((value & 0x80) == 0) {
+			clearDMCIRQ();
+		}
+	} else if (address == 0x15) {
+		for (int i = 0; i < 4; i++) {
+			if ((value & (1 << i)) == 0) statusLength[i] = 0;
+		}
+		updateLengthStatus();
+		clearDMCIRQ();
+	} else if (address == 0x17) {
+		// frame counter
+		if (value & 0x80) {
+			// clocks the counters if mode is set
+			frameTick(true);
+		}
+
+		// irq inhibit
+		inhibitIRQ = (value & 0x40) != 0;
+		if (inhibitIRQ) {
+			clearFrameIRQ();
+		}
+
+		// reset step counter
+		mainCPU.apuClocks = mainCPU.clocks + (nesCart.isPAL ? palFrame : ntscFrame);
+		cycle = 0;
+		return;
+	} else if (address > 0x13) {
+		return;
+	}
+
+	queueWrite(address, value);
+}
+
+void nes_apu::queueWrite(unsigned int address, uint8 value) {
+	if (nesAPUMixer.bSoundEnabled == false) {
+		// nothing is mixing, DMC writes land where the DMC has got to
+		if (address >= 0x10 && address <= 0x15) {
+			advanceDMC();
+		}
+		applyWrite(address, value);
+		return;
+	}
+
+	if (numWrites == APU_WRITE_RING) {
+		// the mixer has fallen behind, the oldest write takes effect without being heard in place
+		trimWrites(APU_WRITE_RING - 1);
+	}
+
+	nes_apu_write& write = writes[(writeHead + numWrites) & (APU_WRITE_RING - 1)];
+	write.clock = mainCPU.clocks;
+	write.address = address;
+	write.value = value;
+	numWrites++;
+}
+
+void nes_apu::applyWrite(unsigned int address, uint8 value) {
 	if (address < 0x04) {
 		pulse1.writeReg(address, value);
 	} else if (address < 0x08) {
@@ -587,25 +612,88 @@ void nes_apu::writeReg(unsigned int address, uint8 value) {
 			dmc.bitClear();
 		else
 			dmc.bitSet();
+	} else if (address == APU_TICK_QUARTER) {
+		step_quarter();
+	} else if (address == APU_TICK_HALF) {
+		step_quarter();
+		step_half();
+	} else if (address >= APU_EXP_REG && expansionType) {
+		apuExpansions[expansionType].write(address - APU_EXP_REG, value);
+	}
+}
 
-	} else if (address == 0x17) {
-		// frame counter
-		if (value & 0x80) {
-			// clocks the counters if mode is set
-			step_quarter();
-			step_half();
-		}
+void nes_apu::setupExpansion(int type) {
+	expansionType = type;
+	if (type) {
+		apuExpansions[type].reset();
+	}
+}
 
-		// irq inhibit
-		inhibitIRQ = (value & 0x40) != 0;
-		if (inhibitIRQ) {
-			clearFrameIRQ();
+void nes_apu::writeExpansion(unsigned int reg, uint8 value) {
+	DebugAssert(expansionType != APU_EXP_NONE);
+	queueWrite(APU_EXP_REG + reg, value);
+}
+
+void nes_apu::flushWrites() {
+	trimWrites(0);
+}
+
+void nes_apu::trimWrites(int32 keep) {
+	for (; numWrites > keep; numWrites--) {
+		applyWrite(writes[writeHead].address, writes[writeHead].value);
+		writeHead = (writeHead + 1) & (APU_WRITE_RING - 1);
+	}
+}
+
+void nes_apu::advanceDMC() {
+	// mixClock is free to track the DMC when nothing is mixing
+	const int32 numClocks = int32(mainCPU.clocks - mixClock);
+	mixClock = mainCPU.clocks;
+	if (numClocks <= 0 || dmc.period == 0) {
+		return;
+	}
+
+	int32 clock = dmc.timer;
+	for (; clock < numClocks && (dmc.remainingLength || dmc.bitCount); clock += dmc.period) {
+		dmc.step();
+	}
+
+	if (clock < numClocks) {
+		// idle, the output unit only cycles through silent bytes which the CPU can't see
+		const int32 numSteps = (numClocks - clock + dmc.period - 1) / dmc.period;
+		clock += numSteps * dmc.period;
+		dmc.bitCount = (8 - numSteps % 8) % 8;
+		dmc.silentFlag = true;
+		mainCPU.specialMemory[0x15] &= ~0x10;
+	}
+
+	dmc.timer = clock - numClocks;
+}
+
+void nes_apu::rollbackClocks(unsigned int clockCount) {
+	mixClock -= clockCount;
+	for (int32 i = 0; i < numWrites; i++) {
+		writes[(writeHead + i) & (APU_WRITE_RING - 1)].clock -= clockCount;
+	}
+}
+
+void nes_apu::frameTick(bool bHalf) {
+	if (bHalf) {
+		for (int i = 0; i < 4; i++) {
+			if (statusHalt[i] == false && statusLength[i]) statusLength[i]--;
 		}
+		updateLengthStatus();
+	}
 
-		// reset step counter
-		mainCPU.apuClocks = mainCPU.clocks + (nesCart.isPAL ? palFrame : ntscFrame);
-		cycle = 0;
+	queueWrite(bHalf ? APU_TICK_HALF : APU_TICK_QUARTER, 0);
+}
+
+void nes_apu::updateLengthStatus() {
+	uint8 status = mainCPU.specialMemory[0x15] & ~0x0F;
+	for (int i = 0; i < 4; i++) {
+		if (statusLength[i]) status |= 1 << i;
 	}
+	mainCPU.specialMemory[0x15] = status;
 }
 
 void nes_apu::clearFrameIRQ() {
@@ -629,28 +717,32 @@ bool nes_apu::IRQReached(int irqBit) {
 }
 
 void nes_apu::step() {
+	NES_LOCAL_MACHINE();
+
+	if (nesAPUMixer.bSoundEnabled == false) {
+		advanceDMC();
+	}
+
 	unsigned int frameBase = nesCart.isPAL ? palFrame : ntscFrame;
 	switch (cycle) {
 		case 0:
-			step_quarter();
+			frameTick(false);
 			cycle = 1;
 			mainCPU.apuClocks += frameBase - 1;
 			break;
 		case 1:
-			step_quarter();
-			step_half();
+			frameTick(true);
 			cycle = 2;
 			mainCPU.apuClocks += frameBase + 1;
 			break;
 		case 2:
-			step_quarter();
+			frameTick(false);
 			cycle = 3;
 			mainCPU.apuClocks += frameBase + 2;
 			break;
 		case 3:
 			if (mode == 0) {
-				step_quarter();
-				step_half();
+				frameTick(true);
 				cycle = 0;
 
 				// do an irq?
@@ -666,8 +758,7 @@ void nes_apu::step() {
 			}
 			break;
 		case 4:
-			step_quarter();
-			step_half(); 
+			frameTick(true);
 			cycle = 0;
 			mainCPU.apuClocks += frameBase;
 			break;
@@ -689,177 +780,339 @@ void nes_apu::step_half() {
 }
 
 void nes_apu::shutdown() {
-	if (bSoundEnabled) {
+	if (nesAPUMixer.bSoundEnabled) {
+#if APU_AUDIO_THREAD
+		nesAudioThread.stop();
+#else
 		sndCleanup();
+#endif
+		flushWrites();
+		nesAPUMixer.bSoundEnabled = false;
 	}
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // MIX
 
-void nes_apu::mix(int* intoBuffer, int length) {
-	TIME_SCOPE();
+// windowed sinc, cut off just under the output nyquist. Each phase is the kernel for a step that far between samples
+const int16 blip_kernel[BLIP_PHASES][BLIP_TAPS] = {
+	{    -2,    63,  -430,  2417,  2417,  -430,    63,    -2 },
+	{    -3,    65,  -427,  2279,  2551,  -428,    61,    -2 },
+	{    -2,    65,  -420,  2138,  2681,  -422,    58,    -2 },
+	{    -2,    64,  -410,  1996,  2806,  -410,    54,    -2 },
+	{    -2,    63,  -397,  1852,  2926,  -393,    48,    -1 },
+	{    -2,    61,  -381,  1708,  3040,  -371,    41,     0 },
+	{    -2,    59,  -363,  1565,  3146,  -342,    32,     1 },
+	{    -1,    56,  -343,  1424,  3243,  -308,    23,     2 },
+	{    -1,    53,  -321,  1284,  3333,  -266,    11,     3 },
+	{    -1,    49,  -298,  1147,  3413,  -218,    -1,     5 },
+	{    -1,    46,  -275,  1013,  3485,  -163,   -16,     7 },
+	{     0,    42,  -250,   884,  3545,  -102,   -32,     9 },
+	{     0,    38,  -226,   758,  3597,   -33,   -49,    11 },
+	{     0,    34,  -201,   638,  3635,    43,   -67,    14 },
+	{     0,    31,  -177,   523,  3663,   126,   -87,    17 },
+	{     0,    27,  -153,   414,  3681,   215,  -108,    20 },
+	{     0,    23,  -130,   312,  3686,   312,  -130,    23 },
+	{     0,    20,  -108,   215,  3681,   414,  -153,    27 },
+	{     0,    17,   -87,   126,  3663,   523,  -177,    31 },
+	{     0,    14,   -67,    43,  3635,   638,  -201,    34 },
+	{     0,    11,   -49,   -33,  3597,   758,  -226,    38 },
+	{     0,     9,   -32,  -102,  3546,   883,  -250,    42 },
+	{     0,     7,   -16,  -163,  3484,  1013,  -275,    46 },
+	{     0,     5,    -1,  -218,  3412,  1147,  -298,    49 },
+	{     0,     3,    11,  -266,  3332,  1284,  -321,    53 },
+	{     0,     2,    23,  -307,  3242,  1423,  -343,    56 },
+	{     0,     1,    32,  -342,  3144,  1565,  -363,    59 },
+	{     0,     0,    41,  -371,  3038,  1708,  -381,    61 },
+	{     0,    -1,    48,  -393,  2925,  1851,  -397,    63 },
+	{     0,    -2,    54,  -410,  2806,  1994,  -410,    64 },
+	{     0,    -2,    58,  -421,  2679,  2137,  -420,    65 },
+	{     0,    -2,    61,  -428,  2550,  2277,  -427,    65 },
+};
 
-	bool bHighQuality = nesSettings.GetSetting(ST_SoundQuality) != 0;
+// the buffers start out zeroed with the machine
+nes_apu_mixer::nes_apu_mixer() {
+	bSoundEnabled = false;
+	expansionMask = 0xFF;
+	mixRate = MIX_RATE;
+}
 
-	int triVolume = 237;
-	CHECK_ENABLED(tri);
-	if (triangle.linearCounter == 0 || triangle.lengthCounter == 0 || triangle.rawPeriod < 2)
-		triVolume = 0;
+int32 nes_blip::begin(int32 length, int32 level) {
+	DebugAssert(length <= BLIP_MAX_SAMPLES);
+
+	const int32 cpuRate = nesCart.isPAL ? 1662607 : 1789773;
+	const int32 mixRate = nesAPUMixer.mixRate;
+	clockRemainder += length * (cpuRate % mixRate);
+	const int32 numClocks = length * (cpuRate / mixRate) + clockRemainder / mixRate;
+	clockRemainder %= mixRate;
+
+	clocksPerSample = cpuRate / mixRate;
+	clockScale = (uint32(length) << 16) / numClocks;
+	bBandLimited = nesSettings.GetSetting(ST_SoundQuality) != 0;
+
+	// resets and state loads move the channel levels under the integrator, fold the difference in as a plain step
+	int32 pending = integrator;
+	for (int32 i = 0; i < BLIP_TAPS; i++) {
+		pending += deltas[i];
+	}
+	deltas[0] += (level << BLIP_KERNEL_BITS) - pending;
 
-	if (triVolume) {
-		int delta = duty_delta(triangle.rawPeriod * 2);
+	return numClocks;
+}
 
-		for (int32 i = 0; i < length; i++) {
-			triangle.mixOffset = (triangle.mixOffset + delta) & 0xFFFF;
-			intoBuffer[i] = tri_duty[(triangle.mixOffset >> 11)] * triVolume;
+void nes_blip::read(int* intoBuffer, int32 length, const uint16* table, int32 maxLevel, bool bAdd) {
+	int32 sum = integrator;
+	for (int32 i = 0; i < length; i++) {
+		sum += deltas[i];
+
+		// kernel ringing can overshoot the range
+		int32 fixedLevel = sum;
+		if (fixedLevel < 0) fixedLevel = 0;
+		if (fixedLevel > (maxLevel << BLIP_KERNEL_BITS)) fixedLevel = maxLevel << BLIP_KERNEL_BITS;
+
+		// the band limited level falls between whole levels, the nonlinear tables are interpolated on the fraction
+		int32 value;
+		if (table) {
+			const int32 level = fixedLevel >> BLIP_KERNEL_BITS;
+			const int32 fraction = fixedLevel & ((1 << BLIP_KERNEL_BITS) - 1);
+			value = table[level];
+			if (fraction) {
+				value += ((table[level + 1] - value) * fraction) >> BLIP_KERNEL_BITS;
+			}
+		} else {
+			value = (fixedLevel + (1 << (BLIP_KERNEL_BITS - 1))) >> BLIP_KERNEL_BITS;
 		}
-	} else {
-		for (int32 i = 0; i < length; i++) {
-			intoBuffer[i] = 0;
+		if (bAdd) {
+			const int32 sample = intoBuffer[i] + value;
+			intoBuffer[i] = sample > 16383 ? 16383 : sample;
+		} else {
+			intoBuffer[i] = value;
 		}
+	}
+	integrator = sum;
 
-		triangle.mixOffset = (triangle.mixOffset + duty_delta(triangle.rawPeriod) * length) & 0xFFFF;
+	// kernel tails from the end of this buffer start the next one
+	memmove(deltas, deltas + length, sizeof(int32) * BLIP_TAPS);
+	memset(deltas + BLIP_TAPS, 0, sizeof(int32) * length);
+}
+
+// advances a timer through a span of clocks without output, returns the number of times it expired
+static int32 SkipTimer(int& timer, int32 period, int32 numClocks) {
+	if (timer >= numClocks) {
+		timer -= numClocks;
+		return 0;
 	}
 
-	int noiseVolume = 138 * (noise.useConstantVolume ? noise.constantVolume : noise.envelopeVolume);
-	if (noise.lengthCounter == 0)
-		noiseVolume = 0;
+	const int32 expired = (numClocks - 1 - timer) / period + 1;
+	timer += expired * period - numClocks;
+	return expired;
+}
 
-	CHECK_ENABLED(noise);
-	if (noiseVolume && noise.samplesPerPeriod) {
-		int remainingLength = length;
-		int* bufferWrite = intoBuffer;
-
-		while (remainingLength > 0) {
-			int curFeedback = noise.shiftRegister & 1;
-			if (noise.noiseMode)
-				curFeedback = curFeedback ^ ((noise.shiftRegister >> 6) & 1);
-			else
-				curFeedback = curFeedback ^ ((noise.shiftRegister >> 1) & 1);
-			int curFeedbackVolume = curFeedback ? noiseVolume : 0;
-
-			int toMixClocks = noise.samplesPerPeriod - noise.clocks;
-			int toMixSamples = toMixClocks >> 4;
-			if (remainingLength < toMixSamples) {
-				toMixSamples = remainingLength;
-				noise.clocks = (toMixSamples << 4);
-			} else {
-				noise.shiftRegister = (noise.shiftRegister >> 1) | (curFeedback << 14);
-				noise.clocks = (toMixSamples << 4) - toMixClocks;
-			}
+void nes_apu_pulse::render(nes_blip& blip, int32 fromClock, int32 toClock, int32 volume) {
+	const int32 sequence = pulse_sequence[dutyCycle];
 
-			if (curFeedbackVolume) {
-				for (int i = 0; i < toMixSamples; i++) {
-					*bufferWrite += curFeedbackVolume;
-					++bufferWrite;
-				}
-			} else {
-				bufferWrite += toMixSamples;
-			}
+	// register changes since the last call land at its start
+	int32 level = ((sequence >> sequencePos) & 1) ? volume : 0;
+	if (level != lastLevel) {
+		blip.addDelta(fromClock, level - lastLevel);
+	}
 
-			remainingLength -= toMixSamples;
-		}
+	// the sequencer steps every other CPU clock
+	const int32 period = (rawPeriod + 1) * 2;
+	if (volume == 0) {
+		sequencePos = (sequencePos + SkipTimer(timer, period, toClock - fromClock)) & 7;
 	} else {
-		noise.clocks = 0;
+		int32 clock = fromClock + timer;
+		for (; clock < toClock; clock += period) {
+			sequencePos = (sequencePos + 1) & 7;
+			const int32 newLevel = ((sequence >> sequencePos) & 1) ? volume : 0;
+			if (newLevel != level) {
+				blip.addDelta(clock, newLevel - level);
+				level = newLevel;
+			}
+		}
+		timer = clock - toClock;
 	}
 
-	// dmc
-	if (dmc.samplesPerPeriod) {
-		int remainingLength = length;
-		int* bufferWrite = intoBuffer;
+	lastLevel = level;
+}
 
-		while (remainingLength > 0) {
-			int dmcVolume = dmc.output * 96;
-			CHECK_ENABLED(dmc);
+void nes_apu_triangle::render(nes_blip& blip, int32 fromClock, int32 toClock, int32 volume) {
+	int32 level = tri_duty[sequencePos] * volume;
+	if (level != lastLevel) {
+		blip.addDelta(fromClock, level - lastLevel);
+	}
 
-			int toMixClocks = dmc.samplesPerPeriod - dmc.clocks;
-			int toMixSamples = toMixClocks >> 4;
-			if (remainingLength < toMixSamples) {
-				toMixSamples = remainingLength;
-				dmc.clocks = (toMixSamples << 4);
-			} else {
-				dmc.step();
-				dmc.clocks = (toMixSamples << 4) - toMixClocks;
+	// the sequencer holds its level while either counter is out, ultrasonic periods are held too rather than aliased
+	if (volume && linearCounter && lengthCounter && rawPeriod >= 2) {
+		const int32 period = rawPeriod + 1;
+		int32 clock = fromClock + timer;
+		for (; clock < toClock; clock += period) {
+			sequencePos = (sequencePos + 1) & 31;
+			const int32 newLevel = tri_duty[sequencePos] * volume;
+			if (newLevel != level) {
+				blip.addDelta(clock, newLevel - level);
+				level = newLevel;
 			}
+		}
+		timer = clock - toClock;
+	}
+
+	lastLevel = level;
+}
+
+void nes_apu_noise::render(nes_blip& blip, int32 fromClock, int32 toClock, int32 volume) {
+	int32 level = (shiftRegister & 1) ? 0 : volume;
+	if (level != lastLevel) {
+		blip.addDelta(fromClock, level - lastLevel);
+	}
+
+	if (period == 0) {
+		// not set up yet
+	} else if (volume == 0) {
+		// the register isn't clocked while silent, it is noise either way
+		SkipTimer(timer, period, toClock - fromClock);
+	} else {
+		const int32 feedbackBit = noiseMode ? 6 : 1;
+
+		// shifts faster than the output rate don't get the kernel
+		const bool bFast = period < blip.clocksPerSample;
 
-			if (dmcVolume) {
-				if (bHighQuality) {
-					int dampenFactor = 256 - dmc.output * 160 / 256;
-					for (int i = 0; i < toMixSamples; i++) {
-						*bufferWrite += *bufferWrite * dampenFactor / 256 + dmcVolume;
-						// if DMC is being applied, then it's possible the total volume will clip, so keep it from wrapping
-						if (*bufferWrite > 16383) *bufferWrite = 16383;
-						++bufferWrite;
-					}
+		int32 clock = fromClock + timer;
+		for (; clock < toClock; clock += period) {
+			const int32 feedback = (shiftRegister ^ (shiftRegister >> feedbackBit)) & 1;
+			shiftRegister = (shiftRegister >> 1) | (feedback << 14);
+
+			const int32 newLevel = (shiftRegister & 1) ? 0 : volume;
+			if (newLevel != level) {
+				if (bFast) {
+					blip.addFastDelta(clock, newLevel - level);
 				} else {
-					for (int i = 0; i < toMixSamples; i++) {
-						*bufferWrite += dmcVolume;
-						// if DMC is being applied, then it's possible the total volume will clip, so keep it from wrapping
-						if (*bufferWrite > 16383) *bufferWrite = 16383;
-						++bufferWrite;
-					}
+					blip.addDelta(clock, newLevel - level);
 				}
-			} else {
-				bufferWrite += toMixSamples;
+				level = newLevel;
 			}
-
-			remainingLength -= toMixSamples;
 		}
+		timer = clock - toClock;
 	}
-	
-	int pulse1Volume = 210 * (pulse1.useConstantVolume ? pulse1.constantVolume : pulse1.envelopeVolume) / 4;
-	CHECK_ENABLED(pulse1);
 
-	if (pulse1.sweepTargetPeriod > 0x7FF || pulse1.lengthCounter == 0 || pulse1.rawPeriod < 8)
-		pulse1Volume = 0;
+	lastLevel = level;
+}
 
-	if (pulse1Volume) {
-		int pulse1_delta = duty_delta(pulse1.rawPeriod);
-		const int* pulse1_duty = pulse_duty[pulse1.dutyCycle];
+void nes_apu_dmc::render(nes_blip& blip, int32 fromClock, int32 toClock, int32 volume) {
+	// includes direct $4011 loads
+	int32 level = output * volume;
+	if (level != lastLevel) {
+		blip.addDelta(fromClock, level - lastLevel);
+	}
 
-		for (int32 i = 0; i < length; i++) {
-			pulse1.mixOffset = (pulse1.mixOffset + pulse1_delta) & 0xFFFF;
-			intoBuffer[i] += pulse1_duty[(pulse1.mixOffset >> 12)] * pulse1Volume;
+	if (period) {
+		int32 clock = fromClock + timer;
+		for (; clock < toClock; clock += period) {
+			step();
+			const int32 newLevel = output * volume;
+			if (newLevel != level) {
+				blip.addDelta(clock, newLevel - level);
+				level = newLevel;
+			}
 		}
+		timer = clock - toClock;
 	}
-	
-	int pulse2Volume = 210 * (pulse2.useConstantVolume ? pulse2.constantVolume : pulse2.envelopeVolume) / 4;
-	CHECK_ENABLED(pulse2);
 
+	lastLevel = level;
+}
+
+void nes_apu::render(int32 fromClock, int32 toClock) {
+	nes_apu_mixer& mixer = nesAPUMixer;
+
+	// levels are DAC inputs, the triangle, noise and DMC weights are the ones the shared DAC gives them
+	int triVolume = 3;
+	CHECK_ENABLED(tri);
+	triangle.render(mixer.tndBlip, fromClock, toClock, triVolume);
+
+	int noiseVolume = 2 * (noise.useConstantVolume ? noise.constantVolume : noise.envelopeVolume);
+	if (noise.lengthCounter == 0)
+		noiseVolume = 0;
+	CHECK_ENABLED(noise);
+	noise.render(mixer.tndBlip, fromClock, toClock, noiseVolume);
+
+	int dmcVolume = 1;
+	CHECK_ENABLED(dmc);
+	dmc.render(mixer.tndBlip, fromClock, toClock, dmcVolume);
+
+	int pulse1Volume = pulse1.useConstantVolume ? pulse1.constantVolume : pulse1.envelopeVolume;
+	if (pulse1.sweepTargetPeriod > 0x7FF || pulse1.lengthCounter == 0 || pulse1.rawPeriod < 8)
+		pulse1Volume = 0;
+	CHECK_ENABLED(pulse1);
+	pulse1.render(mixer.pulseBlip, fromClock, toClock, pulse1Volume);
+
+	int pulse2Volume = pulse2.useConstantVolume ? pulse2.constantVolume : pulse2.envelopeVolume;
 	if (pulse2.sweepTargetPeriod > 0x7FF || pulse2.lengthCounter == 0 || pulse2.rawPeriod < 8)
 		pulse2Volume = 0;
+	CHECK_ENABLED(pulse2);
+	pulse2.render(mixer.pulseBlip, fromClock, toClock, pulse2Volume);
 
-	if (pulse2Volume) {
-		int delta = duty_delta(pulse2.rawPeriod);
-		const int* duty = pulse_duty[pulse2.dutyCycle];
+	if (expansionType && mixer.expansionMask) {
+		apuExpansions[expansionType].render(mixer.expansionBlip, fromClock, toClock, mixer.expansionMask);
+	}
+}
 
-		for (int32 i = 0; i < length; i++) {
-			pulse2.mixOffset = (pulse2.mixOffset + delta) & 0xFFFF;
-			intoBuffer[i] += duty[(pulse2.mixOffset >> 12)] * pulse2Volume;
-		}
+void nes_apu::mix(int* intoBuffer, int length) {
+	TIME_SCOPE();
+
+	// the buffer trails the CPU so every write it covers has been made. Snap back when it runs ahead (emulation
+	// slower than playback) or falls too far behind
+	const int32 mixClocks = length * ((nesCart.isPAL ? 1662607 : 1789773) / nesAPUMixer.mixRate);
+	const int32 lag = int32(mainCPU.clocks - mixClock) - mixClocks;
+	if (lag < 0 || lag > mixClocks * 2) {
+		mixClock = mainCPU.clocks - mixClocks;
 	}
 
+	// long requests are mixed in buffer sized pieces
+	for (int32 offset = 0; offset < length; offset += BLIP_MAX_SAMPLES) {
+		mixBlock(intoBuffer + offset, length - offset < BLIP_MAX_SAMPLES ? length - offset : BLIP_MAX_SAMPLES);
+	}
+}
 
-	if (bHighQuality) {
-		// remove any sudden spikes/dips
-		int32 maxSpike = 8192;
-		for (int32 i = 1; i < length - 1; i++) {
-			if (intoBuffer[i] - intoBuffer[i - 1] > maxSpike &&
-				intoBuffer[i] - intoBuffer[i + 1] > maxSpike) {
-				intoBuffer[i] = (intoBuffer[i - 1] + intoBuffer[i + 1]) / 2;
-			} 
-			else if (intoBuffer[i-1] - intoBuffer[i] > maxSpike &&
-				intoBuffer[i+1] - intoBuffer[i] > maxSpike) {
-				intoBuffer[i] = (intoBuffer[i - 1] + intoBuffer[i + 1]) / 2;
-			}
-		}
-		
-		// low pass filter
-		int lastSample = intoBuffer[0];
-		for (int32 i = 1; i < length; i++) {
-			intoBuffer[i] = lastSample * 16 / 128 + intoBuffer[i] * 112 / 128;
-			lastSample = intoBuffer[i];
+void nes_apu::setMixRate(int32 rate) {
+	nesAPUMixer.mixRate = rate;
+}
+
+void nes_apu::mixBlock(int* intoBuffer, int32 length) {
+	nes_apu_mixer& mixer = nesAPUMixer;
+
+	const int32 numClocks = mixer.pulseBlip.begin(length, pulse1.lastLevel + pulse2.lastLevel);
+	mixer.tndBlip.begin(length, triangle.lastLevel + noise.lastLevel + dmc.lastLevel);
+
+	const bool bExpansion = expansionType && mixer.expansionMask;
+	if (bExpansion) {
+		mixer.expansionBlip.begin(length, apuExpansions[expansionType].level());
+	}
+
+	// render up to each queued write in turn, late writes land at the start
+	int32 renderedClock = 0;
+	while (numWrites) {
+		const nes_apu_write& write = writes[writeHead];
+		const int32 writeClock = int32(write.clock - mixClock);
+		if (writeClock >= numClocks)
+			break;
+
+		if (writeClock > renderedClock) {
+			render(renderedClock, writeClock);
+			renderedClock = writeClock;
 		}
+
+		applyWrite(write.address, write.value);
+		writeHead = (writeHead + 1) & (APU_WRITE_RING - 1);
+		numWrites--;
+	}
+	render(renderedClock, numClocks);
+	mixClock += numClocks;
+
+	// two lookups and an add per sample
+	mixer.pulseBlip.read(intoBuffer, length, pulse_table, 30, false);
+	mixer.tndBlip.read(intoBuffer, length, tnd_table, 202, true);
+	if (bExpansion) {
+		mixer.expansionBlip.read(intoBuffer, length, nullptr, 16383, true);
 	}
 }
\ No newline at end of file
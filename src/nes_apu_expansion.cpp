@@ -0,0 +1,231 @@
+
+// Cart sound chips. Each renders into its own band limited buffer that the APU adds on top of its mix, register
+// writes arrive through the APU write queue so they are heard where they were made.
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+
+// clocks between timer events when a channel can't be heard, keeps the event loops from spinning on idle timers
+static const int32 IdleClock = 0x7FFFFFFF;
+
+// advances a timer through a span of clocks without output, returns the number of times it expired
+static int32 SkipExpansionTimer(int& timer, int32 period, int32 numClocks) {
+	if (timer >= numClocks) {
+		timer -= numClocks;
+		return 0;
+	}
+
+	const int32 expired = (numClocks - 1 - timer) / period + 1;
+	timer += expired * period - numClocks;
+	return expired;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// SUNSOFT 5B
+
+// 1.5 dB per envelope level, level 31 is about as loud as a full APU pulse
+static uint16 sunsoft5b_volume[32];
+
+static void Sunsoft5B_Reset() {
+	nes_apu_5b& chip = nesAPU.sunsoft5b;
+	memset(&chip, 0, sizeof(chip));
+	chip.noiseShift = 1;
+	chip.regs[7] = 0x3F;
+
+	float volume = 2400.0f;
+	for (int32 i = 31; i > 0; i--) {
+		sunsoft5b_volume[i] = uint16(volume);
+		volume *= 0.841395f;
+	}
+	sunsoft5b_volume[0] = 0;
+}
+
+static void Sunsoft5B_Write(unsigned int reg, uint8 value) {
+	nes_apu_5b& chip = nesAPU.sunsoft5b;
+	if (reg == 0) {
+		// $C000
+		chip.select = value & 0xF;
+		return;
+	}
+
+	// $E000
+	chip.regs[chip.select] = value;
+	if (chip.select == 13) {
+		// a new shape restarts the envelope
+		chip.envelopeStep = 0;
+		chip.envelopeTimer = 0;
+		chip.bEnvelopeFlip = false;
+		chip.bEnvelopeHeld = false;
+	}
+}
+
+// the 5B divides the CPU clock by 16 for the squares and envelope, by 32 for noise
+static FORCE_INLINE int32 Sunsoft5B_TonePeriod(const nes_apu_5b& chip, int32 channel) {
+	const int32 period = chip.regs[channel * 2] | ((chip.regs[channel * 2 + 1] & 0xF) << 8);
+	return (period ? period : 1) * 16;
+}
+
+static FORCE_INLINE int32 Sunsoft5B_NoisePeriod(const nes_apu_5b& chip) {
+	const int32 period = chip.regs[6] & 0x1F;
+	return (period ? period : 1) * 32;
+}
+
+static FORCE_INLINE int32 Sunsoft5B_EnvelopePeriod(const nes_apu_5b& chip) {
+	const int32 period = chip.regs[11] | (chip.regs[12] << 8);
+	return (period ? period : 1) * 16;
+}
+
+static FORCE_INLINE int32 Sunsoft5B_EnvelopeLevel(const nes_apu_5b& chip) {
+	if (chip.bEnvelopeHeld) {
+		return chip.envelopeHoldLevel;
+	}
+
+	const bool bRising = ((chip.regs[13] & 4) != 0) != chip.bEnvelopeFlip;
+	return bRising ? chip.envelopeStep : 31 - chip.envelopeStep;
+}
+
+static void Sunsoft5B_StepEnvelope(nes_apu_5b& chip) {
+	if (chip.bEnvelopeHeld || ++chip.envelopeStep < 32) {
+		return;
+	}
+
+	// end of a ramp, shape bits are continue, attack, alternate, hold
+	const uint8 shape = chip.regs[13];
+	const bool bRising = ((shape & 4) != 0) != chip.bEnvelopeFlip;
+	chip.envelopeStep = 0;
+	if ((shape & 8) == 0) {
+		chip.bEnvelopeHeld = true;
+		chip.envelopeHoldLevel = 0;
+	} else if (shape & 1) {
+		chip.bEnvelopeHeld = true;
+		chip.envelopeHoldLevel = (bRising ? 31 : 0) ^ ((shape & 2) ? 31 : 0);
+	} else if (shape & 2) {
+		chip.bEnvelopeFlip = !chip.bEnvelopeFlip;
+	}
+}
+
+// volume register level of a channel, 0-31 on the envelope scale
+static FORCE_INLINE int32 Sunsoft5B_Volume(const nes_apu_5b& chip, int32 channel, int32 envelopeLevel) {
+	const uint8 volume = chip.regs[8 + channel];
+	if (volume & 0x10) {
+		return envelopeLevel;
+	}
+	return (volume & 0xF) ? (volume & 0xF) * 2 + 1 : 0;
+}
+
+static FORCE_INLINE int32 Sunsoft5B_Level(const nes_apu_5b& chip, int32 channel, int32 envelopeLevel) {
+	// mixer bits disable tone and noise, a disabled source reads as high
+	const uint8 mixer = chip.regs[7];
+	const bool bTone = (mixer & (1 << channel)) || (chip.toneOutput & (1 << channel));
+	const bool bNoise = (mixer & (8 << channel)) || (chip.noiseShift & 1);
+	return (bTone && bNoise) ? sunsoft5b_volume[Sunsoft5B_Volume(chip, channel, envelopeLevel)] : 0;
+}
+
+static void Sunsoft5B_Render(nes_blip& blip, int32 fromClock, int32 toClock, uint32 channelMask) {
+	nes_apu_5b& chip = nesAPU.sunsoft5b;
+	const uint8 mixer = chip.regs[7];
+
+	// only sources some audible channel depends on get events, the rest just keep time
+	bool bToneActive[3];
+	bool bNoiseActive = false;
+	bool bEnvelopeActive = false;
+	for (int32 i = 0; i < 3; i++) {
+		const bool bAudible = (channelMask & (1 << i)) && ((mixer >> i) & 9) != 9 && (chip.regs[8 + i] & 0x1F);
+		bToneActive[i] = bAudible && (mixer & (1 << i)) == 0;
+		bNoiseActive |= bAudible && (mixer & (8 << i)) == 0;
+		bEnvelopeActive |= bAudible && (chip.regs[8 + i] & 0x10);
+	}
+
+	const int32 tonePeriod[3] = { Sunsoft5B_TonePeriod(chip, 0), Sunsoft5B_TonePeriod(chip, 1), Sunsoft5B_TonePeriod(chip, 2) };
+	const int32 noisePeriod = Sunsoft5B_NoisePeriod(chip);
+	const int32 envelopePeriod = Sunsoft5B_EnvelopePeriod(chip);
+	const bool bFastNoise = noisePeriod < blip.clocksPerSample;
+
+	int32 toneClock[3];
+	for (int32 i = 0; i < 3; i++) {
+		toneClock[i] = bToneActive[i] ? fromClock + chip.toneTimer[i] : IdleClock;
+	}
+	int32 noiseClock = bNoiseActive ? fromClock + chip.noiseTimer : IdleClock;
+	int32 envelopeClock = bEnvelopeActive ? fromClock + chip.envelopeTimer : IdleClock;
+
+	// register changes since the last call land at its start
+	int32 envelopeLevel = Sunsoft5B_EnvelopeLevel(chip);
+	int32 clock = fromClock;
+	bool bNoiseEvent = false;
+	for (;;) {
+		for (int32 i = 0; i < 3; i++) {
+			const int32 level = (channelMask & (1 << i)) ? Sunsoft5B_Level(chip, i, envelopeLevel) : 0;
+			if (level != chip.lastLevel[i]) {
+				if (bNoiseEvent && bFastNoise) {
+					blip.addFastDelta(clock, level - chip.lastLevel[i]);
+				} else {
+					blip.addDelta(clock, level - chip.lastLevel[i]);
+				}
+				chip.lastLevel[i] = level;
+			}
+		}
+
+		// next event
+		clock = toneClock[0];
+		if (toneClock[1] < clock) clock = toneClock[1];
+		if (toneClock[2] < clock) clock = toneClock[2];
+		if (noiseClock < clock) clock = noiseClock;
+		if (envelopeClock < clock) clock = envelopeClock;
+		if (clock >= toClock)
+			break;
+
+		for (int32 i = 0; i < 3; i++) {
+			if (toneClock[i] == clock) {
+				chip.toneOutput ^= 1 << i;
+				toneClock[i] += tonePeriod[i];
+			}
+		}
+
+		bNoiseEvent = noiseClock == clock;
+		if (bNoiseEvent) {
+			const int32 feedback = (chip.noiseShift ^ (chip.noiseShift >> 3)) & 1;
+			chip.noiseShift = (chip.noiseShift >> 1) | (feedback << 16);
+			noiseClock += noisePeriod;
+		}
+
+		if (envelopeClock == clock) {
+			Sunsoft5B_StepEnvelope(chip);
+			envelopeLevel = Sunsoft5B_EnvelopeLevel(chip);
+			envelopeClock += envelopePeriod;
+		}
+	}
+
+	// idle sources keep their phase
+	const int32 numClocks = toClock - fromClock;
+	for (int32 i = 0; i < 3; i++) {
+		if (bToneActive[i]) {
+			chip.toneTimer[i] = toneClock[i] - toClock;
+		} else if (SkipExpansionTimer(chip.toneTimer[i], tonePeriod[i], numClocks) & 1) {
+			chip.toneOutput ^= 1 << i;
+		}
+	}
+	if (bNoiseActive) {
+		chip.noiseTimer = noiseClock - toClock;
+	} else {
+		SkipExpansionTimer(chip.noiseTimer, noisePeriod, numClocks);
+	}
+	if (bEnvelopeActive) {
+		chip.envelopeTimer = envelopeClock - toClock;
+	} else {
+		// the envelope only moves when it is heard, close enough for how games use it
+		SkipExpansionTimer(chip.envelopeTimer, envelopePeriod, numClocks);
+	}
+}
+
+static int32 Sunsoft5B_LevelSum() {
+	const nes_apu_5b& chip = nesAPU.sunsoft5b;
+	return chip.lastLevel[0] + chip.lastLevel[1] + chip.lastLevel[2];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+const nes_apu_expansion apuExpansions[APU_EXP_COUNT] = {
+	{ "None", 0, nullptr, nullptr, nullptr, nullptr },
+	{ "Sunsoft 5B", 3, Sunsoft5B_Reset, Sunsoft5B_Write, Sunsoft5B_Render, Sunsoft5B_LevelSum },
+};
@@ -0,0 +1,532 @@
+// Host side batch runner for regression suites. Every task of a manifest runs headless on a machine of its own, spread
+// over all cores with a work stealing pool, and the results are written out as JSON
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+#include "frontend.h"
+
+#if TARGET_WINSIM
+
+#include <windows.h>
+
+// Manifest lines are "rom movie frames [hash=XXXXXXXX] [ram:AAAA=VV ...] [after=rom]", blank lines and anything after #
+// are ignored:
+//	rom		file in \\fls0\ as the frontend lists it
+//	movie	FCEUX text movie (.fm2) played from power on, or - to run without input
+//	frames	frames to run
+//	hash	expected hash of the last frame (nes_headless::frameHash), in hex
+//	ram		expected CPU memory after the last frame, address and value in hex (RAM, cart space from $5000)
+//	after	ROM loaded on the same machine first, the task's ROM replaces it and must map its own data (not the first
+//			one's resident image)
+
+#define BATCH_MAX_RAM_CHECKS 16
+#define BATCH_MAX_THREADS 64
+
+struct batch_ram_check {
+	uint16 address;
+	uint8 value;
+};
+
+struct batch_task {
+	char rom[128];
+	char previousROM[128];			// after=, empty if the task's ROM is the first one loaded
+	char movie[260];
+	int32 frames;
+	bool bCheckHash;
+	uint32 expectedHash;
+	int32 numRAMChecks;
+	batch_ram_check ramChecks[BATCH_MAX_RAM_CHECKS];
+
+	// results
+	bool bPassed;
+	char failure[128];
+	uint32 frameHash;
+	int32 fps;
+	int32 wallMs;
+	bool bResidentROM;				// banks mapped straight from the ROM image, the cache counts only cover patched copies
+	uint32 prgHits;
+	uint32 prgMisses;
+	uint32 chrHits;
+	uint32 chrMisses;
+};
+
+// per frame input, player 1's buttons in the low byte and player 2's in the next (both in NesKeys order)
+#define MOVIE_RESET (1 << 16)
+
+struct batch_movie {
+	uint32* frames;
+	int32 numFrames;
+};
+
+// a worker's share of the tasks. The owner takes from the back, idle workers steal from the front
+struct batch_queue {
+	CRITICAL_SECTION lock;
+	int32* tasks;
+	int32 head;
+	int32 tail;
+};
+
+static batch_task* batchTasks;
+static batch_queue batchQueues[BATCH_MAX_THREADS];
+static int32 numWorkers;
+
+// loading goes through the simulated file system and prints to the shared screen, so only one machine does it at a time
+static CRITICAL_SECTION loadLock;
+
+static bool ParseTask(char* line, int32 lineNumber, batch_task& task) {
+	memset(&task, 0, sizeof(batch_task));
+
+	const char* rom = strtok(line, " \t\r\n");
+	const char* movie = strtok(nullptr, " \t\r\n");
+	const char* frames = strtok(nullptr, " \t\r\n");
+	if (movie == nullptr || frames == nullptr || atoi(frames) <= 0 ||
+		strlen(rom) >= sizeof(task.rom) || strlen(movie) >= sizeof(task.movie)) {
+		OutputLog("Batch: line %d: expected a ROM, a movie and a frame count\n", lineNumber);
+		return false;
+	}
+	strcpy(task.rom, rom);
+	strcpy(task.movie, movie);
+	task.frames = atoi(frames);
+
+	while (const char* check = strtok(nullptr, " \t\r\n")) {
+		unsigned int address, value;
+		if (strncmp(check, "after=", 6) == 0 && check[6] && strlen(check + 6) < sizeof(task.previousROM)) {
+			strcpy(task.previousROM, check + 6);
+		} else if (sscanf(check, "hash=%x", &value) == 1) {
+			task.bCheckHash = true;
+			task.expectedHash = value;
+		} else if (sscanf(check, "ram:%x=%x", &address, &value) == 2 && task.numRAMChecks < BATCH_MAX_RAM_CHECKS &&
+			(address < 0x2000 || (address >= 0x5000 && address < 0x10000)) && value < 0x100) {
+			task.ramChecks[task.numRAMChecks].address = uint16(address);
+			task.ramChecks[task.numRAMChecks].value = uint8(value);
+			task.numRAMChecks++;
+		} else {
+			OutputLog("Batch: line %d: bad check '%s'\n", lineNumber, check);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static batch_task* LoadManifest(const char* manifestFile, int32& numTasks) {
+	numTasks = 0;
+
+	FILE* file = fopen(manifestFile, "r");
+	if (file == nullptr) {
+		OutputLog("Batch: could not open '%s'\n", manifestFile);
+		return nullptr;
+	}
+
+	batch_task* tasks = nullptr;
+	int32 maxTasks = 0;
+	int32 lineNumber = 0;
+	bool bValid = true;
+
+	char line[512];
+	while (fgets(line, sizeof(line), file)) {
+		lineNumber++;
+		if (char* comment = strchr(line, '#')) {
+			*comment = 0;
+		}
+		if (line[strspn(line, " \t\r\n")] == 0) {
+			continue;
+		}
+
+		if (numTasks == maxTasks) {
+			maxTasks = maxTasks ? maxTasks * 2 : 64;
+			tasks = (batch_task*) realloc(tasks, sizeof(batch_task) * maxTasks);
+		}
+		if (!ParseTask(line, lineNumber, tasks[numTasks])) {
+			bValid = false;
+			break;
+		}
+		numTasks++;
+	}
+	fclose(file);
+
+	if (!bValid || numTasks == 0) {
+		if (bValid) {
+			OutputLog("Batch: '%s' has no tasks\n", manifestFile);
+		}
+		free(tasks);
+		return nullptr;
+	}
+
+	return tasks;
+}
+
+static bool LoadMovie(const char* movieFile, batch_movie& movie, char* failure) {
+	movie.frames = nullptr;
+	movie.numFrames = 0;
+
+	FILE* file = fopen(movieFile, "r");
+	if (file == nullptr) {
+		strcpy(failure, "could not open the movie");
+		return false;
+	}
+
+	int32 maxFrames = 0;
+	char line[256];
+	while (fgets(line, sizeof(line), file)) {
+		if (line[0] != '|') {
+			// header lines, input is only ever read from the text log
+			if (strncmp(line, "binary 1", 8) == 0) {
+				strcpy(failure, "binary movies are not supported");
+				fclose(file);
+				free(movie.frames);
+				movie.frames = nullptr;
+				return false;
+			}
+			continue;
+		}
+
+		// |commands|port0|port1|port2|, gamepads as RLDUTSBA with anything but a space or . held
+		const char* field = line + 1;
+		uint32 input = (atoi(field) & 3) ? MOVIE_RESET : 0;
+		for (int32 port = 0; port < 2; port++) {
+			field = strchr(field, '|');
+			if (field == nullptr) {
+				break;
+			}
+			field++;
+
+			for (int32 i = 0; i < 8 && field[i] && field[i] != '|'; i++) {
+				if (field[i] != '.' && field[i] != ' ') {
+					input |= (0x80 >> i) << (port * 8);
+				}
+			}
+		}
+
+		if (movie.numFrames == maxFrames) {
+			maxFrames = maxFrames ? maxFrames * 2 : 4096;
+			movie.frames = (uint32*) realloc(movie.frames, sizeof(uint32) * maxFrames);
+		}
+		movie.frames[movie.numFrames++] = input;
+	}
+
+	fclose(file);
+	return true;
+}
+
+static void ApplyMovieInput(uint32 input) {
+	for (int32 button = 0; button < 8; button++) {
+		nesMachine.isDown[NES_P1_A + button] = (input >> button) & 1;
+		nesMachine.isDown[NES_P2_A + button] = (input >> (button + 8)) & 1;
+	}
+}
+
+static int32 ElapsedMs(const LARGE_INTEGER& startTime, const LARGE_INTEGER& endTime) {
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	return int32((endTime.QuadPart - startTime.QuadPart) * 1000 / frequency.QuadPart);
+}
+
+// runs the current machine through the task, the ROM is loaded
+static void RunLoadedTask(batch_task& task, const batch_movie& movie) {
+	// the movie's keys stand in for the keyboard, and nothing is drawn except the hashed last frame
+	nesPPU.bExternalInput = true;
+	nesHeadless.start();
+
+	LARGE_INTEGER startTime, endTime;
+	QueryPerformanceCounter(&startTime);
+
+	for (int32 frame = 0; frame < task.frames; frame++) {
+		const uint32 input = frame < movie.numFrames ? movie.frames[frame] : 0;
+		if (input & MOVIE_RESET) {
+			mainCPU.reset();
+		}
+		ApplyMovieInput(input);
+
+		if (frame == task.frames - 1) {
+			nesHeadless.requestFrameHash();
+		}
+		nesFrontend.RunFrame();
+
+		// left to the caller with external input
+		mainCPU.syncClocks();
+	}
+
+	QueryPerformanceCounter(&endTime);
+	const int32 ms = ElapsedMs(startTime, endTime);
+	task.fps = ms ? int32((long long) task.frames * 1000 / ms) : 0;
+
+	task.frameHash = nesHeadless.frameHash;
+	task.bResidentROM = nesCart.romImage != nullptr;
+	task.prgHits = nesCart.prgCache.hits;
+	task.prgMisses = nesCart.prgCache.misses;
+	task.chrHits = nesCart.chrCache.hits;
+	task.chrMisses = nesCart.chrCache.misses;
+
+	task.bPassed = true;
+	if (task.bCheckHash && task.frameHash != task.expectedHash) {
+		sprintf(task.failure, "frame hash %08X, expected %08X", task.frameHash, task.expectedHash);
+		task.bPassed = false;
+		return;
+	}
+	for (int32 i = 0; i < task.numRAMChecks; i++) {
+		const batch_ram_check& check = task.ramChecks[i];
+		const uint8 value = mainCPU.readNonIO(check.address);
+		if (value != check.value) {
+			sprintf(task.failure, "$%04X is %02X, expected %02X", check.address, value, check.value);
+			task.bPassed = false;
+			return;
+		}
+	}
+}
+
+// loads a ROM from \\fls0\ onto the current machine, a resident image has to match the file read through its own blocks.
+// Called with loadLock held, which also covers the compare buffer
+static bool LoadTaskROM(const char* rom, char* failure) {
+	char romFile[160];
+	sprintf(romFile, "\\\\fls0\\%s", rom);
+
+	nesPPU.init();
+	if (!nesCart.loadROM(romFile)) {
+		sprintf(failure, "could not load %s", rom);
+		return false;
+	}
+	mainCPU.reset();
+
+	if (nesCart.romImage) {
+		static unsigned char bank[8192];
+		const int romSize = 16384 * nesCart.numPRGBanks + 8192 * nesCart.numCHRBanks;
+		for (int offset = 0; offset < romSize; offset += 8192) {
+			nesCart.ReadROM(bank, 8192, 16 + offset);
+			if (memcmp(bank, nesCart.romImage + 16 + offset, 8192)) {
+				sprintf(failure, "resident image of %s differs at $%X", rom, offset);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static void RunTask(batch_task& task) {
+	LARGE_INTEGER startTime, endTime;
+	QueryPerformanceCounter(&startTime);
+
+	batch_movie movie = { nullptr, 0 };
+	if (strcmp(task.movie, "-") == 0 || LoadMovie(task.movie, movie, task.failure)) {
+		nes_machine* machine = new nes_machine;
+		unsigned char* staticBanks = (unsigned char*) malloc(STATIC_CACHED_ROM_BANKS * 8192);
+
+		if (machine && staticBanks) {
+			// the worker goes back to its previous machine before this one is deleted
+			nes_machine* const previousMachine = nesCurrentMachine;
+			machine->makeCurrent();
+			nesCart.allocateBanks(staticBanks);
+
+			EnterCriticalSection(&loadLock);
+			bool bLoaded = task.previousROM[0] == 0 || LoadTaskROM(task.previousROM, task.failure);
+			bLoaded = bLoaded && LoadTaskROM(task.rom, task.failure);
+			LeaveCriticalSection(&loadLock);
+
+			if (bLoaded) {
+				RunLoadedTask(task, movie);
+			}
+
+			EnterCriticalSection(&loadLock);
+			nesCart.unload();
+			LeaveCriticalSection(&loadLock);
+
+			nesCart.releaseBanks();
+			nesCheats.clear();
+			previousMachine->makeCurrent();
+		} else {
+			strcpy(task.failure, "out of memory");
+		}
+
+		free(staticBanks);
+		delete machine;
+		free(movie.frames);
+	}
+
+	QueryPerformanceCounter(&endTime);
+	task.wallMs = ElapsedMs(startTime, endTime);
+}
+
+static int32 PopTask(int32 worker) {
+	batch_queue& queue = batchQueues[worker];
+	int32 task = -1;
+
+	EnterCriticalSection(&queue.lock);
+	if (queue.tail > queue.head) {
+		task = queue.tasks[--queue.tail];
+	}
+	LeaveCriticalSection(&queue.lock);
+
+	return task;
+}
+
+static int32 StealTask(int32 worker) {
+	for (int32 i = 1; i < numWorkers; i++) {
+		batch_queue& victim = batchQueues[(worker + i) % numWorkers];
+		int32 task = -1;
+
+		EnterCriticalSection(&victim.lock);
+		if (victim.tail > victim.head) {
+			task = victim.tasks[victim.head++];
+		}
+		LeaveCriticalSection(&victim.lock);
+
+		if (task != -1) {
+			return task;
+		}
+	}
+
+	return -1;
+}
+
+static DWORD WINAPI BatchWorkerProc(LPVOID param) {
+	const int32 worker = int32((size_t) param);
+
+	// tasks are all queued before the workers start, so once nothing is left to steal the run is over
+	for (;;) {
+		int32 task = PopTask(worker);
+		if (task == -1) {
+			task = StealTask(worker);
+		}
+		if (task == -1) {
+			break;
+		}
+
+		RunTask(batchTasks[task]);
+	}
+
+	return 0;
+}
+
+static void WriteJSONString(FILE* file, const char* text) {
+	fputc('"', file);
+	for (; *text; text++) {
+		if ((unsigned char) *text < 0x20) {
+			// control characters (a tab or newline in a path or failure) aren't allowed raw in a JSON string
+			fprintf(file, "\\u%04X", (unsigned char) *text);
+			continue;
+		}
+		if (*text == '"' || *text == '\\') {
+			fputc('\\', file);
+		}
+		fputc(*text, file);
+	}
+	fputc('"', file);
+}
+
+static bool WriteResults(const char* resultsFile, int32 numTasks, int32 numPassed, int32 wallMs) {
+	FILE* file = fopen(resultsFile, "w");
+	if (file == nullptr) {
+		OutputLog("Batch: could not create '%s'\n", resultsFile);
+		return false;
+	}
+
+	fprintf(file, "{\n\t\"tasks\": %d,\n\t\"passed\": %d,\n\t\"failed\": %d,\n\t\"threads\": %d,\n\t\"wallMs\": %d,\n",
+		numTasks, numPassed, numTasks - numPassed, numWorkers, wallMs);
+	fprintf(file, "\t\"results\": [\n");
+
+	for (int32 i = 0; i < numTasks; i++) {
+		const batch_task& task = batchTasks[i];
+		fprintf(file, "\t\t{ \"rom\": ");
+		WriteJSONString(file, task.rom);
+		fprintf(file, ", \"movie\": ");
+		WriteJSONString(file, task.movie);
+		fprintf(file, ", \"frames\": %d, \"pass\": %s, \"failure\": ", task.frames, task.bPassed ? "true" : "false");
+		WriteJSONString(file, task.failure);
+		fprintf(file, ", \"frameHash\": \"%08X\", \"fps\": %d, \"wallMs\": %d,", task.frameHash, task.fps, task.wallMs);
+
+		// with a resident ROM the cache counts only cover the patched copies, residentROM says which
+		fprintf(file, " \"residentROM\": %s, \"prgHits\": %u, \"prgMisses\": %u, \"chrHits\": %u, \"chrMisses\": %u }%s\n",
+			task.bResidentROM ? "true" : "false", task.prgHits, task.prgMisses, task.chrHits, task.chrMisses,
+			i + 1 < numTasks ? "," : "");
+	}
+
+	fprintf(file, "\t]\n}\n");
+	fclose(file);
+	return true;
+}
+
+bool RunBatch(const char* manifestFile, const char* resultsFile) {
+	int32 numTasks;
+	batchTasks = LoadManifest(manifestFile, numTasks);
+	if (batchTasks == nullptr) {
+		return false;
+	}
+
+	char defaultResultsFile[300];
+	if (resultsFile == nullptr) {
+		if (strlen(manifestFile) + 6 > sizeof(defaultResultsFile)) {
+			OutputLog("Batch: manifest path is too long\n");
+			free(batchTasks);
+			return false;
+		}
+		sprintf(defaultResultsFile, "%s.json", manifestFile);
+		resultsFile = defaultResultsFile;
+	}
+
+	SYSTEM_INFO systemInfo;
+	GetSystemInfo(&systemInfo);
+	numWorkers = int32(systemInfo.dwNumberOfProcessors);
+	if (numWorkers > BATCH_MAX_THREADS) numWorkers = BATCH_MAX_THREADS;
+	if (numWorkers > numTasks) numWorkers = numTasks;
+	if (numWorkers < 1) numWorkers = 1;
+
+	// opcode tables are shared by every machine
+	cpu6502_Init();
+
+	// each worker starts with an even run of the manifest
+	int32* order = (int32*) malloc(sizeof(int32) * numTasks);
+	for (int32 i = 0; i < numTasks; i++) {
+		order[i] = i;
+	}
+	for (int32 i = 0; i < numWorkers; i++) {
+		batch_queue& queue = batchQueues[i];
+		InitializeCriticalSection(&queue.lock);
+		queue.tasks = order;
+		queue.head = numTasks * i / numWorkers;
+		queue.tail = numTasks * (i + 1) / numWorkers;
+	}
+	InitializeCriticalSection(&loadLock);
+
+	OutputLog("Batch: %d tasks on %d threads\n", numTasks, numWorkers);
+
+	LARGE_INTEGER startTime, endTime;
+	QueryPerformanceCounter(&startTime);
+
+	HANDLE threads[BATCH_MAX_THREADS];
+	for (int32 i = 0; i < numWorkers; i++) {
+		threads[i] = CreateThread(NULL, 0, BatchWorkerProc, (LPVOID) (size_t) i, 0, NULL);
+	}
+	for (int32 i = 0; i < numWorkers; i++) {
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+	}
+
+	QueryPerformanceCounter(&endTime);
+	const int32 wallMs = ElapsedMs(startTime, endTime);
+
+	DeleteCriticalSection(&loadLock);
+	for (int32 i = 0; i < numWorkers; i++) {
+		DeleteCriticalSection(&batchQueues[i].lock);
+	}
+	free(order);
+
+	int32 numPassed = 0;
+	for (int32 i = 0; i < numTasks; i++) {
+		if (batchTasks[i].bPassed) {
+			numPassed++;
+		} else {
+			OutputLog("Batch: FAIL %s: %s\n", batchTasks[i].rom, batchTasks[i].failure);
+		}
+	}
+	OutputLog("Batch: %d of %d passed in %d ms\n", numPassed, numTasks, wallMs);
+
+	const bool bWritten = WriteResults(resultsFile, numTasks, numPassed, wallMs);
+	free(batchTasks);
+	batchTasks = nullptr;
+
+	return bWritten && numPassed == numTasks;
+}
+
+#endif
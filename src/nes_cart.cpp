@@ -8,33 +8,14 @@
 #include "scope_timer/scope_timer.h"
 #include "snd/snd.h"
 #include "settings.h"
-
-nes_cart nesCart;
-
-nes_nametable nes_onboardPPUTables[4];
-
-unsigned char openBus[256] = {
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
-};
+#include "zx7/zx7.h"
 
 nes_cart::nes_cart() : writeSpecial(NULL) {
 	handle = 0;
 	romFile[0] = 0;
+	mapperInterface = nullptr;
+	romImage = nullptr;
+	romImageAlloc = nullptr;
 }
 
 void nes_cart::allocateBanks(unsigned char* staticAlloced) {
@@ -54,8 +35,19 @@ void nes_cart::allocateBanks(unsigned char* staticAlloced) {
 	}
 }
 
+void nes_cart::releaseBanks() {
+	for (int i = STATIC_CACHED_ROM_BANKS; i < MAX_CACHED_ROM_BANKS; i++) {
+		if (cache[i].ptr) {
+			free(cache[i].ptr);
+			cache[i].ptr = nullptr;
+		}
+	}
+	allocatedROMBanks = 0;
+}
+
 bool nes_cart::loadROM(const char* withFile) {
-	DebugAssert(handle <= 0);
+	// the resident image and file handle of whatever was loaded before belong to that file
+	unload();
 
 	printf("Loading %s...", withFile);
 
@@ -77,6 +69,18 @@ bool nes_cart::loadROM(const char* withFile) {
 		Bfile_CloseFile_OS(file);
 		return false;
 	}
+
+	// packed container, the iNES header and original file size follow the container header
+	isCompressed = !memcmp(header, "NESZ", 4);
+	if (isCompressed) {
+		unsigned char sizeBytes[4];
+		if (header[4] != PACKED_ROM_VERSION || Bfile_ReadFile_OS(file, header, 16, 8) != 16 || Bfile_ReadFile_OS(file, sizeBytes, 4, -1) != 4) {
+			printf("Unsupported .nesz version.");
+			Bfile_CloseFile_OS(file);
+			return false;
+		}
+		fileSize = (sizeBytes[0] << 24) | (sizeBytes[1] << 16) | (sizeBytes[2] << 8) | sizeBytes[3];
+	}
 	
 	int expectedSize = 16;	// starting with header size
 
@@ -195,7 +199,7 @@ bool nes_cart::loadROM(const char* withFile) {
 	printf("%s, %d RAM banks", isPAL ? "PAL" : "NTSC", numRAMBanks);
 
 	// expected size?
-	if (Bfile_GetFileSize_OS(file) != expectedSize) {
+	if (fileSize != expectedSize) {
 		printf("Not expected file size based on format, will attempt to pad!");
 	}
 
@@ -208,9 +212,7 @@ bool nes_cart::loadROM(const char* withFile) {
 		}
 
 		if (isBatteryBacked && numRAMBanks == 1) {
-			strcpy(savFile, withFile);
-			*strrchr(savFile, '.') = 0;
-			strcat(savFile, ".sav");
+			GetSaveFileName(withFile, ".sav", savFile);
 			Bfile_StrToName_ncpy(romName, savFile, 255);
 
 			// try to load file
@@ -234,11 +236,25 @@ bool nes_cart::loadROM(const char* withFile) {
 	nesAPU.init();
 
 	// load game genie codes file if user supplied one
-	GameGenieCode::load(withFile);
+	nesCheats.load(withFile);
+
+	// rewind history is per cart
+	nesRewind.clear();
+
+#if TARGET_WINSIM
+	nesRunAhead.load(withFile);
+#endif
+
+	// warm start bank prefetching with what was learned last time
+	prefetcher.reset();
+	LoadPrefetchStats(withFile);
 
 	// mapper logic
 	handle = file;
 	if (setupMapper()) {
+		// mapper may have installed a render latch
+		nesPPU.updateRenderScanline();
+
 		strcpy(romFile, withFile);
 		printf("Mapper %d : supported", mapper);
 		return true;
@@ -264,11 +280,23 @@ uint8* nes_cart::GetWRAM() {
 	}
 }
 
+void nes_cart::GetSaveFileName(const char* withFile, const char* extension, char* intoFile) {
+	strcpy(intoFile, withFile);
+	strcpy(strrchr(intoFile, '.'), extension);
+}
+
 void nes_cart::unload() {
-	if (handle) {
+	if (handle > 0) {
 		Bfile_CloseFile_OS(handle);
 		handle = 0;
 	}
+
+	romImage = nullptr;
+	if (romImageAlloc) {
+		free(romImageAlloc);
+		romImageAlloc = nullptr;
+	}
+	isCompressed = 0;
 }
 
 uint32 nes_cart::GetRAMHash() {
@@ -302,6 +330,9 @@ void nes_cart::OnPause() {
 		}
 	}
 
+	SavePrefetchStats();
+	prefetcher.report();
+
 	// close rom handle for now (will re open on continue)
 	Bfile_CloseFile_OS(handle);
 	handle = 0;
@@ -312,19 +343,65 @@ void nes_cart::OnContinue() {
 	unsigned short filename[128];
 	Bfile_StrToName_ncpy(filename, romFile, 127);
 	handle = Bfile_OpenFile_OS(filename, READ, 0);
-	BuildFileBlocks();
+	RebuildFileBlocks();
 
 	// reset frame skip value
 	nesPPU.autoFrameSkip = 0;
 }
 
+// every supported mapper, see mappers.h
+static const nes_mapper* const nesMappers[] = {
+	&Mapper0_NROM,
+	&Mapper1_MMC1,
+	&Mapper2_UNROM,
+	&Mapper3_CNROM,
+	&Mapper4_MMC3,
+	&Mapper7_AOROM,
+	&Mapper9_MMC2,
+	&Mapper11_ColorDreams,
+	&Mapper34_BNROM,
+	&Mapper38_BitCorp,
+	&Mapper64_Rambo1,
+	&Mapper66_GXROM,
+	&Mapper67_Sunsoft3,
+	&Mapper68_Sunsoft4,
+	&Mapper69_Sunsoft,
+	&Mapper70_Bandai,
+	&Mapper71_Camerica,
+	&Mapper79_AVE,
+	&Mapper93_Sunsoft2,
+	&Mapper94_UN1ROM,
+	&Mapper101_JF10,
+	&Mapper107_MagicDragon,
+	&Mapper133_Sachen3009,
+	&Mapper140_JF11,
+	&Mapper145_SA72007,
+	&Mapper148_SA0037,
+	&Mapper149_SA0036,
+	&Mapper152_Bandai,
+	&Mapper163_Nanjing,
+	&Mapper180_UNROM,
+	&Mapper240,
+	&Mapper241,
+};
+
+static const nes_mapper* FindMapper(int number) {
+	for (unsigned int i = 0; i < sizeof(nesMappers) / sizeof(nesMappers[0]); i++) {
+		if (nesMappers[i]->number == number || nesMappers[i]->aliasNumber == number) {
+			return nesMappers[i];
+		}
+	}
+
+	return nullptr;
+}
+
 bool nes_cart::setupMapper() {
 	renderLatch = NULL;
 	writeSpecial = NULL;
 	bSwapChrPages = false;
 
 	// most mirror configs just use the on board ppu nametables:
-	nesPPU.nameTables = nes_onboardPPUTables;
+	nesPPU.nameTables = nesMachine.onboardPPUTables;
 
 	clearCacheData();
 
@@ -337,82 +414,176 @@ bool nes_cart::setupMapper() {
 		return false;
 	}
 
+	if (romImage) {
+		printf("ROM resident, banks mapped in place");
+	}
+
+	// patch lists are per PRG bank, so they need the ROM before anything is mapped
+	nesCheats.buildPatches(*this);
+
 	// by default map 0x5000 - 0x7FFF to open bus to start
 	mainCPU.setMapOpenBusKB(0x50, 12);
 
-	switch (mapper) {
-		case 0:
-			setupMapper0_NROM();
-			return true;
-		case 1:
-			setupMapper1_MMC1();
-			return true;
-		case 2:
-			setupMapper2_UNROM();
-			return true;
-		case 3:
-			setupMapper3_CNROM();
-			return true;
-		case 4:
-			setupMapper4_MMC3();
-			return true;
-		case 7:
-			setupMapper7_AOROM();
-			return true;
-		case 9:
-		case 10:
-			setupMapper9_MMC2();
-			return true;
-		case 11:
-			setupMapper11_ColorDreams();
-			return true;
-		case 34:
-			setupMapper34_BNROM();
-			return true;
-		case 64:
-			setupMapper64_Rambo1();
-			return true;
-		case 66:
-		case 140:
-			setupMapper66_GXROM();
-			return true;
-		case 67:
-			setupMapper67_Sunsoft3();
-			return true;
-		case 68:
-			setupMapper68_Sunsoft4();
-			return true;
-		case 69:
-			setupMapper69_Sunsoft();
-			return true;
-		case 71:
-			setupMapper71_Camerica();
-			return true;
-		case 79:
-			setupMapper79_AVE();
-			return true;
-		case 163:
-			setupMapper163_Nanjing();
-			return true;
-		default:
-			return false;
+	mapperInterface = FindMapper(mapper);
+	if (mapperInterface == nullptr) {
+		return false;
 	}
+
+	writeSpecial = mapperInterface->write;
+	scanlineClock = mapperInterface->scanline;
+	renderLatch = mapperInterface->chrLatch;
+	(this->*mapperInterface->setup)();
+	return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Caching support
 
 bool nes_cart::BuildFileBlocks() {
-	int numBlocks = (Bfile_GetFileSize_OS(handle) + 4095) / 4096; 
+	const int fileSize = Bfile_GetFileSize_OS(handle);
+	int numBlocks = (fileSize + 4095) / 4096; 
 	for (int i = 0; i < numBlocks; i++) {
 		int ret = Bfile_GetBlockAddress(handle, i * 0x1000, &blocks[i]);
 		if (ret < 0)
 			// error!
 			return false;
 	}
+
+	romImage = nullptr;
+	const int romSize = 16 + 16384 * numPRGBanks + 8192 * numCHRBanks;
+	if (isCompressed) {
+		if (!ValidatePackedIndex(fileSize)) {
+			printf("Packed ROM index is corrupt");
+			return false;
+		}
+
+#if TARGET_WINSIM
+		// unpack everything once on the host, banks are then mapped in place from the unpacked image
+		if (romImageAlloc == nullptr) {
+			romImageAlloc = (unsigned char*) malloc(romSize);
+			if (romImageAlloc) {
+				// the original iNES header follows the container header
+				BlockRead(romImageAlloc, 16, 8);
+				ReadROM(romImageAlloc + 16, romSize - 16, 16);
+			}
+		}
+		romImage = romImageAlloc;
+#endif
+		return true;
+	}
+
+	// the whole ROM can only be mapped in place if nothing needs padding
+	if (fileSize < romSize) {
+		return true;
+	}
+
+#if TARGET_WINSIM
+	// the host has the memory to keep the whole file resident, which stands in for mapping it
+	if (romImageAlloc == nullptr) {
+		romImageAlloc = (unsigned char*) malloc(fileSize);
+		if (romImageAlloc && Bfile_ReadFile_OS(handle, romImageAlloc, fileSize, 0) != fileSize) {
+			free(romImageAlloc);
+			romImageAlloc = nullptr;
+		}
+	}
+	romImage = romImageAlloc;
+#else
+	// resident when the file system handed out the file as one contiguous run of blocks
+	romImage = blocks[0];
+	for (int i = 1; i < numBlocks; i++) {
+		if (blocks[i] != blocks[0] + 0x1000 * i) {
+			romImage = nullptr;
+			break;
+		}
+	}
+#endif
+
+	return true;
+}
+
+void nes_cart::RebuildFileBlocks() {
+	const unsigned char* oldImage = romImage;
+	BuildFileBlocks();
+
+	// resident banks point into the old image, so map everything again if it moved
+	if (romImage != oldImage) {
+		FlushCache();
+		if (numCHRBanks) {
+			CommitChrBanks();
+		}
+	}
+}
+
+bool nes_cart::ValidatePackedIndex(int fileSize) {
+	const int numUnits = numPRGBanks * 4 + numCHRBanks * 8;
+	if (fileSize < PACKED_ROM_INDEX + PACKED_ROM_ENTRY * numUnits) {
+		return false;
+	}
+
+	// every unit has to sit inside one file block for UnpackUnit
+	for (int i = 0; i < numUnits; i++) {
+		unsigned char entry[PACKED_ROM_ENTRY];
+		BlockRead(entry, PACKED_ROM_ENTRY, PACKED_ROM_INDEX + PACKED_ROM_ENTRY * i);
+		const int offset = (entry[0] << 24) | (entry[1] << 16) | (entry[2] << 8) | entry[3];
+		const int size = (entry[4] << 8) | entry[5];
+		const int unitSize = i < numPRGBanks * 4 ? PACKED_PRG_UNIT : PACKED_CHR_UNIT;
+		if (size == 0 || size > unitSize || offset + size > fileSize || (offset & 0xFFF) + size > 0x1000) {
+			return false;
+		}
+	}
+
 	return true;
 }
 
+void nes_cart::UnpackUnit(unsigned char* intoMem, int unit, int unitSize) {
+	TIME_SCOPE_NAMED(rom_unpack);
+
+	unsigned char entry[PACKED_ROM_ENTRY];
+	BlockRead(entry, PACKED_ROM_ENTRY, PACKED_ROM_INDEX + PACKED_ROM_ENTRY * unit);
+	const int offset = (entry[0] << 24) | (entry[1] << 16) | (entry[2] << 8) | entry[3];
+	const int size = (entry[4] << 8) | entry[5];
+	DebugAssert((offset & 0xFFF) + size <= 0x1000);
+
+	// units that didn't compress are stored as is
+	const unsigned char* src = blocks[offset >> 12] + (offset & 0xFFF);
+	if (size == unitSize) {
+		memcpy(intoMem, src, unitSize);
+	} else {
+		ZX7Decompress(src, intoMem, unitSize);
+	}
+
+	COUNT_SCOPE_NAMED(rom_unpack_bytes, size);
+#if !APU_AUDIO_THREAD
+	condSoundUpdate();
+#endif
+}
+
+void nes_cart::ReadROM(unsigned char* intoMem, int size, int offset) {
+	if (!isCompressed) {
+		BlockRead(intoMem, size, offset);
+		return;
+	}
+
+	// iNES file offset to unit, reads are always whole 8 KB PRG banks or 1 KB CHR pages
+	const int prgSize = 16384 * numPRGBanks;
+	int romOffset = offset - 16;
+	int unit;
+	int unitSize;
+	if (romOffset < prgSize) {
+		unitSize = PACKED_PRG_UNIT;
+		unit = romOffset / PACKED_PRG_UNIT;
+	} else {
+		unitSize = PACKED_CHR_UNIT;
+		unit = numPRGBanks * 4 + (romOffset - prgSize) / PACKED_CHR_UNIT;
+	}
+	DebugAssert(romOffset % unitSize == 0 && size % unitSize == 0);
+
+	for (; size > 0; size -= unitSize) {
+		UnpackUnit(intoMem, unit++, unitSize);
+		intoMem += unitSize;
+	}
+}
+
 void nes_cart::BlockRead(unsigned char* intoMem, int size, int offset) {
 	TIME_SCOPE()
 
@@ -429,127 +600,275 @@ void nes_cart::BlockRead(unsigned char* intoMem, int size, int offset) {
 		size -= toRead;
 		offset += toRead;
 
+#if !APU_AUDIO_THREAD
 		condSoundUpdate();
+#endif
 	}
 }
 
-void nes_cart::clearCacheData() {
-	requestIndex = 0;
-	
-	for (int i = 0; i < availableROMBanks; i++) {
-		cache[i].clear();
+void nes_bank_cache::reset(nes_cached_bank* withEntries, int withCount) {
+	entries = withEntries;
+	count = withCount;
+	mru = -1;
+	lru = -1;
+
+	for (int i = 0; i < BANK_CACHE_HASH_SIZE; i++) {
+		hash[i] = -1;
 	}
 
-	cachedBankCount = 0;
+	for (int i = 0; i < count; i++) {
+		entries[i].key = -1;
+		entries[i].hashNext = -1;
+		entries[i].pinCount = 0;
+		entries[i].bPrefetched = false;
+		entries[i].useFrame = 0;
+		linkFront(i);
+	}
 }
 
-// returns whether the bank given is in use by the memory map
-bool nes_cart::isBankUsed(int index) {
-	unsigned char* ptr = cache[index].ptr;
+int nes_bank_cache::find(int32 key) {
+	for (int i = hash[key & (BANK_CACHE_HASH_SIZE - 1)]; i != -1; i = entries[i].hashNext) {
+		if (entries[i].key == key) {
+			// pinned entries aren't in the list, they are touched when unpinned
+			if (entries[i].pinCount == 0 && i != mru) {
+				unlink(i);
+				linkFront(i);
+			}
+			return i;
+		}
+	}
 
-	if (ptr == nesPPU.chrPages[0] || ptr == nesPPU.chrPages[1] || ptr + 0x1000 == nesPPU.chrPages[0] || ptr + 0x1000 == nesPPU.chrPages[1])
-		return true;
+	return -1;
+}
 
-	for (int i = 0; i < 4 + isLowPRGROM; i++) {
-		if (programBanks[i] == cache[index].prgIndex) {
-			return true;
+int nes_bank_cache::peek(int32 key) const {
+	for (int i = hash[key & (BANK_CACHE_HASH_SIZE - 1)]; i != -1; i = entries[i].hashNext) {
+		if (entries[i].key == key) {
+			return i;
 		}
 	}
 
-	return false;
+	return -1;
+}
+
+int nes_bank_cache::evict(int32 key, int32& evictedKey) {
+	// if we have enough caching set up... this shouldn't happen
+	DebugAssert(lru != -1);
+
+	const int i = lru;
+	evictedKey = entries[i].key;
+	if (evictedKey != -1) {
+		hashRemove(i);
+	}
+
+	nes_cached_bank& entry = entries[i];
+	entry.key = key;
+	entry.bPrefetched = false;
+	entry.hashNext = hash[key & (BANK_CACHE_HASH_SIZE - 1)];
+	hash[key & (BANK_CACHE_HASH_SIZE - 1)] = i;
+
+	unlink(i);
+	linkFront(i);
+	return i;
+}
+
+void nes_bank_cache::rekey(int index, int32 key) {
+	nes_cached_bank& entry = entries[index];
+	if (entry.key != -1) {
+		hashRemove(index);
+	}
+
+	entry.key = key;
+	if (key != -1) {
+		entry.hashNext = hash[key & (BANK_CACHE_HASH_SIZE - 1)];
+		hash[key & (BANK_CACHE_HASH_SIZE - 1)] = index;
+	}
+}
+
+void nes_bank_cache::pin(int index) {
+	if (entries[index].pinCount++ == 0) {
+		unlink(index);
+	}
+}
+
+void nes_bank_cache::unpin(int index) {
+	DebugAssert(entries[index].pinCount);
+	if (--entries[index].pinCount == 0) {
+		linkFront(index);
+	}
+}
+
+void nes_bank_cache::unlink(int index) {
+	nes_cached_bank& entry = entries[index];
+	if (entry.prev != -1) {
+		entries[entry.prev].next = entry.next;
+	} else {
+		mru = entry.next;
+	}
+	if (entry.next != -1) {
+		entries[entry.next].prev = entry.prev;
+	} else {
+		lru = entry.prev;
+	}
+	entry.prev = -1;
+	entry.next = -1;
+}
+
+void nes_bank_cache::linkFront(int index) {
+	nes_cached_bank& entry = entries[index];
+	entry.prev = -1;
+	entry.next = mru;
+	if (mru != -1) {
+		entries[mru].prev = index;
+	} else {
+		lru = index;
+	}
+	mru = index;
+}
+
+void nes_bank_cache::hashRemove(int index) {
+	int16* link = &hash[entries[index].key & (BANK_CACHE_HASH_SIZE - 1)];
+	while (*link != index) {
+		DebugAssert(*link != -1);
+		link = &entries[*link].hashNext;
+	}
+	*link = entries[index].hashNext;
+	entries[index].hashNext = -1;
+}
+
+void nes_cart::clearCacheData() {
+	cachedBankCount = 0;
+
+	// PRG cache range is only known after mapper setup sets cachedBankCount, built on first use
+	prgCache.count = 0;
+	memset(programBankEntries, 0xFF, sizeof(programBankEntries));
+
+	// CHR ROM is cached in 1 KB pages carved out of the first cached banks
+	chrCacheBanks = numCHRBanks < CHR_CACHE_BANKS ? numCHRBanks : CHR_CACHE_BANKS;
+	for (int i = 0; i < chrCacheBanks * 8; i++) {
+		chrCachePages[i].ptr = cache[i >> 3].ptr + 0x400 * (i & 7);
+	}
+	chrCache.reset(chrCachePages, chrCacheBanks * 8);
+	memset(chrPageEntries, 0xFF, sizeof(chrPageEntries));
+}
+
+void nes_cart::resetPRGCache() {
+	DebugAssert(cachedBankCount > chrCacheBanks);
+	prgCache.reset(&cache[chrCacheBanks], cachedBankCount - chrCacheBanks);
 }
 
 // finds least recently requested bank that is currently unused
 int nes_cart::findOldestUnusedBank() {
-	int bestBank = -1;
-	for (int i = 0; i < cachedBankCount; i++) {
-		if (bestBank == -1 || cache[i].request < cache[bestBank].request) {
-			if (isBankUsed(i) == false) {
-				bestBank = i;
-			} else {
-				// mark as "requested" since it obviously is still in use
-				cache[i].request = requestIndex;
-			}
-		}
+	if (prgCache.count == 0) {
+		resetPRGCache();
 	}
 
-	// if we have enough caching set up... this shouldn't happen
-	DebugAssert(bestBank != -1);
-	return bestBank;
+	DebugAssert(prgCache.oldest() != -1);
+	return chrCacheBanks + prgCache.oldest();
 }
 
-// caches an 8 KB PRG bank (so index up to 2 * numPRGBanks), returns result bank memory pointer
-unsigned char* nes_cart::cachePRGBank(int index) {
+// caches an 8 KB PRG bank (so index up to 2 * numPRGBanks), returns prgCache entry
+int nes_cart::cachePRGBank(int index, int patchWindow) {
 	DebugAssert(index < numPRGBanks * 2);
 
-	requestIndex++;
+	if (prgCache.count == 0) {
+		resetPRGCache();
+	}
 
-	// find bank index within range:
-	for (int i = 0; i < cachedBankCount; i++) {
-		if (cache[i].prgIndex == index) {
-			cache[i].request = requestIndex;
-			return cache[i].ptr;
-		}
+	// patched copies are keyed past the bank range, one key space per window, and are left out of the prefetcher
+	// which only knows bank indices
+	const int32 key = patchWindow < 0 ? index : index + (patchWindow + 1) * numPRGBanks * 2;
+	if (patchWindow < 0) {
+		prefetcher.train(false, index);
 	}
 
-	// replace smallest request with inactive memory
-	int replaceIndex = findOldestUnusedBank();
-	cache[replaceIndex].prgIndex = index;
-	cache[replaceIndex].request = requestIndex;
-	BlockRead(cache[replaceIndex].ptr, 8192, 16 + 8192 * index);
-	return cache[replaceIndex].ptr;
-}
-
-// caches an 8 KB CHR bank, returns result bank memory pointer
-unsigned char* nes_cart::cacheCHRBank(int16* indices) {
-	int chrBankMask = (numCHRBanks << 3) - 1;
-	indices[0] &= chrBankMask;
-	indices[1] &= chrBankMask;
-	indices[2] &= chrBankMask;
-	indices[3] &= chrBankMask;
-	indices[4] &= chrBankMask;
-	indices[5] &= chrBankMask;
-	indices[6] &= chrBankMask;
-	indices[7] &= chrBankMask;
-
-	requestIndex++;
-
-	// find bank index within range:
-	const int cacheIndex = 4096;
-	for (int i = 0; i < cachedBankCount; i++) {
-		if (cache[i].prgIndex == cacheIndex) {
-			nes_cached_bank& bank = cache[i];
-			if (bank.chrIndex[0] == indices[0] && bank.chrIndex[1] == indices[1] &&
-				bank.chrIndex[2] == indices[2] && bank.chrIndex[3] == indices[3] &&
-				bank.chrIndex[4] == indices[4] && bank.chrIndex[5] == indices[5] &&
-				bank.chrIndex[6] == indices[6] && bank.chrIndex[7] == indices[7])
-			{
-				bank.request = requestIndex;
-				return bank.ptr;
-			}
+	int entry = prgCache.find(key);
+	if (entry != -1) {
+		COUNT_SCOPE_NAMED(prg_cache_hit, 1);
+		prgCache.hits++;
+		if (patchWindow < 0) {
+			prefetcher.onRequested(prgCache.entries[entry], false);
+		} else {
+			prgCache.entries[entry].useFrame = nesPPU.frameCounter;
 		}
+		return entry;
+	}
+
+	// replace least recently used bank that isn't mapped
+	if (prgCache.oldest() != -1) {
+		prefetcher.onEvicted(prgCache.entries[prgCache.oldest()]);
+	}
+	int32 evictedKey;
+	entry = prgCache.evict(key, evictedKey);
+	COUNT_SCOPE_NAMED(prg_cache_miss, 1);
+	prgCache.misses++;
+	if (evictedKey != -1) {
+		COUNT_SCOPE_NAMED(prg_cache_evict, 1);
 	}
 
-	// replace smallest request entirely (no inactive memory for CHR ROM since they are copied to PPU mem directly)
-	int replaceIndex = findOldestUnusedBank();
-	nes_cached_bank& bank = cache[replaceIndex];
-	bank.prgIndex = cacheIndex;
-	bank.request = requestIndex;
-	for (int32 i = 0; i < 8; i++) {
-		bank.chrIndex[i] = indices[i];
-		BlockRead(bank.ptr + 1024 * i, 1024, 16 + 16384 * numPRGBanks + 1024 * indices[i]);
+	unsigned char* bankData = prgCache.entries[entry].ptr;
+	if (romImage) {
+		// only patched copies are ever cached over a resident ROM
+		memcpy(bankData, romImage + 16 + 8192 * index, 8192);
+	} else {
+#if DEBUG
+		// miss cost, reported as the stall a used prefetch avoided
+		const uint32 start = GetCycles();
+#endif
+		ReadROM(bankData, 8192, 16 + 8192 * index);
+#if DEBUG
+		prefetcher.onMiss(false, start - GetCycles());
+#endif
+		COUNT_SCOPE_NAMED(prg_cache_bytes, 8192);
+	}
+
+	if (patchWindow >= 0) {
+		nesCheats.patchBank(index, patchWindow, bankData);
+		prgCache.entries[entry].useFrame = nesPPU.frameCounter;
+	} else {
+		prefetcher.onRequested(prgCache.entries[entry], false);
 	}
-	return bank.ptr;
+	return entry;
 }
 
-// caches a single 8 KB CHR bank based on the 8 KB index, returns result bank memory pointer
-unsigned char* nes_cart::cacheSingleCHRBank(int16 index) {
-	int16 indices[8] = {
-		index * 8 + 0, index * 8 + 1, index * 8 + 2, index * 8 + 3,
-		index * 8 + 4, index * 8 + 5, index * 8 + 6, index * 8 + 7
-	};
+// caches a 1 KB CHR page, returns chrCache entry
+int nes_cart::cacheCHRPage(int32 index) {
+	index &= (numCHRBanks << 3) - 1;
+
+	prefetcher.train(true, index);
+
+	int entry = chrCache.find(index);
+	if (entry != -1) {
+		COUNT_SCOPE_NAMED(chr_cache_hit, 1);
+		chrCache.hits++;
+		prefetcher.onRequested(chrCachePages[entry], true);
+		return entry;
+	}
 
-	return cacheCHRBank(indices);
+	// replace least recently used page that isn't mapped
+	if (chrCache.oldest() != -1) {
+		prefetcher.onEvicted(chrCachePages[chrCache.oldest()]);
+	}
+	int32 evictedKey;
+	entry = chrCache.evict(index, evictedKey);
+	COUNT_SCOPE_NAMED(chr_cache_miss, 1);
+	chrCache.misses++;
+	if (evictedKey != -1) {
+		COUNT_SCOPE_NAMED(chr_cache_evict, 1);
+	}
+
+#if DEBUG
+	// miss cost, reported as the stall a used prefetch avoided
+	const uint32 start = GetCycles();
+#endif
+	ReadROM(chrCachePages[entry].ptr, 1024, 16 + 16384 * numPRGBanks + 1024 * index);
+#if DEBUG
+	prefetcher.onMiss(true, start - GetCycles());
+#endif
+	COUNT_SCOPE_NAMED(chr_cache_bytes, 1024);
+
+	prefetcher.onRequested(chrCachePages[entry], true);
+	return entry;
 }
 
 void nes_cart::MapProgramBanks(int32 toBank, int32 cartBank, int32 numBanks) {
@@ -557,30 +876,34 @@ void nes_cart::MapProgramBanks(int32 toBank, int32 cartBank, int32 numBanks) {
 
 	const unsigned int addrTarget[5] = {0x80, 0xA0, 0xC0, 0xE0, 0x60};
 
-	bool bDidRemap = false;
-
 	for (int32 i = 0; i < numBanks; i++) {
 		const int32 destBank = i + toBank;
 		if (programBanks[destBank] != cartBank + i) {
 			programBanks[destBank] = cartBank + i;
-			mainCPU.setMapKB(addrTarget[destBank], 8, cachePRGBank(cartBank + i));
-			bDidRemap = true;
-		}
-	}
 
-	if (bDidRemap) {
-		// game genie codes
-		for (int code = 0; code < 10; code++) {
-			if (nesSettings.codes[code].isActive()) {
-				unsigned int addr = nesSettings.codes[code].getEffAddr();
-				uint8 setValue = nesSettings.codes[code].getSetValue();
-				unsigned char* memValue = mainCPU.getNonIOMem(addr);
-				if ((size_t) memValue >= 0x10000 && (nesSettings.codes[code].doCompare() == false || nesSettings.codes[code].getCmpValue() == *memValue)) {
-					*memValue = setValue;
-				}
+			int entry = -1;
+			unsigned char* bankData;
+			if (nesCheats.hasPatches(cartBank + i, destBank)) {
+				// patched banks get a private copy, the master (cached or resident) stays clean
+				entry = cachePRGBank(cartBank + i, destBank);
+				prgCache.pin(entry);
+				bankData = prgCache.entries[entry].ptr;
+			} else if (romImage) {
+				// resident ROM is mapped in place
+				bankData = (unsigned char*) romImage + 16 + 8192 * (cartBank + i);
 			} else {
-				break;
+				// pin the new bank before releasing the old one, so a bank mapped elsewhere is never evicted
+				entry = cachePRGBank(cartBank + i);
+				prgCache.pin(entry);
+				bankData = prgCache.entries[entry].ptr;
 			}
+
+			if (programBankEntries[destBank] != -1) {
+				prgCache.unpin(programBankEntries[destBank]);
+			}
+			programBankEntries[destBank] = entry;
+
+			mainCPU.setMapKB(addrTarget[destBank], 8, bankData);
 		}
 	}
 }
@@ -588,16 +911,38 @@ void nes_cart::MapProgramBanks(int32 toBank, int32 cartBank, int32 numBanks) {
 void nes_cart::CommitChrBanks() {
 	DebugAssert(numCHRBanks); // should not happen with CHR RAM
 
-	uint8* bankData = cacheCHRBank(chrBanks);
+	nesPPU.catchUp();
 
-	if (bSwapChrPages) {
-		nesPPU.chrPages[0] = bankData + 0x1000;
-		nesPPU.chrPages[1] = bankData;
-	} else {
-		nesPPU.chrPages[0] = bankData;
-		nesPPU.chrPages[1] = bankData + 0x1000;
+	const int chrBankMask = (numCHRBanks << 3) - 1;
+	const int swap = bSwapChrPages ? 4 : 0;
+
+	if (romImage) {
+		// resident ROM, pages point straight into the image
+		unsigned char* chrROM = (unsigned char*) romImage + 16 + 16384 * numPRGBanks;
+		for (int i = 0; i < 8; i++) {
+			nesPPU.chrPages[i ^ swap] = chrROM + 0x400 * (chrBanks[i] & chrBankMask);
+		}
+
+		bDirtyChrBanks = false;
+		return;
 	}
-	
+
+	// only pages whose bank actually changed need a lookup, the rest are still pinned (and so still cached)
+	for (int i = 0; i < 8; i++) {
+		const int32 index = chrBanks[i] & chrBankMask;
+		const int page = i ^ swap;
+		const int oldEntry = chrPageEntries[page];
+		if (oldEntry == -1 || chrCachePages[oldEntry].key != index) {
+			const int entry = cacheCHRPage(index);
+			chrCache.pin(entry);
+			if (oldEntry != -1) {
+				chrCache.unpin(oldEntry);
+			}
+			chrPageEntries[page] = entry;
+			nesPPU.chrPages[page] = chrCachePages[entry].ptr;
+		}
+	}
+
 	bDirtyChrBanks = false;
 }
 
@@ -614,35 +959,8 @@ void nes_cart::MapCharacterBanks(int32 toBank, int32 cartBank, int32 numBanks) {
 }
 
 bool nes_cart::IRQReached() {
-	if (mapper == 64) {
-		if (Mapper64_IRQ_MODE == 1) {
-			// set next IRQ breakpoint
-			Mapper64_IRQ_CLOCKS = mainCPU.irqClock[0] + Mapper64_IRQ_COUNT + 4;
-			if (Mapper64_IRQ_ENABLE) {
-				mainCPU.setIRQ(0, Mapper64_IRQ_CLOCKS);
-				return true;
-			}
-
-			mainCPU.ackIRQ(0);
-			return false;
-		}
-	}
-
-	if (mapper == 4) {
-		MMC3_IRQ_LATCH = 0;
-	}
-
-	if (mapper == 67) {
-		Mapper67_IRQ_Counter = 0xFFFF;
-		Mapper67_IRQ_Enable = 0;
-		return true;
-	}
-
-	if (mapper == 69) {
-		if ((Mapper69_IRQCONTROL & 0x1) == 0) {
-			mainCPU.ackIRQ(0);
-			return false;
-		}
+	if (mapperInterface->irqReached) {
+		return (this->*mapperInterface->irqReached)();
 	}
 
 	// by default disable IRQ
@@ -652,17 +970,7 @@ bool nes_cart::IRQReached() {
 }
 
 void nes_cart::rollbackClocks(unsigned int clockCount) {
-	if (mapper == 4) {
-		MMC3_IRQ_LASTSET -= clockCount;
-	} else if (mapper == 64) {
-		if (Mapper64_IRQ_CLOCKS) {
-			Mapper64_IRQ_CLOCKS -= clockCount;
-		}
-	} else if (mapper == 67) {
-		Mapper67_IRQ_LastSet -= clockCount;
-	} else if (mapper == 69) {
-		if (Mapper69_LASTCOUNTERCLK) {
-			Mapper69_LASTCOUNTERCLK -= clockCount;
-		}
+	if (mapperInterface->rollbackClocks) {
+		(this->*mapperInterface->rollbackClocks)(clockCount);
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,337 @@
+
+// Game Genie and raw RAM/ROM cheat codes. Parsing has no file or cart dependencies so host tools can use it too.
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+
+static const char CodeTable[16] = {
+	'A','P','Z','L','G','I','T','Y',
+	'E','O','X','U','K','S','V','N'
+};
+
+static int GameGenieNibble(char withChar) {
+	for (int i = 0; i < 16; i++) {
+		if (withChar == CodeTable[i])
+			return i;
+	}
+	return -1;
+}
+
+static int HexNibble(char withChar) {
+	if (withChar >= '0' && withChar <= '9') return withChar - '0';
+	if (withChar >= 'A' && withChar <= 'F') return withChar - 'A' + 10;
+	return -1;
+}
+
+// reads numDigits hex digits, returns -1 if any isn't one
+static int ParseHex(const char* text, int numDigits) {
+	int value = 0;
+	for (int i = 0; i < numDigits; i++) {
+		const int nibble = HexNibble(text[i]);
+		if (nibble < 0)
+			return -1;
+		value = (value << 4) | nibble;
+	}
+	return value;
+}
+
+static bool ParseGameGenie(const char* text, int length, nes_cheat& into) {
+	if (length != 6 && length != 8)
+		return false;
+
+	int n[8];
+	for (int i = 0; i < 6; i++) {
+		n[i] = GameGenieNibble(text[i]);
+		if (n[i] < 0)
+			return false;
+	}
+
+	// the high bit of the third letter says whether there is a compare value, an 8 letter code without it is
+	// used as a 6 letter code (the last two letters are ignored, as the hardware does)
+	if (n[2] & 8) {
+		if (length != 8)
+			return false;
+		for (int i = 6; i < 8; i++) {
+			n[i] = GameGenieNibble(text[i]);
+			if (n[i] < 0)
+				return false;
+		}
+	}
+	length = (n[2] & 8) ? 8 : 6;
+
+	into.address = 0x8000 | ((n[3] & 7) << 12) | ((n[5] & 7) << 8) | ((n[4] & 8) << 8) | ((n[2] & 7) << 4) | ((n[1] & 8) << 4) | (n[4] & 7) | (n[3] & 8);
+	into.bRAM = false;
+	if (length == 8) {
+		into.value = ((n[1] & 7) << 4) | ((n[0] & 8) << 4) | (n[0] & 7) | (n[7] & 8);
+		into.compare = ((n[7] & 7) << 4) | ((n[6] & 8) << 4) | (n[6] & 7) | (n[5] & 8);
+		into.bCompare = true;
+	} else {
+		into.value = ((n[1] & 7) << 4) | ((n[0] & 8) << 4) | (n[0] & 7) | (n[5] & 8);
+		into.compare = 0;
+		into.bCompare = false;
+	}
+	return true;
+}
+
+// AAAA:VV or AAAA?CC:VV
+static bool ParseRaw(const char* text, int length, nes_cheat& into) {
+	const int address = ParseHex(text, 4);
+	if (address < 0)
+		return false;
+
+	int compare = -1;
+	int value = -1;
+	if (length == 7 && text[4] == ':') {
+		value = ParseHex(text + 5, 2);
+	} else if (length == 10 && text[4] == '?' && text[7] == ':') {
+		compare = ParseHex(text + 5, 2);
+		value = ParseHex(text + 8, 2);
+		if (compare < 0)
+			return false;
+	}
+	if (value < 0)
+		return false;
+
+	into.address = address;
+	into.value = value;
+	into.compare = compare < 0 ? 0 : compare;
+	into.bCompare = compare >= 0;
+	into.bRAM = address < 0x8000;
+
+	// compares only make sense against ROM
+	return !(into.bRAM && into.bCompare);
+}
+
+bool nes_cheats::parse(const char* text, nes_cheat& into) {
+	char code[12];
+	int length = 0;
+	for (; text[length]; length++) {
+		if (length == 10)
+			return false;
+		char curChar = text[length];
+		if (curChar >= 'a' && curChar <= 'z')
+			curChar += 'A' - 'a';
+		code[length] = curChar;
+	}
+	code[length] = 0;
+
+	if (!ParseGameGenie(code, length, into) && !ParseRaw(code, length, into))
+		return false;
+
+	strcpy(into.text, code);
+	return true;
+}
+
+int32 nes_cheats::parseText(const char* text, int32 length) {
+	int32 numAdded = 0;
+
+	for (int32 i = 0; i < length; ) {
+		// first token of the line is the code
+		while (i < length && (text[i] == ' ' || text[i] == '\t'))
+			i++;
+		char token[12];
+		int tokenLength = 0;
+		while (i < length && text[i] != ' ' && text[i] != '\t' && text[i] != '\n' && text[i] != '\r') {
+			if (tokenLength < 11)
+				token[tokenLength] = text[i];
+			tokenLength++;
+			i++;
+		}
+
+		// skip the rest of the line
+		while (i < length && text[i] != '\n')
+			i++;
+		i++;
+
+		if (tokenLength == 0 || tokenLength > 11)
+			continue;
+		token[tokenLength] = 0;
+
+		nes_cheat cheat;
+		if (!parse(token, cheat))
+			continue;
+
+		if (numCodes == maxCodes) {
+			maxCodes = maxCodes ? maxCodes * 2 : 16;
+			codes = (nes_cheat*) realloc(codes, sizeof(nes_cheat) * maxCodes);
+		}
+		codes[numCodes++] = cheat;
+		numAdded++;
+	}
+
+	return numAdded;
+}
+
+void nes_cheats::clear() {
+	free(codes);
+	free(patches);
+	free(patchStart);
+	free(patchWindows);
+	free(ramFreezes);
+	memset(this, 0, sizeof(nes_cheats));
+}
+
+void nes_cheats::load(const char* romFile) {
+	clear();
+
+	// loads optional game genie file
+	char ggFile[256];
+	strcpy(ggFile, romFile);
+	strcpy(strrchr(ggFile, '.'), ".gg");
+
+	int file;
+	{
+		unsigned short ggFileWide[256];
+		Bfile_StrToName_ncpy(ggFileWide, ggFile, 255);
+
+		file = Bfile_OpenFile_OS(ggFileWide, READ, 0);
+	}
+
+	if (file < 0) {
+		// no .gg file
+		return;
+	}
+
+	const int32 fileSize = Bfile_GetFileSize_OS(file);
+	char* text = (char*) malloc(fileSize > 0 ? fileSize : 1);
+	const int32 numRead = Bfile_ReadFile_OS(file, text, fileSize, 0);
+	Bfile_CloseFile_OS(file);
+
+	if (numRead > 0) {
+		parseText(text, numRead);
+	}
+	free(text);
+}
+
+// master ROM byte at the given PRG offset if it can be read without caching anything
+static bool PeekPRG(const nes_cart& cart, int32 prgOffset, uint8& value) {
+	const int32 fileOffset = 16 + prgOffset;
+	if (cart.romImage) {
+		value = cart.romImage[fileOffset];
+		return true;
+	}
+	if (!cart.isCompressed && cart.blocks[fileOffset >> 12]) {
+		value = cart.blocks[fileOffset >> 12][fileOffset & 0xFFF];
+		return true;
+	}
+	return false;
+}
+
+void nes_cheats::buildPatches(const nes_cart& cart) {
+	free(patches);
+	free(patchStart);
+	free(patchWindows);
+	free(ramFreezes);
+	patches = nullptr;
+	patchStart = nullptr;
+	patchWindows = nullptr;
+	ramFreezes = nullptr;
+	numPatchBanks = 0;
+	numRAMFreezes = 0;
+
+	if (numCodes == 0) {
+		return;
+	}
+
+	// ROM codes sorted by address so each bank list comes out sorted by window and offset
+	int32* order = (int32*) malloc(sizeof(int32) * numCodes);
+	int32 numROMCodes = 0;
+	int32 numRAMCodes = 0;
+	for (int32 i = 0; i < numCodes; i++) {
+		if (codes[i].bRAM) {
+			numRAMCodes++;
+			continue;
+		}
+
+		const int32 cur = i;
+		int32 j = numROMCodes++;
+		for (; j > 0 && codes[order[j - 1]].address > codes[cur].address; j--) {
+			order[j] = order[j - 1];
+		}
+		order[j] = cur;
+	}
+
+	// internal RAM anywhere, cart RAM only where it is really RAM
+	if (numRAMCodes) {
+		ramFreezes = (uint32*) malloc(sizeof(uint32) * numRAMCodes);
+		for (int32 i = 0; i < numCodes; i++) {
+			const nes_cheat& code = codes[i];
+			if (code.bRAM && (code.address < 0x2000 || (code.address >= 0x6000 && cart.numRAMBanks && !cart.isLowPRGROM))) {
+				ramFreezes[numRAMFreezes++] = (code.address << 8) | code.value;
+			}
+		}
+	}
+
+	if (numROMCodes) {
+		const int32 numBanks = cart.numPRGBanks * 2;
+		patchStart = (int32*) malloc(sizeof(int32) * (numBanks + 1));
+		patchWindows = (uint8*) malloc(numBanks);
+
+		// count, then fill
+		int32 numPatches = 0;
+		for (int pass = 0; pass < 2; pass++) {
+			numPatches = 0;
+			for (int32 bank = 0; bank < numBanks; bank++) {
+				patchStart[bank] = numPatches;
+				patchWindows[bank] = 0;
+
+				for (int32 i = 0; i < numROMCodes; i++) {
+					const nes_cheat& code = codes[order[i]];
+					const int32 offset = code.address & 0x1FFF;
+
+					// compare codes that can't match this bank are dropped up front when the ROM can be peeked
+					uint8 romValue;
+					if (code.bCompare && PeekPRG(cart, bank * 8192 + offset, romValue) && romValue != code.compare) {
+						continue;
+					}
+
+					if (pass == 1) {
+						nes_bank_patch& patch = patches[numPatches];
+						patch.offset = code.address & 0x7FFF;
+						patch.compare = code.compare;
+						patch.value = code.value;
+						patch.bCompare = code.bCompare;
+						patchWindows[bank] |= 1 << (patch.offset >> 13);
+					}
+					numPatches++;
+				}
+			}
+			patchStart[numBanks] = numPatches;
+
+			if (pass == 0) {
+				patches = (nes_bank_patch*) malloc(sizeof(nes_bank_patch) * (numPatches ? numPatches : 1));
+			}
+		}
+
+		numPatchBanks = numBanks;
+		OutputLog("Cheats: %d ROM patches over %d banks, %d RAM freezes\n", numPatches, numBanks, numRAMFreezes);
+	}
+
+	free(order);
+}
+
+void nes_cheats::patchBank(int32 bank, int32 window, uint8* data) const {
+	DebugAssert(bank < numPatchBanks);
+
+	const uint32 windowBits = window << 13;
+	for (int32 i = patchStart[bank]; i < patchStart[bank + 1]; i++) {
+		const nes_bank_patch& patch = patches[i];
+		if ((patch.offset & 0x6000) != windowBits) {
+			if ((patch.offset & 0x6000) > windowBits)
+				break;
+			continue;
+		}
+
+		uint8& romValue = data[patch.offset & 0x1FFF];
+		if (!patch.bCompare || romValue == patch.compare) {
+			romValue = patch.value;
+		}
+	}
+}
+
+void nes_cheats::applyRAM() const {
+	for (int32 i = 0; i < numRAMFreezes; i++) {
+		mainCPU.writeDirect(ramFreezes[i] >> 8, ramFreezes[i] & 0xFF);
+	}
+}
@@ -5,7 +5,25 @@
 #include "debug.h"
 #include "nes.h"
 
-nes_cpu mainCPU ALIGN(256);
+// what open bus reads return, a recognizable pattern
+static const unsigned char OpenBusPattern[256] = {
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+	0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+};
 
 void nes_cpu::latchedSpecial(unsigned int addr) {
 	if (addr == 0x4015) {
@@ -40,6 +58,8 @@ void nes_cpu::writeSpecial(unsigned int addr, unsigned char value) {
 			break;
 		}
 	} else if (addr < 0x10000) {
+		// mapper writes may swap CHR or nametables directly
+		nesPPU.catchUp();
 		nesCart.writeSpecial(addr, value);
 	} else {
 		write(addr & 0xFFFF, value);
@@ -49,6 +69,9 @@ void nes_cpu::writeSpecial(unsigned int addr, unsigned char value) {
 void nes_cpu::mapDefaults() {
 	memset(_map, 0, sizeof(_map));
 
+	// filled here rather than by a constructor, static constructors can't be relied on for the calculator
+	memcpy(nesMachine.openBus, OpenBusPattern, sizeof(OpenBusPattern));
+
 	// 0x0000 - 0x2000 is RAM and its mirrors
 	for (int m = 0x00; m < 0x20; m++) {
 		setMap(m + 0x00, 1, &RAM[(m & 0x7) * 0x100]);
@@ -135,5 +158,6 @@ void nes_cpu::syncClocks() {
 		if (irqClock[2]) irqClock[0] -= reduction;
 
 		nesCart.rollbackClocks(reduction);
+		nesAPU.rollbackClocks(reduction);
 	}
 }
\ No newline at end of file
@@ -1,8 +1,6 @@
 #pragma once
 // inlined header file for cpu_6502 sub-struct so we can include NES specific functionality
 
-extern unsigned char openBus[256];
-
 struct nes_cpu : public cpu_6502 {
 	// each 8 KB page access is stored to determine if we need to effect hardware from a read
 	unsigned int accessTable[8];
@@ -64,12 +62,8 @@ struct nes_cpu : public cpu_6502 {
 		}
 	}
 
-	FORCE_INLINE void setMapOpenBus(unsigned int startAddrHigh, unsigned int numBlocks) {
-		for (unsigned int i = 0; i < numBlocks; i++) {
-			_map[startAddrHigh] = openBus - (startAddrHigh << 8);
-			startAddrHigh++;
-		}
-	}
+	// (defined with the machine that owns the open bus page)
+	FORCE_INLINE void setMapOpenBus(unsigned int startAddrHigh, unsigned int numBlocks);
 
 	FORCE_INLINE void setMapKB(unsigned int startAddrHigh, unsigned int numKB, unsigned char* ptr) {
 		setMap(startAddrHigh, numKB * 4, ptr);
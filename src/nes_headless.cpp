@@ -0,0 +1,104 @@
+// Host side headless mode. Bots and batch tests only need the machine's state, so frames run without being drawn,
+// mixed or presented unless one is asked for
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+#include "frontend.h"
+#include "render_thread.h"
+
+#if TARGET_WINSIM
+
+#include <windows.h>
+
+void nes_headless::start() {
+	if (bActive) {
+		return;
+	}
+
+#if PPU_RENDER_THREAD
+	// a frame still drawing would present after the mode starts (batch machines never drew one)
+	if (nesRenderThread.isActive()) {
+		nesRenderThread.sync();
+	}
+#endif
+
+	// with nothing mixing, writes apply as they are made and only the DMC is run to keep its IRQ. Sound is per machine,
+	// so this only stops the audio thread when it is the default machine that was playing
+	nesAPU.shutdown();
+
+	bActive = true;
+	bFrameRequested = false;
+	bHashRequested = false;
+	bHashing = false;
+}
+
+void nes_headless::stop() {
+	if (!bActive) {
+		return;
+	}
+
+	bActive = false;
+	bFrameRequested = false;
+
+	// back to the sound setting
+	nesAPU.startup();
+}
+
+void nes_headless::requestFrame() {
+	bFrameRequested = true;
+}
+
+void nes_headless::requestFrameHash() {
+	bHashRequested = true;
+}
+
+void nes_headless::beginFrame() {
+	bHashing = bHashRequested;
+	bHashRequested = false;
+	if (bHashing) {
+		// FNV-1a
+		frameHash = 2166136261u;
+	}
+}
+
+void nes_headless::hashScanline(const nes_ppu& ppu) {
+	// palette entries as the display would resolve them (backdrop mirroring), with the emphasis and grayscale bits
+	const uint32 bank = nes_ppu::paletteBankIndex(ppu.PPUMASK) << 6;
+	const uint8* src = &ppu.scanlineBuffer[8 + (ppu.SCROLLX & 15)];
+
+	uint32 hash = frameHash;
+	for (int32 i = 0; i < 240; i++) {
+		const uint32 entry = src[i] >> 1;
+		const uint32 color = (ppu.palette[(entry & 3) ? entry : 0] & 0x3F) | bank;
+		hash = (hash ^ (color & 0xFF)) * 16777619u;
+		hash = (hash ^ (color >> 8)) * 16777619u;
+	}
+	frameHash = hash;
+}
+
+int32 nes_headless::benchmark(int32 numFrames) {
+	extern bool shouldExit;
+
+	start();
+
+	LARGE_INTEGER frequency, startTime, endTime;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&startTime);
+
+	int32 frame = 0;
+	for (; frame < numFrames && !shouldExit; frame++) {
+		nesFrontend.RunFrame();
+	}
+
+	QueryPerformanceCounter(&endTime);
+	stop();
+
+	const int32 ms = int32((endTime.QuadPart - startTime.QuadPart) * 1000 / frequency.QuadPart);
+	const int32 fps = ms ? int32((long long) frame * 1000 / ms) : 0;
+	const int32 fullSpeed = nesCart.isPAL ? 50 : 60;
+	OutputLog("Headless: %d frames in %d ms, %d FPS (%d%% of full speed)\n", frame, ms, fps, fps * 100 / fullSpeed);
+	return fps;
+}
+
+#endif
@@ -0,0 +1,26 @@
+// The emulated machine instances (see nes_machine.h)
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+
+#if NES_MULTI_MACHINE
+static nes_machine defaultMachine ALIGN(256);
+thread_local nes_machine* nesCurrentMachine = &defaultMachine;
+#else
+nes_machine nesMachine ALIGN(256);
+#endif
+
+#if NES_MULTI_MACHINE
+void* nes_machine::operator new(size_t size) {
+	return calloc(1, size);
+}
+
+void nes_machine::operator delete(void* ptr) {
+	free(ptr);
+}
+
+void nes_machine::makeCurrent() {
+	nesCurrentMachine = this;
+}
+#endif
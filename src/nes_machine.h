@@ -0,0 +1,87 @@
+#pragma once
+
+// Everything one emulated NES is made of. The core reaches the current machine through nesMachine, and its parts
+// through the mainCPU, nesPPU, nesAPU, nesCart names it has always used. On the calculator there is a single static
+// machine so every access is still to a fixed address. The host build can run several machines side by side, each
+// thread runs the core on its own current machine (the default one until it picks another with makeCurrent())
+
+// What stays shared between machines:
+//  - frontend features (rewind, run ahead, the render, audio and capture threads, the menus) work on the default
+//    machine. Only it starts the APU, so only it ever mixes or drives nesAudioThread. nesFrontend.RunFrame() just
+//    steps the calling thread's machine
+//  - nesSettings is read by the core but only written from the menus, with no other machine running. Its key polling
+//    is left to the default machine, machines fed external input (bExternalInput) skip the frame and volume keys
+//  - tables built from constants (6502 addressing modes, APU mix tables) are filled before play starts
+//    and only read after
+//  - DEBUG only scope timers and mute switches count for all of them together
+
+#define NES_MULTI_MACHINE TARGET_WINSIM
+
+struct nes_machine {
+	nes_cpu cpu;
+	nes_ppu ppu ALIGN(256);
+	nes_apu apu;
+	nes_apu_mixer apuMixer;
+	nes_cart cart;
+	nes_cheats cheats;
+
+	// nametable RAM in the console, for carts that don't bring their own
+	nes_nametable onboardPPUTables[4];
+
+	// what reads from unmapped memory return (filled by nes_cpu::mapDefaults)
+	unsigned char openBus[256];
+
+	// controller strobe and shift state, and the keys held this frame (see nes_input.cpp)
+	unsigned char curStrobe;
+	unsigned int buttonMarch1;
+	unsigned int buttonMarch2;
+	bool isDown[NES_MAX_KEYS];
+
+#if !TARGET_PRIZM
+	// scanline buffer (the calculator keeps its one in on chip memory)
+	unsigned char scanlineBufferMem[256 + 16 * 2];
+#endif
+
+#if TARGET_WINSIM
+	nes_headless headless;
+#endif
+
+#if NES_MULTI_MACHINE
+	// allocated zeroed, like the static default machine
+	static void* operator new(size_t size);
+	static void operator delete(void* ptr);
+
+	// the core on the calling thread runs on this machine from now on
+	void makeCurrent();
+#endif
+};
+
+#if NES_MULTI_MACHINE
+extern thread_local nes_machine* nesCurrentMachine;
+#define nesMachine (*nesCurrentMachine)
+
+// loads the calling thread's machine into a local, so the machine names used after it in the function (the hot loops)
+// resolve to that instead of going through thread local storage on every access
+#define NES_LOCAL_MACHINE() nes_machine* const nesCurrentMachine = ::nesCurrentMachine
+#else
+extern nes_machine nesMachine;
+#define NES_LOCAL_MACHINE()
+#endif
+
+#define mainCPU (nesMachine.cpu)
+#define nesPPU (nesMachine.ppu)
+#define nesAPU (nesMachine.apu)
+#define nesAPUMixer (nesMachine.apuMixer)
+#define nesCart (nesMachine.cart)
+#define nesCheats (nesMachine.cheats)
+
+#if TARGET_WINSIM
+#define nesHeadless (nesMachine.headless)
+#endif
+
+FORCE_INLINE void nes_cpu::setMapOpenBus(unsigned int startAddrHigh, unsigned int numBlocks) {
+	for (unsigned int i = 0; i < numBlocks; i++) {
+		_map[startAddrHigh] = nesMachine.openBus - (startAddrHigh << 8);
+		startAddrHigh++;
+	}
+}
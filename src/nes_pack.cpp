@@ -0,0 +1,155 @@
+
+// Host side packing tool for .nesz ROM containers (layout described with PACKED_ROM_VERSION in nes.h)
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+#include "zx7/zx7.h"
+
+#if TARGET_WINSIM
+
+struct packed_unit {
+	const uint8* data;			// zx7 data, or the unit itself when stored raw
+	uint8* compressed;			// owned zx7 data if any
+	int32 size;
+	int32 offset;				// file offset once placed
+};
+
+static void WriteBigEndian(uint8* into, uint32 value, int numBytes) {
+	for (int i = numBytes - 1; i >= 0; i--) {
+		into[i] = value & 0xFF;
+		value >>= 8;
+	}
+}
+
+bool PackROM(const char* romFile, const char* packedFile) {
+	unsigned short fileName[256];
+	Bfile_StrToName_ncpy(fileName, romFile, 255);
+
+	int file = Bfile_OpenFile_OS(fileName, READ, 0);
+	if (file < 0) {
+		return false;
+	}
+
+	unsigned char header[16];
+	const int fileSize = Bfile_GetFileSize_OS(file);
+	if (fileSize < 16 || Bfile_ReadFile_OS(file, header, 16, 0) != 16 || memcmp(header, "NES\x1A", 4) || (header[6] & (1 << 2))) {
+		OutputLog("%s: not a packable iNES file\n", romFile);
+		Bfile_CloseFile_OS(file);
+		return false;
+	}
+
+	// same bank counts nes_cart::loadROM comes up with
+	int numPRGBanks = header[4];
+	const int numCHRBanks = header[5];
+	if ((header[7] & 0x0C) == 0x08 && fileSize <= 16 + numCHRBanks * 8192 + ((header[9] << 8) + numPRGBanks) * 16384) {
+		numPRGBanks += header[9] << 8;
+	}
+
+	// short files are padded with zeros
+	const int romSize = 16 + 16384 * numPRGBanks + 8192 * numCHRBanks;
+	uint8* rom = (uint8*) calloc(romSize > fileSize ? romSize : fileSize, 1);
+	Bfile_ReadFile_OS(file, rom, fileSize, 0);
+	Bfile_CloseFile_OS(file);
+
+	const int numPRGUnits = numPRGBanks * 4;
+	const int numUnits = numPRGUnits + numCHRBanks * 8;
+	packed_unit* units = (packed_unit*) malloc(sizeof(packed_unit) * numUnits);
+	int* order = (int*) malloc(sizeof(int) * numUnits);
+	int* blockUsed = (int*) calloc(numUnits + 1, sizeof(int));
+
+	int rawTotal = 0;
+	for (int i = 0; i < numUnits; i++) {
+		const int unitSize = i < numPRGUnits ? PACKED_PRG_UNIT : PACKED_CHR_UNIT;
+		const uint8* unitData = rom + 16 + (i < numPRGUnits ? i * PACKED_PRG_UNIT : 16384 * numPRGBanks + (i - numPRGUnits) * PACKED_CHR_UNIT);
+
+		packed_unit& unit = units[i];
+		unit.compressed = nullptr;
+		uint32 compressedSize = ZX7Compress(unitData, unitSize, &unit.compressed);
+		if (compressedSize > 0 && compressedSize < unitSize) {
+			unit.data = unit.compressed;
+			unit.size = compressedSize;
+		} else {
+			unit.data = unitData;
+			unit.size = unitSize;
+		}
+
+		rawTotal += unitSize;
+		order[i] = i;
+	}
+
+	// largest first
+	for (int i = 1; i < numUnits; i++) {
+		const int cur = order[i];
+		int j = i;
+		for (; j > 0 && units[order[j - 1]].size < units[cur].size; j--) {
+			order[j] = order[j - 1];
+		}
+		order[j] = cur;
+	}
+
+	// first fit into 4 KB file blocks so no unit straddles two, the index makes the order free. The first block
+	// starts right after the index
+	const int indexEnd = PACKED_ROM_INDEX + PACKED_ROM_ENTRY * numUnits;
+	const int firstBlock = indexEnd >> 12;
+	blockUsed[0] = indexEnd & 0xFFF;
+	int numBlocks = 1;
+	int packedSize = indexEnd;
+	for (int i = 0; i < numUnits; i++) {
+		packed_unit& unit = units[order[i]];
+
+		int block = 0;
+		while (blockUsed[block] + unit.size > 0x1000) {
+			block++;
+		}
+		if (block == numBlocks) {
+			numBlocks++;
+		}
+
+		unit.offset = ((firstBlock + block) << 12) + blockUsed[block];
+		blockUsed[block] += unit.size;
+		if (unit.offset + unit.size > packedSize) {
+			packedSize = unit.offset + unit.size;
+		}
+	}
+
+	uint8* packed = (uint8*) calloc(packedSize, 1);
+	memcpy(packed, "NESZ", 4);
+	packed[4] = PACKED_ROM_VERSION;
+	memcpy(packed + 8, header, 16);
+	WriteBigEndian(packed + 24, fileSize, 4);
+	for (int i = 0; i < numUnits; i++) {
+		uint8* entry = packed + PACKED_ROM_INDEX + PACKED_ROM_ENTRY * i;
+		WriteBigEndian(entry, units[i].offset, 4);
+		WriteBigEndian(entry + 4, units[i].size, 2);
+		memcpy(packed + units[i].offset, units[i].data, units[i].size);
+		free(units[i].compressed);
+	}
+
+	Bfile_StrToName_ncpy(fileName, packedFile, 255);
+	Bfile_DeleteEntry(fileName);
+
+	size_t size = packedSize;
+	bool bWritten = false;
+	if (Bfile_CreateEntry_OS(fileName, CREATEMODE_FILE, &size) == 0) {
+		file = Bfile_OpenFile_OS(fileName, WRITE, 0);
+		if (file >= 0) {
+			Bfile_WriteFile_OS(file, packed, packedSize);
+			Bfile_CloseFile_OS(file);
+			bWritten = true;
+		}
+	}
+
+	if (bWritten) {
+		OutputLog("Packed %s: %d KB of banks into %d KB\n", romFile, rawTotal / 1024, packedSize / 1024);
+	}
+
+	free(packed);
+	free(blockUsed);
+	free(order);
+	free(units);
+	free(rom);
+	return bWritten;
+}
+
+#endif
@@ -56,8 +56,74 @@ const uint8* GetCustomPalette() {
 	return hasCustomPalette ? customPalette : nullptr;
 }
 
+// emphasis attenuation of a 5 bit color channel, indexed by shift + 1 (-1 = emphasized, 0 = none, 1+ = attenuated)
+static const uint16 ShiftUpTable[32] =
+{
+	0b00000, 0b00010, 0b00100, 0b00110, 0b01000, 0b01010, 0b01100, 0b01110,
+	0b10000, 0b10010, 0b10100, 0b10110, 0b11000, 0b11010, 0b11100, 0b11110,
+	0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111,
+	0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111,
+};
+static const uint16 ShiftNoneTable[32] =
+{
+	0b00000, 0b00001, 0b00010, 0b00011, 0b00100, 0b00101, 0b00110, 0b00111,
+	0b01000, 0b01001, 0b01010, 0b01011, 0b01100, 0b01101, 0b01110, 0b01111,
+	0b10000, 0b10001, 0b10010, 0b10011, 0b10100, 0b10101, 0b10110, 0b10111,
+	0b11000, 0b11001, 0b11010, 0b11011, 0b11100, 0b11101, 0b11110, 0b11111,
+};
+static const uint16 ShiftDownTable[32] =
+{
+	0b00000, 0b00001, 0b00010, 0b00010, 0b00011, 0b00100, 0b00101, 0b00101,
+	0b00110, 0b00111, 0b01000, 0b01000, 0b01001, 0b01010, 0b01011, 0b01011,
+	0b01100, 0b01101, 0b01110, 0b01110, 0b01111, 0b10000, 0b10001, 0b10001,
+	0b10010, 0b10011, 0b10100, 0b10100, 0b10101, 0b10110, 0b10111, 0b10111,
+};
+static const uint16 ShiftDown2Table[32] =
+{
+	0b00000, 0b00001, 0b00001, 0b00001, 0b00010, 0b00010, 0b00011, 0b00011,
+	0b00100, 0b00100, 0b00101, 0b00101, 0b00110, 0b00110, 0b00111, 0b00111,
+	0b01000, 0b01000, 0b01001, 0b01001, 0b01010, 0b01010, 0b01011, 0b01011,
+	0b01100, 0b01100, 0b01101, 0b01101, 0b01110, 0b01110, 0b01111, 0b01111,
+};
+static const uint16* ShiftTables[5] = { ShiftUpTable, ShiftNoneTable, ShiftDownTable, ShiftDown2Table, ShiftDown2Table };
+
+// per channel shift for the given emphasis bits (0-7, red/green/blue), emphasized channel is kept while others dim
+static void GetEmphasisShifts(int emph, int& shiftRed, int& shiftGreen, int& shiftBlue) {
+	shiftRed = 1;
+	shiftGreen = 1;
+	shiftBlue = 1;
+	if (emph & 1) {
+		shiftRed -= 1;
+		shiftGreen += 1;
+		shiftBlue += 1;
+	}
+	if (emph & 2) {
+		shiftRed += 1;
+		shiftGreen -= 1;
+		shiftBlue += 1;
+	}
+	if (emph & 4) {
+		shiftRed += 1;
+		shiftGreen += 1;
+		shiftBlue -= 1;
+	}
+}
+
+#if TARGET_WINSIM
+// same attenuation as the 5 bit tables, for an 8 bit channel
+static uint32 ShiftComponent(uint32 c, int shift) {
+	switch (shift) {
+		case -1: return min(c * 2, 255);
+		case 0: return c;
+		case 1: return c * 3 / 4;
+		default: return c / 2;
+	}
+}
+#endif
+
 void nes_ppu::initPalette() {
-	// build 16-bit 565 palette from our source 24 bit palettes based on options
+	// build 16-bit 565 palettes (and 24 bit ones on the host) from our source 24 bit palettes based on options,
+	// with a bank for every emphasis / grayscale combination
 	const uint8* srcPalette = fceuxPalette;
 	if (nesSettings.GetSetting(ST_Palette) == 1)
 		srcPalette = classicPalette;
@@ -99,88 +165,96 @@ void nes_ppu::initPalette() {
 			}
 		}
 
-		rgbPalette[c] =
+		rgbPaletteBank[0][c] =
 			((min(r + 4, 255) >> 3) << 11) |
 			((min(g + 2, 255) >> 2) << 5) |
 			((min(b + 4, 255) >> 3) << 0);
-	}
-}
 
-// resolves base palette to our working palette based on selected indices for sprites and backgrounds, while
-// also applying emphasis bits as requested
-void nes_ppu::resolveWorkingPalette() {
-	for (int i = 0; i < 0x20; i++) {
-		if (i & 3) {
-			workingPalette[i] = rgbPalette[palette[i]];
-		} else {
-			workingPalette[i] = rgbPalette[palette[0]];
+#if TARGET_WINSIM
+		for (int emph = 0; emph < 8; emph++) {
+			int shiftRed, shiftGreen, shiftBlue;
+			GetEmphasisShifts(emph, shiftRed, shiftGreen, shiftBlue);
+			rgb888PaletteBank[emph][c] =
+				(ShiftComponent(r, shiftRed) << 16) |
+				(ShiftComponent(g, shiftGreen) << 8) |
+				ShiftComponent(b, shiftBlue);
 		}
+#endif
 	}
 
-	// emphasis bits
-	uint32 emph = PPUMASK & (PPUMASK_EMPHRED | PPUMASK_EMPHGREEN | PPUMASK_EMPHBLUE);
-	if (emph) {
-		int shiftRed = 1;
-		int shiftGreen = 1;
-		int shiftBlue = 1;
-		if (emph & PPUMASK_EMPHRED) {
-			shiftRed -= 1;
-			shiftGreen += 1;
-			shiftBlue += 1;
+	// emphasis variants of the 565 palette
+	for (int emph = 1; emph < 8; emph++) {
+		int shiftRed, shiftGreen, shiftBlue;
+		GetEmphasisShifts(emph, shiftRed, shiftGreen, shiftBlue);
+
+		for (int c = 0; c < 64; c++) {
+			const uint16 color = rgbPaletteBank[0][c];
+			rgbPaletteBank[emph][c] =
+				(ShiftTables[shiftRed + 1][(color & 0b1111100000000000) >> 11] << 11) |
+				(ShiftTables[shiftGreen + 1][(color & 0b0000011111000000) >> 6] << 6) |
+				(color & 0b0000000000100000) |
+				ShiftTables[shiftBlue + 1][color & 0b0000000000011111];
 		}
-		if (emph & PPUMASK_EMPHGREEN) {
-			shiftRed += 1;
-			shiftGreen -= 1;
-			shiftBlue += 1;
+	}
+
+	// grayscale mode strips the hue bits from each entry
+	for (int emph = 0; emph < 8; emph++) {
+		for (int c = 0; c < 64; c++) {
+			rgbPaletteBank[8 + emph][c] = rgbPaletteBank[emph][c & 0x30];
+#if TARGET_WINSIM
+			rgb888PaletteBank[8 + emph][c] = rgb888PaletteBank[emph][c & 0x30];
+#endif
 		}
-		if (emph & PPUMASK_EMPHBLUE) {
-			shiftRed += 1;
-			shiftGreen += 1;
-			shiftBlue -= 1;
+	}
+
+#if TARGET_WINSIM
+	for (int bank = 0; bank < 16; bank++) {
+		for (int c = 0; c < 64; c++) {
+			argb8888PaletteBank[bank][c] = 0xFF000000 | rgb888PaletteBank[bank][c];
 		}
+	}
+#endif
+
+	resolveWorkingPalette();
+}
 
-		const uint16 ShiftUpTable[32] =
-		{
-			0b00000, 0b00010, 0b00100, 0b00110, 0b01000, 0b01010, 0b01100, 0b01110,
-			0b10000, 0b10010, 0b10100, 0b10110, 0b11000, 0b11010, 0b11100, 0b11110,
-			0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111,
-			0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111, 0b11111,
-		};
-		const uint16 ShiftNoneTable[32] =
-		{
-			0b00000, 0b00001, 0b00010, 0b00011, 0b00100, 0b00101, 0b00110, 0b00111,
-			0b01000, 0b01001, 0b01010, 0b01011, 0b01100, 0b01101, 0b01110, 0b01111,
-			0b10000, 0b10001, 0b10010, 0b10011, 0b10100, 0b10101, 0b10110, 0b10111,
-			0b11000, 0b11001, 0b11010, 0b11011, 0b11100, 0b11101, 0b11110, 0b11111,
-		};
-		const uint16 ShiftDownTable[32] =
-		{
-			0b00000, 0b00001, 0b00010, 0b00010, 0b00011, 0b00100, 0b00101, 0b00101,
-			0b00110, 0b00111, 0b01000, 0b01000, 0b01001, 0b01010, 0b01011, 0b01011,
-			0b01100, 0b01101, 0b01110, 0b01110, 0b01111, 0b10000, 0b10001, 0b10001,
-			0b10010, 0b10011, 0b10100, 0b10100, 0b10101, 0b10110, 0b10111, 0b10111,
-		};
-		const uint16 ShiftDown2Table[32] =
-		{
-			0b00000, 0b00001, 0b00001, 0b00001, 0b00010, 0b00010, 0b00011, 0b00011,
-			0b00100, 0b00100, 0b00101, 0b00101, 0b00110, 0b00110, 0b00111, 0b00111,
-			0b01000, 0b01000, 0b01001, 0b01001, 0b01010, 0b01010, 0b01011, 0b01011,
-			0b01100, 0b01100, 0b01101, 0b01101, 0b01110, 0b01110, 0b01111, 0b01111,
-		};
-		const uint16* ShiftTables[5] = { ShiftUpTable, ShiftNoneTable, ShiftDownTable, ShiftDown2Table, ShiftDown2Table };
-
-		for (int32 i = 0; i < 0x20; i++) {
-			workingPalette[i] =
-				(ShiftTables[shiftRed + 1][(workingPalette[i] & 0b1111100000000000) >> 11] << 11) |
-				(ShiftTables[shiftGreen + 1][(workingPalette[i] & 0b0000011111000000) >> 6] << 6) |
-				(workingPalette[i] & 0b0000000000100000) |
-				ShiftTables[shiftBlue + 1][workingPalette[i] & 0b0000000000011111];
+// resolves base palette to the working palette of every bank based on selected indices for sprites and backgrounds
+void nes_ppu::resolveWorkingPalette() {
+	for (int bank = 0; bank < 16; bank++) {
+		const uint16* rgbPalette = rgbPaletteBank[bank];
+		uint16* bankPalette = workingPaletteBank[bank];
+		for (int i = 0; i < 0x20; i++) {
+			if (i & 3) {
+				bankPalette[i] = rgbPalette[palette[i] & 0x3F];
+			} else {
+				bankPalette[i] = rgbPalette[palette[0] & 0x3F];
+			}
 		}
 	}
 
+	selectPaletteBank();
 	dirtyPalette = false;
 }
 
+// updates a single palette entry in every bank after a palette write
+void nes_ppu::updateWorkingPalette(unsigned int entry) {
+	entry &= 0x1F;
+
+	if (entry & 3) {
+		for (int bank = 0; bank < 16; bank++) {
+			workingPaletteBank[bank][entry] = rgbPaletteBank[bank][palette[entry] & 0x3F];
+		}
+	} else {
+		// background color is mirrored to every palette
+		for (int bank = 0; bank < 16; bank++) {
+			const uint16 color = rgbPaletteBank[bank][palette[0] & 0x3F];
+			for (int i = 0; i < 0x20; i += 4) {
+				workingPaletteBank[bank][i] = color;
+			}
+		}
+	}
+}
+
 // HSV <-> RGB conversion without floats lifted from 
 // https://stackoverflow.com/questions/3018313/algorithm-to-convert-rgb-to-hsv-and-hsv-to-rgb-in-range-0-255-for-both
 
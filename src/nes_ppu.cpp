@@ -9,14 +9,15 @@
 #include "snd/snd.h"
 #include "scope_timer/scope_timer.h"
 #include "frontend.h"
+#include "render_thread.h"
+#include "audio_thread.h"
+#include "capture_thread.h"
 
 #if TRACE_DEBUG
 static unsigned int ppuWriteBreakpoint = 0x10000;
 extern void PPUBreakpoint();
 #endif
 
-nes_ppu nesPPU ALIGN(256);
-
 static uint16 reverseBytelookup[16] = {
 	0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe,
 	0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf
@@ -27,6 +28,52 @@ uint16 reverseByte(uint16 b) {
 	return (reverseBytelookup[b & 0xF] << 4) | reverseBytelookup[b >> 4];
 }
 
+inline unsigned char* nes_ppu::resolveMemoryAddress(unsigned int address, bool mirrorBehindPalette) {
+	address &= 0x3FFF;
+	if (address < 0x2000) {
+		if (nesCart.bDirtyChrBanks) {
+			nesCart.CommitChrBanks();
+		}
+
+		// pattern table memory
+		return &chrPages[address >> 10][address & 0x03FF];
+	} else if (address < 0x3F00 || mirrorBehindPalette) {
+		// name table memory
+		switch (mirror) {
+			case nes_mirror_type::MT_HORIZONTAL:
+				// $2400 = $2000, and $2c00 = $2800, so ignore bit 10:
+				address = (address & 0x03FF) | ((address & 0x800) >> 1);
+				break;
+			case nes_mirror_type::MT_VERTICAL:
+				// $2800 = $2000, and $2c00 = $2400, so ignore bit 11:
+				address = address & 0x07FF;
+				break;
+			case nes_mirror_type::MT_SINGLE:
+				// everything is just the first 1 kb
+				address = address & 0x03FF;
+				break;
+			case nes_mirror_type::MT_SINGLE_UPPER:
+				// everything is just the 2nd 1 kb
+				address = (address & 0x03FF) | 0x0400;
+				break;
+			case nes_mirror_type::MT_4PANE:
+				address = address & 0x0FFF;
+				break;
+		}
+		// this is meant to overflow
+		return &nameTables[0].table[address];
+	} else {
+		// palette memory 
+		address &= 0x1F;
+
+		// mirror background color between BG and OBJ types
+		if ((address & 0x03) == 0)
+			address &= 0x0F;
+
+		return &palette[address];
+	}
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Scanline handling
 
@@ -53,9 +100,6 @@ inline void CopyOver16(uint8* srcBytes) {
 #endif
 }
 
-// scanline buffers with padding to allow fast rendering with clipping
-static unsigned char oamScanlineBuffer[256 + 8] = { 0 }; 
-
 void nes_ppu::copyYScrollRegs() {
 	scrollY = SCROLLY;
 	flipY = (PPUCTRL & PPUCTRL_FLIPYTBL) != 0;
@@ -171,22 +215,38 @@ void nes_ppu::latchedReg(unsigned int addr) {
 }
 
 void nes_ppu::writeReg(unsigned int regNum, unsigned char value) {
+	// everything but status and OAM address is visible to the renderer
+	if (regNum != 0x02 && regNum != 0x03) {
+		catchUp();
+	}
+
 	switch (regNum) {
 		case 0x00:	// PPUCTRL
 			if ((PPUCTRL & PPUCTRL_NMI) == 0 && (value & PPUCTRL_NMI) && (PPUSTATUS & PPUSTAT_NMI)) {
 				mainCPU.ppuNMI = true;
 				mainCPU.nextClocks = mainCPU.clocks + 1;	// force an NMI check AFTER the next instruction
 			}
-			PPUCTRL = value;
+			if ((value ^ PPUCTRL) & PPUCTRL_SPRSIZE) {
+				PPUCTRL = value;
+				updateRenderScanline();
+			} else {
+				PPUCTRL = value;
+			}
 			break;
 		case 0x01:	// PPUMASK
 			if (value != PPUMASK) {
-				if ((value ^ PPUMASK) & (PPUMASK_EMPHRED | PPUMASK_EMPHGREEN | PPUMASK_EMPHBLUE)) {
-					// emphasis bits changed, invalidate the palette
-					dirtyPalette = true;
+				const unsigned char changed = value ^ PPUMASK;
+				PPUMASK = value;
+
+				if (changed & (PPUMASK_GRAYSCALE | PPUMASK_EMPHRED | PPUMASK_EMPHGREEN | PPUMASK_EMPHBLUE)) {
+					// grayscale or emphasis bits changed, every combination is already resolved
+					selectPaletteBank();
 				}
 
-				PPUMASK = value;
+				if (changed & (PPUMASK_SHOWLEFTBG | PPUMASK_SHOWLEFTOBJ)) {
+					// left column clipping is a renderer specialization
+					updateRenderScanline();
+				}
 			}
 			break;
 		case 0x02:  
@@ -204,6 +264,7 @@ void nes_ppu::writeReg(unsigned int regNum, unsigned char value) {
 			if (value != oam[OAMADDR]) {
 				oam[OAMADDR] = value;
 				dirtyOAM = true;
+				dirtyVideoMemory = true;
 			}
 			OAMADDR++;	// writes to OAM data increment the OAM address
 			memoryMap[4] = oam[OAMADDR];
@@ -253,8 +314,6 @@ void nes_ppu::writeReg(unsigned int regNum, unsigned char value) {
 			unsigned int address = ((ADDRHI << 8) | ADDRLO) & 0x3FFF;
 
 			if (address >= 0x3F00) {
-				// dirty palette
-				dirtyPalette = true;
 				value = value & 0x3F; // mask palette values
 			}
 
@@ -265,6 +324,11 @@ void nes_ppu::writeReg(unsigned int regNum, unsigned char value) {
 
 			// address will be incremented after the instruction due to latching
 			*resolveMemoryAddress(address, false) = value;
+			dirtyVideoMemory = true;
+
+			if (address >= 0x3F00) {
+				updateWorkingPalette(address);
+			}
 
 #if TRACE_DEBUG
 			if (address - ((PPUCTRL & PPUCTRL_VRAMINC) ? 32 : 1) == ppuWriteBreakpoint) {
@@ -281,6 +345,8 @@ void nes_ppu::writeReg(unsigned int regNum, unsigned char value) {
 }
 
 void nes_ppu::oamDMA(unsigned int addr) {
+	catchUp();
+
 	// perform the oam DMA
 	for (int i = 0; i < 256; i++, addr++) {
 		oam[i] = mainCPU.read(addr);
@@ -292,6 +358,7 @@ void nes_ppu::oamDMA(unsigned int addr) {
 	}
 
 	dirtyOAM = true;
+	dirtyVideoMemory = true;
 	mainCPU.clocks += 513 + (mainCPU.clocks & 1);
 }
 
@@ -306,14 +373,12 @@ void nes_ppu::fastSprite0(bool bValidBackground) {
 
 	if (oam[2] & OAMATTR_VFLIP) yCoord = (spriteSize - 1) - yCoord;
 
-	unsigned char* patternTable = chrPages[((spriteSize == 8 && (PPUCTRL & PPUCTRL_OAMTABLE)) ? 1 : 0)];
-
 	// determine tile index
 	unsigned char* tile;
 	if (spriteSize == 16) {
-		tile = chrPages[oam[1] & 1] + ((oam[1] & 0xFE) << 4) + ((yCoord & 8) << 1) + (yCoord & 7);
+		tile = chrTile(oam[1] & 1, oam[1] & 0xFE) + ((yCoord & 8) << 1) + (yCoord & 7);
 	} else {
-		tile = patternTable + (oam[1] << 4) + yCoord;
+		tile = chrTile((PPUCTRL & PPUCTRL_OAMTABLE) ? 1 : 0, oam[1]) + yCoord;
 	}
 
 	// interleave the bit planes and assign to char buffer (only unmapped pixels)
@@ -385,14 +450,76 @@ void nes_ppu::fastOAMLatchCheck() {
 	}
 }
 
-// clocks per scanline formula: (341 / 3) + (scanline % 3 != 0 ? 1 : 0) for NTSC;
-char scanlineClocks[245];
+// once per real frame after it ends: hotkeys, input and the state features driven by them
+static void HandleFrameKeys() {
+	ScopeTimer::ReportFrame();
+
+	bool keyDown_fast(unsigned char keyCode);
+	if (keyDown_fast(48)) // Menu
+	{
+		extern bool shouldExit;
+		shouldExit = true;
+		while (keyDown_fast(48)) {}
+	}
+
+#if DEBUG
+	if (keyDown_fast(69)) // F2
+	{
+		// bank miss cost and prefetch accuracy go on the last row of the timings
+		nesCart.prefetcher.report();
+		ScopeTimer::DisplayTimes();
+	}
+#endif
+
+	if (keyDown_fast(10)) // AC/ON
+	{
+		nesFrontend.ResetPressed();
+	}
+
+	input_cacheKeys();
+
+	if (nesSettings.CheckCachedKey(NES_SAVESTATE)) // F3 in simulator, 'S" on device
+	{
+		nesCart.SaveState();
+		nesCart.RebuildFileBlocks();
+	}
+
+	if (nesSettings.CheckCachedKey(NES_LOADSTATE)) // F4 in simulator, 'L' on device
+	{
+		nesCart.LoadState();
+	}
+
+	// rewind history (steps back instead of capturing while its key is held)
+	nesRewind.frame();
+
+#if CAPTURE_THREAD
+	if (keyDown_fast(39)) // F5 in simulator, starts or stops a capture of every frame
+	{
+#if PPU_RENDER_THREAD
+		// frames still drawing finish into the capture as it was
+		nesRenderThread.sync();
+#endif
+		if (nesCapture.isActive()) {
+			nesCapture.stop();
+		} else {
+			nesCapture.start(CAPTURE_VIDEO_Y4M, "nesizm_capture.y4m", "nesizm_capture.wav", true);
+		}
+		while (keyDown_fast(39)) {}
+	}
+#endif
+
+	// good time to synchronize cpu clock if we are getting too high (to avoid wraparound at 30 min of play)
+	mainCPU.syncClocks();
+}
 
 void nes_ppu::step() {
 	TIME_SCOPE_NAMED("PPU Step");
-	
-	// calculated once per frame on scanline 1
-	static bool skipFrame = false;
+	NES_LOCAL_MACHINE();
+
+	// a batch of disabled scanlines has fully elapsed
+	if (batchEndScanline) {
+		splitScanlineBatch();
+	}
 
 	// cpu time for next scanline
 	DebugAssert(scanline < 245);
@@ -432,24 +559,55 @@ void nes_ppu::step() {
 			skipFrame = (frameCounter & 7) != 0;
 		}
 
-		static bool bWasVolumeUp = false;
-		if (nesSettings.CheckCachedKey(NES_VOL_UP)) {
-			if (!bWasVolumeUp) {
-				sndVolumeUp();
-			}
-			bWasVolumeUp = true;
-		} else {
-			bWasVolumeUp = false;
+#if CAPTURE_THREAD
+		// captures that want every frame render the ones the display would skip
+		if (nesCapture.wantsEveryFrame()) {
+			skipFrame = false;
 		}
+#endif
+
+#if TARGET_WINSIM
+		// headless frames are only rendered when one is asked for
+		bHeadlessFrame = false;
+		if (nesHeadless.bActive) {
+			skipFrame = !nesHeadless.bFrameRequested;
+			bHeadlessFrame = skipFrame;
+			nesHeadless.bFrameRequested = false;
+			nesHeadless.beginFrame();
+		}
+#endif
 
-		static bool bWasVolumeDown = false;
-		if (nesSettings.CheckCachedKey(NES_VOL_DOWN)) {
-			if (!bWasVolumeDown) {
-				sndVolumeDown();
+		if (bSuppressVideo) {
+			skipFrame = true;
+		}
+
+		// the volume keys belong to the player, machines fed external input leave them (and the audio thread) alone
+		if (!bExternalInput) {
+			if (nesSettings.CheckCachedKey(NES_VOL_UP)) {
+				if (!bWasVolumeUp) {
+#if APU_AUDIO_THREAD
+					nesAudioThread.volumeUp();
+#else
+					sndVolumeUp();
+#endif
+				}
+				bWasVolumeUp = true;
+			} else {
+				bWasVolumeUp = false;
+			}
+
+			if (nesSettings.CheckCachedKey(NES_VOL_DOWN)) {
+				if (!bWasVolumeDown) {
+#if APU_AUDIO_THREAD
+					nesAudioThread.volumeDown();
+#else
+					sndVolumeDown();
+#endif
+				}
+				bWasVolumeDown = true;
+			} else {
+				bWasVolumeDown = false;
 			}
-			bWasVolumeDown = true;
-		} else {
-			bWasVolumeDown = false;
 		}
 
 		// clear vblank and sprite 0 flag
@@ -469,7 +627,11 @@ void nes_ppu::step() {
 		// non-resolved but active scanline (may cause sprite 0 collision)
 		if (canSprite0Hit()) {
 			if (!skipFrame) {
+				// deferred scanlines first, a latch tripped in this render commits CHR banks and would draw them mid render
+				catchUp();
 				renderScanline(*this);
+			} else if (bHeadlessFrame) {
+				headlessScanline();
 			} else {
 				fastSprite0(false);
 			}
@@ -490,13 +652,29 @@ void nes_ppu::step() {
 
 		// rendered scanline
 		if (!skipFrame) {
-			renderScanline(*this);
-
-			if (dirtyPalette) {
-				resolveWorkingPalette();
+#if PPU_RENDER_THREAD
+			if (nesRenderThread.isActive()) {
+				// drawn on the render thread, only sprite 0 needs a local background render
+				nesRenderThread.postScanline(*this);
+				if (canSprite0HitScanline()) {
+					renderScanline(*this);
+				} else {
+					skipScanlineRender();
+				}
+			} else
+#endif
+			if (PPU_CATCHUP_RENDER && !canSprite0HitScanline()) {
+				// nothing observable by the CPU happens on this scanline, so defer it
+				if (numPendingScanlines == 0) {
+					firstPendingScanline = scanline;
+				}
+				numPendingScanlines++;
+			} else {
+				catchUp();
+				renderVisibleScanline();
 			}
-
-			resolveScanline(SCROLLX & 15);
+		} else if (bHeadlessFrame) {
+			headlessScanline();
 		} else if (canSprite0Hit()) {
 			fastSprite0(false);
 		}
@@ -512,7 +690,11 @@ void nes_ppu::step() {
 		// non-resolved scanline
 		if (canSprite0Hit()) {
 			if (!skipFrame) {
+				// deferred scanlines first, a latch tripped in this render commits CHR banks and would draw them mid render
+				catchUp();
 				renderScanline(*this);
+			} else if (bHeadlessFrame) {
+				headlessScanline();
 			} else {
 				fastSprite0(false);
 			}
@@ -522,6 +704,9 @@ void nes_ppu::step() {
 			nesCart.scanlineClock();
 		}
 	} else if (scanline == 241) {
+		// vblank, finish any deferred scanlines before the frame is presented
+		catchUp();
+
 		// good time to reset scroll
 		scrollY = 0;
 
@@ -538,6 +723,10 @@ void nes_ppu::step() {
 
 		// update background color if we are in that BG mode
 		if (nesSettings.GetSetting(ST_Background) == 2 && skipFrame == false) {
+			if (dirtyPalette) {
+				resolveWorkingPalette();
+			}
+
 			unsigned short curColor = workingPalette[0];
 			if (curColor != currentBGColor) {
 				currentBGColor = curColor;
@@ -560,69 +749,54 @@ void nes_ppu::step() {
 		// update the FPS counter
 		if (nesSettings.GetSetting(ST_ShowFPS) && skipFrame == false) {
 			// track fps in 8 half second buckets
-			static int32 frameBuckets[8] = { 0, 0, 0, 0, 0, 0, 0, 0};
-			static int32 curBucket = 0;
-			static int32 lastTicks = 0;
-			frameBuckets[curBucket]++;
+			fpsBuckets[fpsBucket]++;
 
 			int32 ticks = RTC_GetTicks();
-			if (ticks % 64 < lastTicks) {
-				curBucket = (curBucket + 1) % 8;
+			if (ticks % 64 < fpsLastTicks) {
+				fpsBucket = (fpsBucket + 1) % 8;
 				int totalFrames = 2; // rounding
 				for (int x = 0; x < 8; x++) {
-					totalFrames += frameBuckets[x];
+					totalFrames += fpsBuckets[x];
 				}
 				totalFrames /= 4; // calculated FPS
 				if (totalFrames < 1) totalFrames = 1;
 				if (totalFrames > 240) totalFrames = 240;
 				renderFPS(totalFrames);
-				frameBuckets[curBucket] = 0;
+				fpsBuckets[fpsBucket] = 0;
 			}
-			lastTicks = ticks % 64;
+			fpsLastTicks = ticks % 64;
 		}
 
-		finishFrame(skipFrame);
-
-		ScopeTimer::ReportFrame();
-
-		frameCounter++;
-
-		bool keyDown_fast(unsigned char keyCode);
-		if (keyDown_fast(48)) // Menu
-		{
-			extern bool shouldExit;
-			shouldExit = true;
-			while (keyDown_fast(48)) {}
+		if (bSuppressVideo || bHeadlessFrame) {
+			// not shown, and frame pacing is left to the frame that is
 		}
-
-#if DEBUG
-		if (keyDown_fast(69)) // F2
-		{
-			ScopeTimer::DisplayTimes();
+#if PPU_RENDER_THREAD
+		else if (nesRenderThread.isActive()) {
+			// presented by the render thread once it has drawn the frame
+			if (!skipFrame) {
+				nesRenderThread.postFrameEnd(*this);
+			}
+		} else {
+			finishFrame(skipFrame);
+		}
+#else
+		else {
+			finishFrame(skipFrame);
 		}
 #endif
 
-		if (keyDown_fast(10)) // AC/ON
-		{
-			nesFrontend.ResetPressed();
-		}
+		frameCounter++;
 
-		input_cacheKeys();
+		// frozen RAM cheats
+		nesCheats.applyRAM();
 
-		if (nesSettings.CheckCachedKey(NES_SAVESTATE)) // F3 in simulator, 'S" on device
-		{
-			nesCart.SaveState();
-			nesCart.BuildFileBlocks();
-		}
+		bFrameEnded = true;
 
-		if (nesSettings.CheckCachedKey(NES_LOADSTATE)) // F4 in simulator, 'L' on device
-		{
-			nesCart.LoadState();
+		// frames run ahead leave this to the real frame, and external input leaves it to the caller (clock sync included)
+		if (!bRunningAhead && !bExternalInput) {
+			HandleFrameKeys();
 		}
 
-		// good time to synchronize cpu clock if we are getting too high (to avoid wraparound at 30 min of play)
-		mainCPU.syncClocks();
-
 	} else if (scanline == 243) {
 		// frame is over, don't run until scanline 262, so add 18 scanlines worth (2047 extra clocks!)
 		if (nesCart.isPAL == 0) {
@@ -646,9 +820,149 @@ void nes_ppu::step() {
 		}
 	}
 
+#if PPU_CATCHUP_RENDER
+	// with rendering disabled, nothing on the rest of the visible scanlines is observable until a register write
+	if (scanline >= 2 && scanline < 240 && (PPUMASK & (PPUMASK_SHOWBG | PPUMASK_SHOWOBJ)) == 0 &&
+		nesCart.scanlineClock == NULL && !nesCart.bDirtyChrBanks) {
+		batchScanlines(skipFrame);
+	}
+#endif
+
 	scanline++;
 
-	condSoundUpdate();
+#if !APU_AUDIO_THREAD
+	if (!bRunningAhead) {
+		condSoundUpdate();
+	}
+#endif
+}
+
+void nes_ppu::batchScanlines(bool bSkippedFrame) {
+	// advance through scanline 240 in one step, stopping before vblank
+	batchStartScanline = scanline + 1;
+	batchStartClock = mainCPU.ppuClocks;
+	batchEndScanline = 241;
+	batchSkipFrame = bSkippedFrame;
+
+	while (scanline + 1 < batchEndScanline) {
+		scanline++;
+		mainCPU.ppuClocks += scanlineClocks[scanline];
+
+		if (!bSkippedFrame && scanline >= 9 && scanline < 233) {
+#if PPU_RENDER_THREAD
+			if (nesRenderThread.isActive()) {
+				// scroll side effects are applied once the batch is split
+				nesRenderThread.postScanline(*this);
+				continue;
+			}
+#endif
+			if (numPendingScanlines == 0) {
+				firstPendingScanline = scanline;
+			}
+			numPendingScanlines++;
+		}
+	}
+}
+
+void nes_ppu::splitScanlineBatch() {
+	NES_LOCAL_MACHINE();
+
+	// find the first batched scanline the CPU hasn't actually reached yet
+	unsigned int line = batchStartScanline;
+	unsigned int clock = batchStartClock;
+	while (line < batchEndScanline && int32(mainCPU.clocks - clock) >= 0) {
+		clock += scanlineClocks[line];
+		line++;
+	}
+
+	batchEndScanline = 0;
+
+	// drop the deferred scanlines that haven't happened yet
+	if (numPendingScanlines) {
+		if (line <= firstPendingScanline) {
+			numPendingScanlines = 0;
+		} else if (firstPendingScanline + numPendingScanlines > line) {
+			numPendingScanlines = line - firstPendingScanline;
+		}
+	}
+
+#if PPU_RENDER_THREAD
+	if (nesRenderThread.isActive() && causeDecrement && !batchSkipFrame) {
+		// the scroll decrement for each visible scanline that did elapse (unreached ones are posted again later)
+		for (unsigned int i = batchStartScanline; i < line; i++) {
+			if (i >= 9 && i < 233) {
+				scrollY--;
+			}
+		}
+	}
+#endif
+
+	if (line < scanline) {
+		// resume per scanline stepping from here
+		scanline = line;
+		mainCPU.ppuClocks = clock;
+		if (mainCPU.nextClocks > clock) {
+			mainCPU.nextClocks = clock;
+		}
+	}
+}
+
+void nes_ppu::renderVisibleScanline() {
+	renderScanline(*this);
+
+	if (dirtyPalette) {
+		resolveWorkingPalette();
+	}
+
+	resolveScanline(SCROLLX & 15);
+}
+
+void nes_ppu::skipScanlineRender() {
+	// the scroll decrement a background render applies when background rendering is disabled mid frame
+	if (causeDecrement) {
+		int line = scanline - 1 + (scrollY < 240 ? scrollY : scrollY - 256);
+		const bool wrapsNegative = (mirror == nes_mirror_type::MT_VERTICAL || mirror == nes_mirror_type::MT_4PANE);
+		if ((PPUMASK & PPUMASK_SHOWBG) == 0 || (!wrapsNegative && line < 0)) {
+			scrollY--;
+		}
+	}
+}
+
+void nes_ppu::headlessScanline() {
+#if TARGET_WINSIM
+	// a hashed frame renders all of the displayed scanlines
+	if (nesHeadless.bHashing && scanline >= 9 && scanline < 233) {
+		renderScanline(*this);
+		nesHeadless.hashScanline(*this);
+		return;
+	}
+#endif
+
+	// the background is only needed behind sprite 0 and for the CHR latches its tiles trip, anything else of the
+	// render is invisible to the CPU
+	if (canSprite0HitScanline() || nesCart.renderLatch) {
+		renderScanline(*this);
+	} else {
+		skipScanlineRender();
+	}
+}
+
+void nes_ppu::renderPendingScanlines() {
+	TIME_SCOPE();
+
+	// cleared first so state changes from within the renderer (MMC2/4 latches) don't recurse
+	const unsigned int curScanline = scanline;
+	unsigned int numScanlines = numPendingScanlines;
+	numPendingScanlines = 0;
+
+	for (scanline = firstPendingScanline; numScanlines; numScanlines--, scanline++) {
+		renderVisibleScanline();
+#if !APU_AUDIO_THREAD
+		condSoundUpdate();
+#endif
+	}
+
+	scanline = curScanline;
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -746,8 +1060,6 @@ extern "C" {
 }
 #endif
 
-// mask of which sprites to check per scanline (bit 0 = sprites 56-63, bit 1 = sprites 48-55, and so on)
-uint8 fetchMask[272];
 template<int spriteSize>
 void nes_ppu::resolveOAM() {
 	// rebuild the fetch mask
@@ -770,7 +1082,12 @@ void nes_ppu::resolveOAM() {
 }
 
 #define PRIORITY_PIXEL 0x40
-template<bool sprite16,int spriteSize>
+
+// left column clipping the renderers are specialized on (PPUMASK left column bits that are off)
+#define CLIP_LEFT_BG 1
+#define CLIP_LEFT_OBJ 2
+
+template<bool sprite16,int spriteSize,int clipLeft>
 void static renderOAM(nes_ppu& ppu) {
 	if (ppu.dirtyOAM) {
 		ppu.resolveOAM<spriteSize>();
@@ -783,25 +1100,24 @@ void static renderOAM(nes_ppu& ppu) {
 
 	int baseX = ppu.SCROLLX & 15;
 
-	if ((ppu.PPUMASK & PPUMASK_SHOWLEFTBG) == 0) {
+	if (clipLeft & CLIP_LEFT_BG) {
 		for (int i = 0; i < 8; i++) {
 			ppu.scanlineBuffer[baseX+i] = 0;
 		}
 	}
 
-	if ((ppu.PPUMASK & PPUMASK_SHOWOBJ) && fetchMask[ppu.scanline]) {
+	if ((ppu.PPUMASK & PPUMASK_SHOWOBJ) && ppu.fetchMask[ppu.scanline]) {
 		// render objects to separate buffer
 		int numSprites = 0;
 		unsigned char* curObj = &ppu.oam[252];
 		unsigned int patternOffset = ((!sprite16 && (ppu.PPUCTRL & PPUCTRL_OAMTABLE)) ? 1 : 0);
-		unsigned char* patternTable = ppu.chrPages[patternOffset];
-		static uint8 spriteMask[33] = { 0 };
+		uint8* spriteMask = ppu.spriteMask;
 		int minSpriteMask = 32;
 		int maxSpriteMask = 0;
 		int scanlineOffset = ppu.scanline - 2;
 
 		// mask out 8 at a time
-		for (int b = fetchMask[ppu.scanline]; b; b = b >> 1) {
+		for (int b = ppu.fetchMask[ppu.scanline]; b; b = b >> 1) {
 			if (!(b & 1)) {
 				curObj -= 32;
 				continue;
@@ -817,9 +1133,9 @@ void static renderOAM(nes_ppu& ppu) {
 					// determine tile index
 					unsigned char* tile;
 					if (sprite16) {
-						tile = ppu.chrPages[curObj[1] & 1] + ((curObj[1] & 0xFE) << 4) + ((yCoord & 8) << 1) + (yCoord & 7);
+						tile = ppu.chrTile(curObj[1] & 1, curObj[1] & 0xFE) + ((yCoord & 8) << 1) + (yCoord & 7);
 					} else {
-						tile = patternTable + (curObj[1] << 4) + yCoord;
+						tile = ppu.chrTile(patternOffset, curObj[1]) + yCoord;
 					}
 
 					unsigned int x = curObj[3];
@@ -830,7 +1146,7 @@ void static renderOAM(nes_ppu& ppu) {
 					uint16 tileMask = (tile0 | tile8);
 					unsigned int bitPlane = (MortonTable[tile0] | (MortonTable[tile8] << 1)) << 1;
 					unsigned int palette = (((curObj[2] & 3) << 2) + (curObj[2] & OAMATTR_PRIORITY) + 16) << 1;
-					unsigned char* buffer = oamScanlineBuffer + x;
+					unsigned char* buffer = ppu.oamScanlineBuffer + x;
 
 					if (curObj[2] & OAMATTR_HFLIP) {
 											if (bitPlane & 6) buffer[0] = palette | (bitPlane & 6);
@@ -868,9 +1184,9 @@ void static renderOAM(nes_ppu& ppu) {
 
 		if (numSprites) {
 			// mask left 8 pixels
-			if ((ppu.PPUMASK & PPUMASK_SHOWLEFTOBJ) == 0) {
+			if (clipLeft & CLIP_LEFT_OBJ) {
 				for (int i = 0; i < 8; i++) {
-					oamScanlineBuffer[i] = 0;
+					ppu.oamScanlineBuffer[i] = 0;
 				}
 			}
 
@@ -880,7 +1196,7 @@ void static renderOAM(nes_ppu& ppu) {
 			for (int sprite = minSpriteMask; sprite <= maxSpriteMask; sprite++) {
 				if (spriteMask[sprite]) {
 					unsigned char* targetPixel = targetPixelBase + sprite * 8;
-					unsigned char* oamPixel = &oamScanlineBuffer[sprite *8];
+					unsigned char* oamPixel = &ppu.oamScanlineBuffer[sprite *8];
 					for (int b = spriteMask[sprite]; b; b >>= 1, oamPixel++, targetPixel++) {
 						if (b & 1) {
 							if ((*oamPixel & PRIORITY_PIXEL) == 0 || (*targetPixel & 6) == 0) {
@@ -896,20 +1212,6 @@ void static renderOAM(nes_ppu& ppu) {
 	}
 }
 
-void nes_ppu::doOAMRender() {
-	TIME_SCOPE();
-
-	if (canSprite0Hit()) {
-		fastSprite0(true);
-	}
-
-	if ((PPUCTRL & PPUCTRL_SPRSIZE) == 0) {
-		renderOAM<false, 8>(*this);
-	} else {
-		renderOAM<true, 16>(*this);
-	}
-}
-
 void nes_ppu::resolveOAMExternal() {
 	if ((PPUCTRL & PPUCTRL_SPRSIZE) == 0) {
 		resolveOAM<8>();
@@ -925,409 +1227,159 @@ inline void UnrollPalette(uint32& palette) {
 	palette = palette | (palette << 16);
 }
 
-void nes_ppu::renderScanline_SingleMirror(nes_ppu& ppu) {
-	TIME_SCOPE_NAMED(scanline_single);
+// nametable layouts the scanline renderer is specialized on (derived from the mirror type)
+enum RenderLayout {
+	RL_SINGLE,
+	RL_SINGLE_UPPER,
+	RL_HORZ,
+	RL_VERT,
+	RL_4PANE,
+};
 
-	DebugAssert(ppu.scanline >= 1 && ppu.scanline <= 240);
-	DebugAssert(nesCart.renderLatch == NULL);
+// renders two adjacent tiles (16 pixels) sharing a palette, handling MMC2/4 latches if present. chrTable is the
+// background pattern table's 4 pages, read per tile so latch switches take effect after the latching tile
+template<bool hasLatch>
+FORCE_INLINE static void renderTilePair(nes_ppu& ppu, uint8*& buffer, unsigned char* const* chrTable, unsigned int chrOffset, int chr1, int chr2, uint32 palette, int& lastChr) {
+	int chrSig = (chr1 << 16) | (chr2 << 8) | palette;
 
-	int line = ppu.scanline - 1;
-	if (ppu.scrollY < 240) {
-		line += ppu.scrollY;
-	} else {
-		// "negative scroll" which we'll just skip the top lines for
-		line += ppu.scrollY - 256;
+	if (chrSig == lastChr) {
+		CopyOver16(buffer - 16);
+		buffer += 16;
+		return;
 	}
 
-	if ((ppu.PPUMASK & PPUMASK_SHOWBG) && line >= 0) {
-		int tileLine = line >> 3;
-
-		// determine base addresses
-		unsigned char* nameTable;
-		unsigned char* attr;
-		unsigned int chrOffset = (line & 7);
-		unsigned char* patternTable = ppu.chrPages[(ppu.PPUCTRL & PPUCTRL_BGDTABLE) >> 4] + chrOffset;
+	UnrollPalette(palette);
+	lastChr = chrSig;
 
-		if (tileLine >= 30) {
-			tileLine -= 30;
-		}
-		
-		if (ppu.mirror == nes_mirror_type::MT_SINGLE) {
-			nameTable = &ppu.nameTables[0].table[tileLine << 5];
-			attr = &ppu.nameTables[0].attr[(tileLine >> 2) << 3];
-		} else {
-			DebugAssert(ppu.mirror == nes_mirror_type::MT_SINGLE_UPPER);
-			nameTable = &ppu.nameTables[1].table[tileLine << 5];
-			attr = &ppu.nameTables[1].attr[(tileLine >> 2) << 3];
+	if (hasLatch) {
+		// latch tiles are rendered with the previous bank (page looked up first), switch takes effect after
+		unsigned char* page = chrTable[chr1 >> 6] + chrOffset;
+		if (chr1 == 0xFD || chr1 == 0xFE) {
+			nesCart.renderLatch((chr1 << 4) + chrOffset + 8 + ((ppu.PPUCTRL & PPUCTRL_BGDTABLE) << 8));
 		}
 
-		// pre-build attribute table lookup into one big 32 bit int
-		// this is done backwards so the value is easily popped later
-		int attrX = (ppu.SCROLLX >> 5) & 7;
-		int attrShift = (tileLine & 2) << 1;	// 4 bit shift for bottom row of attribute
-		unsigned int attrPalette = 0;
-		for (int loop = 0; loop < 8; loop++) {
-			attrPalette <<= 4;
-			attrPalette |= ((attr[attrX] >> attrShift) & 0xF);
-			attrX = (attrX + 7) & 7;
-		}
+		RenderToScanline(page, (chr1 & 0x3F) << 4, palette, buffer);
+		buffer += 8;
 
-		if ((ppu.SCROLLX & 0x10) == 0) {
-			attrPalette = (attrPalette << 6) | (attrPalette >> 26);
-		} else {
-			attrPalette = (attrPalette << 4) | (attrPalette >> 28);
+		page = chrTable[chr2 >> 6] + chrOffset;
+		if (chr2 == 0xFD || chr2 == 0xFE) {
+			nesCart.renderLatch((chr2 << 4) + chrOffset + 8 + ((ppu.PPUCTRL & PPUCTRL_BGDTABLE) << 8));
 		}
 
-		// we render 16 pixels at a time (easy attribute table lookup), 17 times and clip
-		uint8* buffer = ppu.scanlineBuffer;
-		int tileX = (ppu.SCROLLX >> 4) * 2;	// always start on an even numbered tile
-		int lastChr = -1;
-
-		for (int loop = 0; loop < 17; loop++) {
-			// grab and rotate palette selection
-			uint32 palette = (attrPalette & 0x0C);
-			attrPalette = (attrPalette >> 2) | (attrPalette << 30);
-
-			// keep tileX mirroring
-			tileX &= 0x1F;
-
-			int chr1 = nameTable[tileX++];
-			int chr2 = nameTable[tileX++];
-			int chrSig = (chr1 << 16) | (chr2 << 8) | palette;
-
-			if (chrSig == lastChr) {
-				CopyOver16(buffer - 16);
-				buffer += 16;
-			} else {
-				UnrollPalette(palette);
-				lastChr = chrSig;
-
-				RenderToScanline(patternTable, chr1 << 4, palette, buffer);
-				buffer += 8;
-				RenderToScanline(patternTable, chr2 << 4, palette, buffer);
-				buffer += 8;
-			}
-		}
+		RenderToScanline(page, (chr2 & 0x3F) << 4, palette, buffer);
+		buffer += 8;
 	} else {
-		for (int i = 0; i < 288; i++) {
-			ppu.scanlineBuffer[i] = 0;
-		}
-		if (ppu.causeDecrement) {
-			ppu.scrollY--;
-		}
+		RenderToScanline(chrTable[chr1 >> 6] + chrOffset, (chr1 & 0x3F) << 4, palette, buffer);
+		buffer += 8;
+		RenderToScanline(chrTable[chr2 >> 6] + chrOffset, (chr2 & 0x3F) << 4, palette, buffer);
+		buffer += 8;
 	}
-
-	ppu.doOAMRender();
 }
 
-void nes_ppu::renderScanline_HorzMirror(nes_ppu& ppu) {
-	TIME_SCOPE_NAMED(scanline_horz);
+// main scanline renderer, specialized on every input that would otherwise be a branch per tile or per sprite
+template<int layout, bool hasLatch, bool sprite16, int clipLeft>
+static void renderScanline_Tmpl(nes_ppu& ppu) {
+	TIME_SCOPE_NAMED(scanline_render);
 
 	DebugAssert(ppu.scanline >= 1 && ppu.scanline <= 240);
+	DebugAssert(hasLatch == (nesCart.renderLatch != NULL) || layout == RL_SINGLE || layout == RL_SINGLE_UPPER || layout == RL_4PANE);
 
 	int line = ppu.scanline - 1;
 	if (ppu.scrollY < 240) {
 		line += ppu.scrollY;
 	} else {
-		// "negative scroll" which we'll just skip the top lines for
+		// "negative scroll" which we'll just skip the top lines for (horizontal layouts only, vertical wraps)
 		line += ppu.scrollY - 256;
 	}
 
-	if ((ppu.PPUMASK & PPUMASK_SHOWBG) && line >= 0) {
-		int tileLine = line >> 3;
-
-		// determine base addresses
-		unsigned char* nameTable;
-		unsigned char* attr;
-		unsigned int chrOffset = (line & 7);
-		unsigned char* patternTable = ppu.chrPages[(ppu.PPUCTRL & PPUCTRL_BGDTABLE) >> 4] + chrOffset;
-
-		if (ppu.flipY) {
-			tileLine += 30;
-			if (tileLine >= 60) tileLine -= 60;
-		}
-
-		if (tileLine < 30) {
-			nameTable = &ppu.nameTables[0].table[tileLine << 5];
-			attr = &ppu.nameTables[0].attr[(tileLine >> 2) << 3];
-		} else {
-			tileLine -= 30;
-			nameTable = &ppu.nameTables[1].table[tileLine << 5];
-			attr = &ppu.nameTables[1].attr[(tileLine >> 2) << 3];
-		}
-
-		// pre-build attribute table lookup into one big 32 bit int
-		// this is done backwards so the value is easily popped later
-		int attrX = (ppu.SCROLLX >> 5) & 7;
-		int attrShift = (tileLine & 2) << 1;	// 4 bit shift for bottom row of attribute
-		unsigned int attrPalette = 0;
-		for (int loop = 0; loop < 8; loop++) {
-			attrPalette <<= 4;
-			attrPalette |= ((attr[attrX] >> attrShift) & 0xF);
-			attrX = (attrX + 7) & 7;
-		}
-
-		if ((ppu.SCROLLX & 0x10) == 0) {
-			attrPalette = (attrPalette << 6) | (attrPalette >> 26);
-		} else {
-			attrPalette = (attrPalette << 4) | (attrPalette >> 28);
-		}
-
-		// we render 16 pixels at a time (easy attribute table lookup), 17 times and clip
-		uint8* buffer = ppu.scanlineBuffer;
-		int tileX = (ppu.SCROLLX >> 4) * 2;	// always start on an even numbered tile
-
-		// MMC2/4 too branch here for faster code:
-		if (nesCart.renderLatch) {
-			int lastChr = -1;
-			for (int loop = 0; loop < 17; loop++) {
-				// grab and rotate palette selection
-				uint32 palette = (attrPalette & 0x0C);
-				attrPalette = (attrPalette >> 2) | (attrPalette << 30);
-
-				// keep tileX mirroring
-				tileX &= 0x1F;
-
-				int chr1 = nameTable[tileX++];
-				int chr2 = nameTable[tileX++];
-				int chrSig = (chr1 << 16) | (chr2 << 8) | palette;
-
-				if (chrSig == lastChr) {
-					CopyOver16(buffer - 16);
-					buffer += 16;
-				} else {
-					UnrollPalette(palette);
-					lastChr = chrSig;
-
-					RenderToScanline(patternTable, chr1 << 4, palette, buffer);
-					if (chr1 >= 0xFD && nesCart.renderLatch) {
-						nesCart.renderLatch((chr1 << 4) + chrOffset + 8 + ((ppu.PPUCTRL & PPUCTRL_BGDTABLE) << 8));
-						patternTable = ppu.chrPages[(ppu.PPUCTRL & PPUCTRL_BGDTABLE) >> 4] + chrOffset;
-					}
-					buffer += 8;
-					RenderToScanline(patternTable, chr2 << 4, palette, buffer);
-					if (chr2 >= 0xFD && nesCart.renderLatch) {
-						nesCart.renderLatch((chr2 << 4) + chrOffset + 8 + ((ppu.PPUCTRL & PPUCTRL_BGDTABLE) << 8));
-						patternTable = ppu.chrPages[(ppu.PPUCTRL & PPUCTRL_BGDTABLE) >> 4] + chrOffset;
-					}
-					buffer += 8;
-				}
-			}
-		} else {
-			int lastChr = -1;
-
-			for (int loop = 0; loop < 17; loop++) {
-				// grab and rotate palette selection
-				uint32 palette = (attrPalette & 0x0C);
-				attrPalette = (attrPalette >> 2) | (attrPalette << 30);
-
-				// keep tileX mirroring
-				tileX &= 0x1F;
-
-				int chr1 = nameTable[tileX++];
-				int chr2 = nameTable[tileX++];
-				int chrSig = (chr1 << 16) | (chr2 << 8) | palette;
-
-				if (chrSig == lastChr) {
-					CopyOver16(buffer - 16);
-					buffer += 16;
-				} else {
-					UnrollPalette(palette);
-					lastChr = chrSig;
-
-					RenderToScanline(patternTable, chr1 << 4, palette, buffer);
-					buffer += 8;
-					RenderToScanline(patternTable, chr2 << 4, palette, buffer);
-					buffer += 8;
-				}
-			}
-		}
-	} else {
-		for (int i = 0; i < 288; i++) {
-			ppu.scanlineBuffer[i] = 0;
-		}
-		if (ppu.causeDecrement) {
-			ppu.scrollY--;
-		}
-	}
-
-	ppu.doOAMRender();
-}
-
-template<bool hasLatch, bool is4Pane>
-static void renderScanline_VertMirror_Latched(nes_ppu& ppu) {
-	DebugAssert(ppu.scanline >= 1 && ppu.scanline <= 240);
-	if (ppu.PPUMASK & PPUMASK_SHOWBG) {
-		int line = ppu.scanline - 1;
-
-		if (ppu.scrollY < 240) {
-			line += ppu.scrollY;
-		} else {
-			// "negative scroll" which we'll just skip the top lines for
-			line += ppu.scrollY - 256;
-		}
+	const bool wrapsNegative = (layout == RL_VERT || layout == RL_4PANE);
 
+	if ((ppu.PPUMASK & PPUMASK_SHOWBG) && (wrapsNegative || line >= 0)) {
 		int tileLine = line >> 3;
+		int scrollX = ppu.SCROLLX;
 
+		// determine the nametable we start in, and the one we continue into after 32 tiles
 		int nameTableIndex = 0;
-		if (is4Pane) {
-			if (tileLine >= 60) {
-				tileLine -= 60;
-			}
-			else if (tileLine < 0) {
-				tileLine += 60;
-			}
+		int nextNameTableIndex = 0;
+		if (layout == RL_SINGLE || layout == RL_SINGLE_UPPER) {
 			if (tileLine >= 30) {
-				nameTableIndex = 2;
 				tileLine -= 30;
 			}
-			if (ppu.PPUCTRL & PPUCTRL_FLIPYTBL) {
-				nameTableIndex = nameTableIndex ^ 2;
+			nameTableIndex = (layout == RL_SINGLE_UPPER) ? 1 : 0;
+			nextNameTableIndex = nameTableIndex;
+		} else if (layout == RL_HORZ) {
+			if (ppu.flipY) {
+				tileLine += 30;
+				if (tileLine >= 60) tileLine -= 60;
 			}
-		} else {
 			if (tileLine >= 30) {
 				tileLine -= 30;
-			} else if (tileLine < 0) {
-				tileLine += 30;
+				nameTableIndex = 1;
+			}
+			nextNameTableIndex = nameTableIndex;
+		} else {
+			if (layout == RL_4PANE) {
+				if (tileLine >= 60) {
+					tileLine -= 60;
+				} else if (tileLine < 0) {
+					tileLine += 60;
+				}
+				if (tileLine >= 30) {
+					nameTableIndex = 2;
+					tileLine -= 30;
+				}
+				if (ppu.PPUCTRL & PPUCTRL_FLIPYTBL) {
+					nameTableIndex = nameTableIndex ^ 2;
+				}
+			} else {
+				if (tileLine >= 30) {
+					tileLine -= 30;
+				} else if (tileLine < 0) {
+					tileLine += 30;
+				}
 			}
-		}
 
-		int scrollX = ppu.SCROLLX;
+			if (ppu.PPUCTRL & PPUCTRL_FLIPXTBL) scrollX += 256;
+			nameTableIndex += (((scrollX >> 4) * 2) & 0x20) >> 5;
+			nextNameTableIndex = nameTableIndex ^ 1;
+		}
 
 		// determine base addresses
-		unsigned char* nameTable;
-		unsigned char* attr;
 		int attrShift = (tileLine & 2) << 1;	// 4 bit shift for bottom row of attribute
 		unsigned int chrOffset = (line & 7);
-		unsigned char* patternTable = ppu.chrPages[(ppu.PPUCTRL & PPUCTRL_BGDTABLE) >> 4] + chrOffset;
-
-		if (ppu.PPUCTRL & PPUCTRL_FLIPXTBL) scrollX += 256;
+		unsigned char* const* chrTable = &ppu.chrPages[(ppu.PPUCTRL & PPUCTRL_BGDTABLE) >> 2];
+		unsigned char* nameTable = &ppu.nameTables[nameTableIndex].table[tileLine << 5];
+		unsigned char* attr = &ppu.nameTables[nameTableIndex].attr[(tileLine >> 2) << 3];
 
 		// we render 16 pixels at a time (easy attribute table lookup), 17 times and clip
 		uint8* buffer = ppu.scanlineBuffer;
-		int tileX = ((scrollX >> 4) * 2) & 0x3F;	// always start on an even numbered tile
-		nameTableIndex += (tileX & 0x20) >> 5;
-		
-		nameTable = &ppu.nameTables[nameTableIndex].table[tileLine << 5];
-		attr = &ppu.nameTables[nameTableIndex].attr[(tileLine >> 2) << 3];
+		int curTileX = ((scrollX >> 4) * 2) & 0x1F;	// always start on an even numbered tile
+		int lastChr = -1;
 
 		// render tileX up to the end of the current nametable
-		int curTileX = tileX & 0x1F;
-		int lastChr = -1;
 		while (curTileX < 32) {
-			// grab and rotate palette selection
-			bool hadLatch = false;
 			int attrPalette = (attr[(curTileX >> 2)] >> attrShift) >> (curTileX & 2);
-			uint32 palette = (attrPalette & 0x03) << 2;
-			
 			int chr1 = nameTable[curTileX++];
 			int chr2 = nameTable[curTileX++];
-			int chrSig = (chr1 << 16) | (chr2 << 8) | palette;
-
-			if (chrSig == lastChr) {
-				CopyOver16(buffer - 16);
-				buffer += 16;
-			} else {
-				UnrollPalette(palette);
-				lastChr = chrSig;
-
-				if (hasLatch) {
-					if (chr1 == 0xFD || chr1 == 0xFE) {
-						nesCart.renderLatch((chr1 << 4) + chrOffset + 8 + ((ppu.PPUCTRL & PPUCTRL_BGDTABLE) << 8));
-						hadLatch = true;
-					}
-
-					RenderToScanline(patternTable, chr1 << 4, palette, buffer);
-					buffer += 8;
-
-					if (hadLatch) {
-						patternTable = ppu.chrPages[(ppu.PPUCTRL & PPUCTRL_BGDTABLE) >> 4] + chrOffset;
-						hadLatch = false;
-					}
-
-					if (chr2 == 0xFD || chr2 == 0xFE) {
-						nesCart.renderLatch((chr2 << 4) + chrOffset + 8 + ((ppu.PPUCTRL & PPUCTRL_BGDTABLE) << 8));
-						hadLatch = true;
-					}
-
-					RenderToScanline(patternTable, chr2 << 4, palette, buffer);
-					buffer += 8;
-
-					if (hadLatch) {
-						patternTable = ppu.chrPages[(ppu.PPUCTRL & PPUCTRL_BGDTABLE) >> 4] + chrOffset;
-						hadLatch = false;
-					}
-				} else {
-					RenderToScanline(patternTable, chr1 << 4, palette, buffer);
-					buffer += 8;
-					RenderToScanline(patternTable, chr2 << 4, palette, buffer);
-					buffer += 8;
-				}
-			}
+			renderTilePair<hasLatch>(ppu, buffer, chrTable, chrOffset, chr1, chr2, (attrPalette & 0x03) << 2, lastChr);
 		}
 
-		// now render the other nametable until scanline is complete
+		// now render the next nametable until scanline is complete
 		curTileX = 0;
-		nameTableIndex = nameTableIndex ^ 1;
-		nameTable = &ppu.nameTables[nameTableIndex].table[tileLine << 5];
-		attr = &ppu.nameTables[nameTableIndex].attr[(tileLine >> 2) << 3];
+		nameTable = &ppu.nameTables[nextNameTableIndex].table[tileLine << 5];
+		attr = &ppu.nameTables[nextNameTableIndex].attr[(tileLine >> 2) << 3];
 		uint8* bufferEnd = ppu.scanlineBuffer + 16 * 17;
 
 		while (buffer < bufferEnd) {
-			// grab and rotate palette selection
-			bool hadLatch = false;
 			int attrPalette = (attr[(curTileX >> 2)] >> attrShift) >> (curTileX & 2);
-			uint32 palette = (attrPalette & 0x03) << 2;
-
 			int chr1 = nameTable[curTileX++];
 			int chr2 = nameTable[curTileX++];
-			int chrSig = (chr1 << 16) | (chr2 << 8) | palette;
-			
-			if (chrSig == lastChr) {
-				CopyOver16(buffer - 16);
-				buffer += 16;
-			} else {
-				UnrollPalette(palette);
-				lastChr = chrSig;
-
-				if (hasLatch) {
-					if (chr1 == 0xFD || chr1 == 0xFE) {
-						nesCart.renderLatch((chr1 << 4) + chrOffset + 8 + ((ppu.PPUCTRL & PPUCTRL_BGDTABLE) << 8));
-						hadLatch = true;
-					}
-
-					RenderToScanline(patternTable, chr1 << 4, palette, buffer);
-					buffer += 8;
-
-					if (hadLatch) {
-						patternTable = ppu.chrPages[(ppu.PPUCTRL & PPUCTRL_BGDTABLE) >> 4] + chrOffset;
-						hadLatch = false;
-					}
-
-					if (chr2 == 0xFD || chr2 == 0xFE) {
-						nesCart.renderLatch((chr2 << 4) + chrOffset + 8 + ((ppu.PPUCTRL & PPUCTRL_BGDTABLE) << 8));
-						hadLatch = true;
-					}
-
-					RenderToScanline(patternTable, chr2 << 4, palette, buffer);
-					buffer += 8;
-
-					if (hadLatch) {
-						patternTable = ppu.chrPages[(ppu.PPUCTRL & PPUCTRL_BGDTABLE) >> 4] + chrOffset;
-						hadLatch = false;
-					}
-				} else {
-					RenderToScanline(patternTable, chr1 << 4, palette, buffer);
-					buffer += 8;
-					RenderToScanline(patternTable, chr2 << 4, palette, buffer);
-					buffer += 8;
-				}
-			}
+			renderTilePair<hasLatch>(ppu, buffer, chrTable, chrOffset, chr1, chr2, (attrPalette & 0x03) << 2, lastChr);
 		}
 
 		if (hasLatch) {
 			// fetch 34th tile
-			if (buffer < bufferEnd + 8 && curTileX < 32) {
+			if (curTileX < 32) {
 				int chr = nameTable[curTileX];
 
 				if (chr == 0xFD || chr == 0xFE) {
@@ -1343,22 +1395,46 @@ static void renderScanline_VertMirror_Latched(nes_ppu& ppu) {
 			ppu.scrollY--;
 		}
 	}
-	 
-	ppu.doOAMRender();
-}
-
-void nes_ppu::renderScanline_VertMirror(nes_ppu& ppu) {
-	TIME_SCOPE();
 
-	if (nesCart.renderLatch) {
-		renderScanline_VertMirror_Latched<true, false>(ppu);
-	} else {
-		renderScanline_VertMirror_Latched<false, false>(ppu);
+	if (ppu.canSprite0Hit()) {
+		ppu.fastSprite0(true);
 	}
+
+	renderOAM<sprite16, sprite16 ? 16 : 8, clipLeft>(ppu);
 }
 
-void nes_ppu::renderScanline_4PaneMirror(nes_ppu& ppu) {
-	renderScanline_VertMirror_Latched<false, true>(ppu);
+#define SCANLINE_RENDERERS(layout, latch) \
+	{ \
+		{ renderScanline_Tmpl<layout, latch, false, 0>, renderScanline_Tmpl<layout, latch, false, 1>, \
+		  renderScanline_Tmpl<layout, latch, false, 2>, renderScanline_Tmpl<layout, latch, false, 3> }, \
+		{ renderScanline_Tmpl<layout, latch, true, 0>, renderScanline_Tmpl<layout, latch, true, 1>, \
+		  renderScanline_Tmpl<layout, latch, true, 2>, renderScanline_Tmpl<layout, latch, true, 3> } \
+	}
+
+// [mirror type][has latch][sprite 16][clip left], latch variants only exist for mirror types used by MMC2/4
+static nes_ppu::scanlineRenderer scanlineRenderers[6][2][2][4] = {
+	/* MT_UNSET */			{ SCANLINE_RENDERERS(RL_HORZ, false), SCANLINE_RENDERERS(RL_HORZ, true) },
+	/* MT_HORIZONTAL */		{ SCANLINE_RENDERERS(RL_HORZ, false), SCANLINE_RENDERERS(RL_HORZ, true) },
+	/* MT_VERTICAL */		{ SCANLINE_RENDERERS(RL_VERT, false), SCANLINE_RENDERERS(RL_VERT, true) },
+	/* MT_SINGLE */			{ SCANLINE_RENDERERS(RL_SINGLE, false), SCANLINE_RENDERERS(RL_SINGLE, false) },
+	/* MT_SINGLE_UPPER */	{ SCANLINE_RENDERERS(RL_SINGLE_UPPER, false), SCANLINE_RENDERERS(RL_SINGLE_UPPER, false) },
+	/* MT_4PANE */			{ SCANLINE_RENDERERS(RL_4PANE, false), SCANLINE_RENDERERS(RL_4PANE, false) },
+};
+
+#undef SCANLINE_RENDERERS
+
+void nes_ppu::updateRenderScanline() {
+	const int hasLatch = nesCart.renderLatch ? 1 : 0;
+	const int sprite16 = (PPUCTRL & PPUCTRL_SPRSIZE) ? 1 : 0;
+	const int clipLeft = ((PPUMASK & PPUMASK_SHOWLEFTBG) ? 0 : CLIP_LEFT_BG) | ((PPUMASK & PPUMASK_SHOWLEFTOBJ) ? 0 : CLIP_LEFT_OBJ);
+	const int key = (mirror << 4) | (hasLatch << 3) | (sprite16 << 2) | clipLeft;
+
+	// only reselect when an input actually changed
+	if (key != renderScanlineKey) {
+		DebugAssert(mirror >= 0 && mirror <= nes_mirror_type::MT_4PANE);
+		renderScanlineKey = key;
+		renderScanline = scanlineRenderers[mirror][hasLatch][sprite16][clipLeft];
+	}
 }
 
 void nes_ppu::setMirrorType(int withType) {
@@ -1366,28 +1442,20 @@ void nes_ppu::setMirrorType(int withType) {
 		return;
 	}
 
+	catchUp();
+
 	mirror = withType;
-	switch (mirror) {
-		case nes_mirror_type::MT_HORIZONTAL:
-			renderScanline = renderScanline_HorzMirror;
-			break;
-		case nes_mirror_type::MT_VERTICAL:
-			renderScanline = renderScanline_VertMirror;
-			break;
-		case nes_mirror_type::MT_SINGLE:
-		case nes_mirror_type::MT_SINGLE_UPPER:
-			renderScanline = renderScanline_SingleMirror;
-			break;
-		case nes_mirror_type::MT_4PANE:
-			renderScanline = renderScanline_4PaneMirror;
-			break;
-	}
+	updateRenderScanline();
 }
 
+
 void nes_ppu::init() {
 	memset(this, 0, sizeof(nes_ppu));
 	scanline = 1;
 	mirror = nes_mirror_type::MT_UNSET;
+	renderScanlineKey = -1;
+	updateRenderScanline();
+	selectPaletteBank();
 	initScanlineBuffer();
 	autoFrameSkip = 0;
 }
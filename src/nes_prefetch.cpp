@@ -0,0 +1,289 @@
+
+// History based bank prefetching. Cache requests teach the cart which bank tends to follow which, and idle time
+// in the frame is used to read likely next banks into cold cache slots before they are asked for.
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+#include "scope_timer/scope_timer.h"
+
+// stats file header, raw tables follow (native endian, the marker rejects files from the other target)
+struct nes_prefetch_header {
+	char magic[4];
+	uint16 endianMarker;
+	uint16 numPRG;
+	uint16 numCHR;
+	uint16 pad;
+};
+
+static const uint16 PrefetchEndianMarker = 0x1234;
+
+void nes_bank_prefetcher::reset() {
+	for (int i = 0; i < PREFETCH_PRG_BANKS; i++) {
+		prg[i].next = -1;
+		prg[i].confidence = 0;
+		prg[i].phase = 0;
+	}
+	for (int i = 0; i < PREFETCH_CHR_PAGES; i++) {
+		chr[i].next = -1;
+		chr[i].confidence = 0;
+		chr[i].phase = 0;
+	}
+
+	lastPRG = -1;
+	lastCHR = -1;
+	bDirty = false;
+
+	issued = 0;
+	used = 0;
+	wasted = 0;
+	prgMissCycles = 0;
+	chrMissCycles = 0;
+	stallCyclesSaved = 0;
+
+	fillEntry = -1;
+}
+
+void nes_bank_prefetcher::train(bool bCHR, int32 key) {
+	int32& last = bCHR ? lastCHR : lastPRG;
+	const int32 size = bCHR ? PREFETCH_CHR_PAGES : PREFETCH_PRG_BANKS;
+
+	if (last >= 0 && last < size && last != key) {
+		nes_bank_transition& transition = bCHR ? chr[last] : prg[last];
+		// only what changes the prefetches made next session is worth a flash write on pause
+		if (transition.next == key) {
+			if (transition.confidence < 3) {
+				transition.confidence++;
+				if (transition.confidence == PREFETCH_CONFIDENCE) {
+					bDirty = true;
+				}
+			}
+			transition.phase = nesPPU.scanline >> 3;
+		} else if (transition.confidence <= 1) {
+			// replace a weak prediction outright
+			transition.next = key;
+			transition.confidence = 1;
+			transition.phase = nesPPU.scanline >> 3;
+			bDirty = true;
+		} else {
+			if (transition.confidence == PREFETCH_CONFIDENCE) {
+				bDirty = true;
+			}
+			transition.confidence--;
+		}
+	}
+
+	last = key;
+}
+
+void nes_bank_prefetcher::onRequested(nes_cached_bank& entry, bool bCHR) {
+	if (entry.bPrefetched) {
+		entry.bPrefetched = false;
+		used++;
+		stallCyclesSaved += bCHR ? chrMissCycles : prgMissCycles;
+		COUNT_SCOPE_NAMED(prefetch_used, 1);
+	}
+
+	entry.useFrame = nesPPU.frameCounter;
+}
+
+void nes_bank_prefetcher::onEvicted(const nes_cached_bank& entry) {
+	if (entry.bPrefetched) {
+		wasted++;
+		COUNT_SCOPE_NAMED(prefetch_wasted, 1);
+	}
+}
+
+void nes_bank_prefetcher::onMiss(bool bCHR, uint32 cycles) {
+	uint32& average = bCHR ? chrMissCycles : prgMissCycles;
+	average = average ? (average * 7 + cycles) / 8 : cycles;
+}
+
+void nes_bank_prefetcher::report() {
+#if DEBUG
+	const int accuracy = issued ? used * 100 / issued : 0;
+	sprintf(ScopeTimer::debugString, "Prefetch %d/%d (%d%%) %dk cyc, %s miss %d/%d", used, issued, accuracy, stallCyclesSaved / 1024,
+		nesCart.isCompressed ? "nesz" : "nes", prgMissCycles, chrMissCycles);
+	OutputLog("Prefetch: %d issued, %d used, %d wasted, %d cycles of stalls avoided\n", issued, used, wasted, stallCyclesSaved);
+
+	// run the same game from .nes and .nesz to compare unpacking against raw flash reads
+	OutputLog("Bank miss cost (%s): PRG %d cycles, CHR %d cycles\n", nesCart.isCompressed ? "packed" : "raw", prgMissCycles, chrMissCycles);
+#endif
+}
+
+// picks the learned successor of key if it is worth prefetching and sooner than the current best
+static void ConsiderPrefetch(const nes_bank_transition* table, int32 size, int32 key, int32 limit, const nes_bank_cache& cache,
+	bool bCHR, int32& bestKey, bool& bestCHR, int& bestPhase) {
+	if (key < 0 || key >= size) {
+		return;
+	}
+
+	const nes_bank_transition& transition = table[key];
+	if (transition.confidence >= PREFETCH_CONFIDENCE && transition.next >= 0 && transition.next < limit && transition.phase < bestPhase &&
+		cache.peek(transition.next) == -1) {
+		bestKey = transition.next;
+		bestCHR = bCHR;
+		bestPhase = transition.phase;
+	}
+}
+
+bool nes_cart::PrefetchIdle() {
+	// resident ROMs never miss
+	if (romImage || handle <= 0 || prgCache.count == 0) {
+		return false;
+	}
+
+	// a cache reset since the fill started took its entry back
+	if (prefetcher.fillEntry != -1) {
+		const nes_cached_bank& fill = prgCache.entries[prefetcher.fillEntry];
+		if (fill.key != -1 || fill.pinCount != 1) {
+			prefetcher.fillEntry = -1;
+		}
+	}
+
+	if (prefetcher.fillEntry != -1) {
+		ContinuePRGFill();
+		return true;
+	}
+
+	// the predicted successor of a currently mapped bank that will be needed soonest
+	int32 bestKey = -1;
+	bool bestCHR = false;
+	int bestPhase = 256;
+	for (int i = 0; i < 4 + isLowPRGROM; i++) {
+		ConsiderPrefetch(prefetcher.prg, PREFETCH_PRG_BANKS, programBanks[i], numPRGBanks * 2, prgCache, false, bestKey, bestCHR, bestPhase);
+	}
+	if (numCHRBanks) {
+		const int chrBankMask = (numCHRBanks << 3) - 1;
+		for (int i = 0; i < 8; i++) {
+			ConsiderPrefetch(prefetcher.chr, PREFETCH_CHR_PAGES, chrBanks[i] & chrBankMask, numCHRBanks * 8, chrCache, true, bestKey, bestCHR, bestPhase);
+		}
+	}
+
+	if (bestKey == -1) {
+		return false;
+	}
+
+	// only ever replace an empty or cold slot, pinned entries are not in the LRU at all
+	nes_bank_cache& bankCache = bestCHR ? chrCache : prgCache;
+	const int victim = bankCache.oldest();
+	if (victim == -1) {
+		return false;
+	}
+	const nes_cached_bank& victimEntry = bankCache.entries[victim];
+	if (victimEntry.key != -1 && nesPPU.frameCounter - victimEntry.useFrame < PREFETCH_COLD_FRAMES) {
+		return false;
+	}
+
+	if (bestCHR) {
+		// a 1 KB page is read in one go
+		prefetcher.onEvicted(victimEntry);
+		int32 evictedKey;
+		const int entry = bankCache.evict(bestKey, evictedKey);
+		ReadROM(bankCache.entries[entry].ptr, 1024, 16 + 16384 * numPRGBanks + 1024 * bestKey);
+
+		bankCache.entries[entry].bPrefetched = true;
+		bankCache.entries[entry].useFrame = nesPPU.frameCounter;
+		prefetcher.issued++;
+		COUNT_SCOPE_NAMED(prefetch_issued, 1);
+		return true;
+	}
+
+	// the fill entry leaves the LRU while it is read, keep at least one other entry for misses to evict
+	if (victimEntry.prev == -1) {
+		return false;
+	}
+
+	prefetcher.onEvicted(victimEntry);
+	prgCache.rekey(victim, -1);
+	prgCache.pin(victim);
+	prefetcher.fillEntry = victim;
+	prefetcher.fillKey = bestKey;
+	prefetcher.fillOffset = 0;
+
+	ContinuePRGFill();
+	return true;
+}
+
+void nes_cart::ContinuePRGFill() {
+	// packed PRG can only be unpacked in whole units
+	const int pieceSize = isCompressed ? PACKED_PRG_UNIT : 1024;
+	const int index = prefetcher.fillEntry;
+	nes_cached_bank& entry = prgCache.entries[index];
+
+	ReadROM(entry.ptr + prefetcher.fillOffset, pieceSize, 16 + 8192 * prefetcher.fillKey + prefetcher.fillOffset);
+	prefetcher.fillOffset += pieceSize;
+	if (prefetcher.fillOffset < 8192) {
+		return;
+	}
+
+	// the bank may have been missed and cached in the meantime, then this copy is dropped
+	prefetcher.fillEntry = -1;
+	if (prgCache.peek(prefetcher.fillKey) == -1) {
+		prgCache.rekey(index, prefetcher.fillKey);
+		entry.bPrefetched = true;
+		entry.useFrame = nesPPU.frameCounter;
+		prefetcher.issued++;
+		COUNT_SCOPE_NAMED(prefetch_issued, 1);
+	}
+	prgCache.unpin(index);
+}
+
+static void GetPrefetchStatsName(const char* romFile, unsigned short* intoName) {
+	char statsFile[256];
+	nes_cart::GetSaveFileName(romFile, ".bpf", statsFile);
+	Bfile_StrToName_ncpy(intoName, statsFile, 255);
+}
+
+void nes_cart::LoadPrefetchStats(const char* withFile) {
+	unsigned short statsName[256];
+	GetPrefetchStatsName(withFile, statsName);
+
+	int file = Bfile_OpenFile_OS(statsName, READ, 0);
+	if (file < 0) {
+		return;
+	}
+
+	nes_prefetch_header header;
+	if (Bfile_ReadFile_OS(file, &header, sizeof(header), 0) == sizeof(header) && !memcmp(header.magic, "NBPF", 4) &&
+		header.endianMarker == PrefetchEndianMarker && header.numPRG == PREFETCH_PRG_BANKS && header.numCHR == PREFETCH_CHR_PAGES) {
+		if (Bfile_ReadFile_OS(file, prefetcher.prg, sizeof(prefetcher.prg), -1) != sizeof(prefetcher.prg) ||
+			Bfile_ReadFile_OS(file, prefetcher.chr, sizeof(prefetcher.chr), -1) != sizeof(prefetcher.chr)) {
+			// partial file, start over
+			prefetcher.reset();
+		}
+	}
+
+	Bfile_CloseFile_OS(file);
+}
+
+void nes_cart::SavePrefetchStats() {
+	if (!prefetcher.bDirty || romFile[0] == 0) {
+		return;
+	}
+
+	unsigned short statsName[256];
+	GetPrefetchStatsName(romFile, statsName);
+
+	size_t size = sizeof(nes_prefetch_header) + sizeof(prefetcher.prg) + sizeof(prefetcher.chr);
+	Bfile_CreateEntry_OS(statsName, CREATEMODE_FILE, &size);
+
+	int file = Bfile_OpenFile_OS(statsName, WRITE, 0);
+	if (file < 0) {
+		return;
+	}
+
+	nes_prefetch_header header;
+	memcpy(header.magic, "NBPF", 4);
+	header.endianMarker = PrefetchEndianMarker;
+	header.numPRG = PREFETCH_PRG_BANKS;
+	header.numCHR = PREFETCH_CHR_PAGES;
+	header.pad = 0;
+
+	Bfile_WriteFile_OS(file, &header, sizeof(header));
+	Bfile_WriteFile_OS(file, prefetcher.prg, sizeof(prefetcher.prg));
+	Bfile_WriteFile_OS(file, prefetcher.chr, sizeof(prefetcher.chr));
+	Bfile_CloseFile_OS(file);
+
+	prefetcher.bDirty = false;
+}
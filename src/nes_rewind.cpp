@@ -0,0 +1,240 @@
+
+// Rewind history kept as packed XOR deltas between periodic in-memory snapshots
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+#include "settings.h"
+#include "scope_timer/scope_timer.h"
+
+nes_rewind nesRewind;
+
+// memory per rewind setting and frames between snapshots. Deltas run a few hundred bytes for most games, so the
+// largest host budget holds well over ten minutes
+#if TARGET_PRIZM
+static const int32 RewindBudgetKB[] = { 0, 48, 96, 192 };
+static const int32 RewindInterval = 8;
+#else
+static const int32 RewindBudgetKB[] = { 0, 1024, 4096, 16384 };
+static const int32 RewindInterval = 2;
+#endif
+
+// packed deltas are (unchanged run, changed run) as 7 bit varints followed by the changed bytes XORed, so the
+// worst case is a little over the state size
+static int32 PackBound(int32 stateSize) {
+	return stateSize + stateSize / 64 + 16;
+}
+
+static uint8* PutVarint(uint8* into, uint32 value) {
+	while (value >= 0x80) {
+		*into++ = uint8(value | 0x80);
+		value >>= 7;
+	}
+	*into++ = uint8(value);
+	return into;
+}
+
+static const uint8* GetVarint(const uint8* from, uint32& value) {
+	value = 0;
+	int shift = 0;
+	uint8 cur;
+	do {
+		cur = *from++;
+		value |= uint32(cur & 0x7F) << shift;
+		shift += 7;
+	} while (cur & 0x80);
+	return from;
+}
+
+static int32 PackDelta(const uint8* newer, const uint8* older, int32 size, uint8* into) {
+	uint8* out = into;
+	int32 i = 0;
+	while (i < size) {
+		const int32 unchangedStart = i;
+		while (i < size && newer[i] == older[i]) {
+			i++;
+
+			// most of a state doesn't change, skip it a word at a time once aligned
+			if ((i & 3) == 0) {
+				while (i + 4 <= size && *(const uint32*)(newer + i) == *(const uint32*)(older + i)) {
+					i += 4;
+				}
+			}
+		}
+
+		// changed runs carry single unchanged bytes along, it is cheaper than a new run
+		const int32 changedStart = i;
+		while (i < size && (newer[i] != older[i] || (i + 1 < size && newer[i + 1] != older[i + 1]))) {
+			i++;
+		}
+
+		out = PutVarint(out, changedStart - unchangedStart);
+		out = PutVarint(out, i - changedStart);
+		for (int32 j = changedStart; j < i; j++) {
+			*out++ = newer[j] ^ older[j];
+		}
+	}
+
+	return out - into;
+}
+
+// XOR is its own inverse, so this turns the newer state back into the older one
+static void ApplyDelta(uint8* state, const uint8* packed, int32 packedSize) {
+	const uint8* end = packed + packedSize;
+	while (packed < end) {
+		uint32 unchanged, changed;
+		packed = GetVarint(packed, unchanged);
+		packed = GetVarint(packed, changed);
+
+		state += unchanged;
+		for (uint32 i = 0; i < changed; i++) {
+			*state++ ^= *packed++;
+		}
+	}
+}
+
+void nes_rewind::clear() {
+	free(memory);
+	memset(this, 0, sizeof(nes_rewind));
+}
+
+bool nes_rewind::allocate(int32 setting) {
+	clear();
+	budgetSetting = setting;
+	if (setting == 0) {
+		return false;
+	}
+
+	const int32 stateBytes = (nesCart.GetStateSize() + 3) & ~3;
+
+	// a cart with CHR RAM and WRAM can outgrow the smaller budgets, those move up to the next size that holds it
+	const int32 numBudgets = sizeof(RewindBudgetKB) / sizeof(RewindBudgetKB[0]);
+	for (int32 size = setting; size < numBudgets; size++) {
+		const int32 budget = RewindBudgetKB[size] * 1024;
+
+		// entries are budgeted for deltas averaging 32 bytes, the rest holds the deltas themselves
+		const int32 ringBytes = budget - stateBytes * 2;
+		const int32 numEntries = ringBytes / (32 + sizeof(nes_rewind_entry));
+		const int32 numHistory = ringBytes - numEntries * sizeof(nes_rewind_entry);
+		if (numHistory < PackBound(stateBytes)) {
+			continue;
+		}
+
+		memory = (uint8*) malloc(budget);
+		if (memory == nullptr) {
+			// a larger budget won't allocate either
+			OutputLog("Rewind: could not allocate %d KB\n", budget / 1024);
+			break;
+		}
+
+		stateSize = nesCart.GetStateSize();
+		current = memory;
+		next = memory + stateBytes;
+		entries = (nes_rewind_entry*) (memory + stateBytes * 2);
+		maxEntries = numEntries;
+		history = (uint8*) (entries + maxEntries);
+		historySize = numHistory;
+		framesToCapture = 1;
+
+		OutputLog("Rewind: %d byte states, %d KB of history\n", stateSize, historySize / 1024);
+		return true;
+	}
+
+	// shown with the setting in the options menu
+	bUnavailable = true;
+	return false;
+}
+
+void nes_rewind::frame() {
+	const int32 setting = nesSettings.GetSetting(ST_Rewind);
+	if (setting != budgetSetting) {
+		allocate(setting);
+	}
+	if (memory == nullptr) {
+		return;
+	}
+
+	if (nesSettings.CheckCachedKey(NES_REWIND)) {
+		stepBack();
+		framesToCapture = RewindInterval;
+		return;
+	}
+
+	if (--framesToCapture <= 0) {
+		capture();
+		framesToCapture = RewindInterval;
+	}
+}
+
+void nes_rewind::evictOldest() {
+	DebugAssert(numEntries > 0);
+	oldestEntry = (oldestEntry + 1) % maxEntries;
+	numEntries--;
+}
+
+int32 nes_rewind::reserve(int32 size) {
+	DebugAssert(size <= historySize);
+	if (numEntries == maxEntries) {
+		evictOldest();
+	}
+
+	for (;;) {
+		if (numEntries == 0) {
+			head = 0;
+			return 0;
+		}
+
+		// entries never wrap, so the free space is after head and either before the end or the oldest entry
+		const int32 tail = entries[oldestEntry].offset;
+		if (tail < head) {
+			if (head + size <= historySize) {
+				return head;
+			}
+			if (size <= tail) {
+				return 0;
+			}
+		} else if (head + size <= tail) {
+			return head;
+		}
+
+		evictOldest();
+	}
+}
+
+void nes_rewind::capture() {
+	TIME_SCOPE();
+
+	if (nesCart.SaveToMemory(next, stateSize) != stateSize) {
+		return;
+	}
+
+	if (bHasCurrent) {
+		const int32 offset = reserve(PackBound(stateSize));
+		nes_rewind_entry& entry = entries[(oldestEntry + numEntries) % maxEntries];
+		entry.offset = offset;
+		entry.size = PackDelta(next, current, stateSize, history + offset);
+		numEntries++;
+		head = offset + entry.size;
+	}
+
+	uint8* newest = next;
+	next = current;
+	current = newest;
+	bHasCurrent = true;
+}
+
+bool nes_rewind::stepBack() {
+	if (!bHasCurrent) {
+		return false;
+	}
+
+	// with nothing older left, hold on the oldest snapshot
+	if (numEntries) {
+		const nes_rewind_entry& newest = entries[(oldestEntry + numEntries - 1) % maxEntries];
+		ApplyDelta(current, history + newest.offset, newest.size);
+		head = newest.offset;
+		numEntries--;
+	}
+
+	return nesCart.LoadFromMemory(current, stateSize);
+}
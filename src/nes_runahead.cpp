@@ -0,0 +1,115 @@
+
+// Host side run ahead. Games read input a frame or more before it shows on screen, so the frames after each real
+// one are emulated from a snapshot and the last of them is what gets presented. This runs ahead on the one machine
+// and restores it afterwards, a second machine kept ahead would need its own ROM handle, bank caches and cheats, and
+// the render, audio and capture threads all follow the default machine
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+#include "settings.h"
+#include "frontend.h"
+#include "render_thread.h"
+#include "scope_timer/scope_timer.h"
+
+#if TARGET_WINSIM
+
+nes_run_ahead nesRunAhead;
+
+static const int32 MaxRunAheadFrames = 4;
+
+void nes_run_ahead::clear() {
+	free(state);
+	state = nullptr;
+	stateSize = 0;
+	gameFrames = -1;
+
+	nesPPU.bSuppressVideo = false;
+	nesPPU.bRunningAhead = false;
+}
+
+void nes_run_ahead::load(const char* romFile) {
+	clear();
+
+	// a "runahead <frames>" line in a .cfg file next to the ROM
+	char cfgFile[256];
+	strcpy(cfgFile, romFile);
+	strcpy(strrchr(cfgFile, '.'), ".cfg");
+
+	unsigned short cfgFileWide[256];
+	Bfile_StrToName_ncpy(cfgFileWide, cfgFile, 255);
+	int file = Bfile_OpenFile_OS(cfgFileWide, READ, 0);
+	if (file < 0) {
+		return;
+	}
+
+	char text[256];
+	const int32 numRead = Bfile_ReadFile_OS(file, text, sizeof(text) - 1, 0);
+	Bfile_CloseFile_OS(file);
+	if (numRead <= 0) {
+		return;
+	}
+	text[numRead] = 0;
+
+	const char* key = strstr(text, "runahead");
+	if (key) {
+		key += strlen("runahead");
+		while (*key == ' ' || *key == '\t' || *key == '=') {
+			key++;
+		}
+		if (*key >= '0' && *key <= '9') {
+			gameFrames = *key - '0';
+			if (gameFrames > MaxRunAheadFrames) {
+				gameFrames = MaxRunAheadFrames;
+			}
+			OutputLog("Run ahead: %d frames for this game\n", gameFrames);
+		}
+	}
+}
+
+int32 nes_run_ahead::getFrames() const {
+	return gameFrames >= 0 ? gameFrames : nesSettings.GetSetting(ST_RunAhead);
+}
+
+void nes_run_ahead::frameEnded() {
+	extern bool shouldExit;
+	const int32 frames = getFrames();
+	if (frames == 0 || shouldExit) {
+		nesPPU.bSuppressVideo = false;
+		return;
+	}
+
+	TIME_SCOPE();
+
+	if (state == nullptr) {
+		stateSize = nesCart.GetStateSize();
+		state = (uint8*) malloc(stateSize);
+	}
+	if (state == nullptr || nesCart.SaveToMemory(state, stateSize) != stateSize) {
+		nesPPU.bSuppressVideo = false;
+		return;
+	}
+
+	// only the last frame ahead is shown, none of them are heard
+	const unsigned int frameCounter = nesPPU.frameCounter;
+	nesPPU.bRunningAhead = true;
+	for (int32 i = 0; i < frames; i++) {
+		nesPPU.bSuppressVideo = (i != frames - 1);
+		nesFrontend.RunFrame();
+	}
+	nesPPU.bRunningAhead = false;
+
+#if PPU_RENDER_THREAD
+	// the presented frame may still be drawing from video memory the restore replaces
+	nesRenderThread.sync();
+#endif
+
+	// the frames ahead rarely leave a different bank mapping, so this mostly keeps the PRG and CHR caches as they are
+	nesCart.LoadFromMemory(state, stateSize);
+	nesPPU.frameCounter = frameCounter;
+
+	// the real frame carries on unseen
+	nesPPU.bSuppressVideo = true;
+}
+
+#endif
@@ -31,7 +31,8 @@ enum SectionTypes {
 	ST_PPU = 3,
 	ST_CTLR = 4,
 	ST_SND = 5,
-	ST_EXTRA = 16
+	ST_EXTRA = 16,
+	ST_NESIZM = 0x40		// our own state FCEUX has no chunks for, FCEUX skips unknown sections
 };
 
 enum SaveStateError {
@@ -46,27 +47,44 @@ enum SaveStateError {
 		Read_##SectionName##_##SubsectionName(data, size); return true; \
 	}
 
+// leads every native chunk so a state from the other target is not misread
+static const uint16 StateEndianMarker = 0x1234;
+
+// clocks and scanline position, so a snapshot resumes exactly where it was taken
+struct nes_state_timing {
+	uint32 clocks;
+	uint32 nextClocks;
+	uint32 ppuClocks;
+	uint32 apuClocks;
+	uint32 irqMask;
+	uint32 irqClock[4];
+	uint32 scanline;
+	uint32 ppuNMI;
+};
+
+// works on a whole state image in memory, so a file save or load is a single bulk transfer
 struct FCEUX_File {
-	int32 fileID;
+	uint8* buffer;			// state image (only read from when loading), when writing with no buffer only the size is collected
+	int32 capacity;
+	int32 position;
 	SaveStateError hasError;
 	int32 Size;
 	int32 Version;
-	int32 WritingToSection;
-	int32 SectionSizes[32];
-
-	FCEUX_File(int withFileID) : fileID(withFileID), hasError(SSE_NoError) {
-		memset(SectionSizes, 0, sizeof(SectionSizes));
-	}
+	int32 sectionStart;		// offset of the open section header while writing
 
-	// file size is Size value + header size
-	int32 GetFileSize() {
-		return Size + sizeof(FCEUX_Header);
+	FCEUX_File(uint8* withBuffer, int32 withCapacity) : buffer(withBuffer), capacity(withCapacity), position(0), hasError(SSE_NoError),
+		Size(0), Version(0), sectionStart(-1) {
 	}
 
 	bool ReadHeader() {
 		DebugAssert(sizeof(FCEUX_Header) == 16);
 		FCEUX_Header header;
-		Bfile_ReadFile_OS(fileID, &header, sizeof(header), -1);
+		if (capacity < (int32) sizeof(header)) {
+			return false;
+		}
+		memcpy(&header, buffer, sizeof(header));
+		position = sizeof(header);
+
 		EndianSwap_Little(header.Size);
 		EndianSwap_Little(header.NewVersion);
 		if (header.FCS[0] != 'F' || header.FCS[1] != 'C' || header.FCS[2] != 'S') {
@@ -82,45 +100,66 @@ struct FCEUX_File {
 			return false;
 		}
 
+		// anything past the declared size is not ours
+		if (header.Size < uint32(capacity - position)) {
+			capacity = position + header.Size;
+		}
+
 		return true;
 	}
 
-	bool ReadSection(void* scratchMem) {
+	bool ReadSection() {
 		FCEUX_SectionHeader header;
-		if (Bfile_ReadFile_OS(fileID, &header, sizeof(header), -1) != sizeof(header)) {
+		if (capacity - position < (int32) sizeof(header)) {
 			return false;
 		}
+		memcpy(&header, buffer + position, sizeof(header));
+		position += sizeof(header);
 		EndianSwap_Little(header.sectionSize);
 
+		if (header.sectionSize > uint32(capacity - position)) {
+			OutputLog("  Truncated state section '%d'\n", header.sectionType);
+			hasError = SSE_BadData;
+			return false;
+		}
+		const int32 sectionEnd = position + header.sectionSize;
+
 		if (header.sectionType == 8) {
 			OutputLog("  Skipping load of state section '%d', %u bytes\n", header.sectionType, header.sectionSize);
-			int32 tell = Bfile_TellFile_OS(fileID);
-			Bfile_SeekFile_OS(fileID, tell + header.sectionSize);
+			position = sectionEnd;
 			return true;
 		}
 
 		OutputLog("  Loading state section '%d', %u bytes\n", header.sectionType, header.sectionSize);
-		int32 sizeLeft = header.sectionSize;
-		while (sizeLeft > 0) {
+		while (position < sectionEnd) {
 			FCEUX_ChunkHeader chunkHeader;
-			Bfile_ReadFile_OS(fileID, &chunkHeader, sizeof(chunkHeader), -1);
+			if (sectionEnd - position < (int32) sizeof(chunkHeader)) {
+				hasError = SSE_BadData;
+				return false;
+			}
+			memcpy(&chunkHeader, buffer + position, sizeof(chunkHeader));
+			position += sizeof(chunkHeader);
 			EndianSwap_Little(chunkHeader.chunkSize);
 
 			char chunkName[5] = { 0 };
 			memcpy(chunkName, chunkHeader.chunkName, 4);
 			OutputLog("    Chunk '%s', %d bytes\n", chunkName, chunkHeader.chunkSize);
 
-			Bfile_ReadFile_OS(fileID, scratchMem, chunkHeader.chunkSize, -1);
+			if (chunkHeader.chunkSize > uint32(sectionEnd - position)) {
+				OutputLog("      Overruns section!\n");
+				hasError = SSE_BadData;
+				return false;
+			}
 
-			if (!ReadStateChunk(header.sectionType, chunkName, (uint8*)scratchMem, chunkHeader.chunkSize)) {
+			// chunks are parsed in place
+			if (!ReadStateChunk(header.sectionType, chunkName, buffer + position, chunkHeader.chunkSize)) {
 				return false;
 			}
 
-			sizeLeft -= sizeof(chunkHeader) + chunkHeader.chunkSize;
+			position += chunkHeader.chunkSize;
 		}
 		OutputLog("  End section '%d'\n", header.sectionType);
 
-		DebugAssert(sizeLeft == 0); // overrun if hit
 		return true;
 	}
 
@@ -199,6 +238,20 @@ struct FCEUX_File {
 
 				break;
 			}
+			case ST_NESIZM:
+			{
+				// native layout, a state from the other target is loaded without these
+				if (size >= sizeof(StateEndianMarker) && data[0] == (StateEndianMarker & 0xFF) && data[1] == (StateEndianMarker >> 8)) {
+					data += sizeof(StateEndianMarker);
+					size -= sizeof(StateEndianMarker);
+					HandleSubsection(ST_NESIZM, APU, offsetof(nes_apu, writes));
+					HandleSubsection(ST_NESIZM, APUW, sizeof(nes_apu_write) * APU_STATE_WRITES);
+					HandleSubsection(ST_NESIZM, TIME, sizeof(nes_state_timing));
+					HandleSubsection(ST_NESIZM, SPEC, sizeof(mainCPU.specialMemory));
+					HandleSubsection(ST_NESIZM, CART, sizeof(nesCart.registers));
+				}
+				break;
+			}
 		}
 
 		OutputLog("      (ignored) ");
@@ -272,6 +325,9 @@ struct FCEUX_File {
 
 		nesPPU.memoryMap[2] = data[2];
 		nesPPU.memoryMap[4] = data[3];
+
+		nesPPU.selectPaletteBank();
+		nesPPU.updateRenderScanline();
 	}
 
 	inline void Read_ST_PPU_XOFF(uint8* data, uint32) {
@@ -313,8 +369,9 @@ struct FCEUX_File {
 
 	void Read_ST_EXTRA_CHRR(uint8* data, uint32 size) {
 		if (nesCart.numCHRBanks == 0) {
-			memcpy(nesPPU.chrPages[0], data, 0x1000);
-			memcpy(nesPPU.chrPages[1], data + 0x1000, 0x1000);
+			for (int32 i = 0; i < 8; i++) {
+				memcpy(nesPPU.chrPages[i], data + 0x400 * i, 0x400);
+			}
 		}
 	}
 
@@ -401,39 +458,9 @@ struct FCEUX_File {
 	}
 
 	void Read_ST_EXTRA_LATC(uint8* data, uint32 size) {
-		// UNROM
-		if (nesCart.mapper == 2) {
-			nesCart.MapProgramBanks(0, data[0] * 2, 2);
-		}
-		// CNROM
-		else if (nesCart.mapper == 3) {
-			CNROM_CUR_CHR_BANK = data[0];
-			nesCart.MapCharacterBanks(0, data[0] * 8, 8);
-		}
-		// AOROM
-		else if (nesCart.mapper == 7) {
-			uint8 nameTable = (data[0] >> 4) & 1;
-			uint8 prgBank = data[0] & 0xF;
-			AOROM_CUR_NAMETABLE = nameTable;
-			nesCart.MapProgramBanks(0, prgBank * 4, 4);
-		}
-		// ColourDreams
-		else if (nesCart.mapper == 11) {
-			unsigned int prg = (data[0] & 0x0F) * 4;
-			unsigned int chr = (data[0] & 0xF0) >> 4;
-			prg &= nesCart.numPRGBanks - 1;
-			nesCart.MapProgramBanks(0, prg, 4);
-			Mapper11_PRG_SELECT = prg;
-			nesCart.MapCharacterBanks(0, chr * 8, 8);
-			Mapper11_CHR_SELECT = chr;
-		}
-		// GXROM
-		else if (nesCart.mapper == 66 || nesCart.mapper == 140) {
-			int prg = (((data[0] & 0x30) >> 4) * 4) & (nesCart.numPRGBanks * 2 - 1);
-			int chr = (data[0] & 3) * 8;
-
-			nesCart.MapProgramBanks(0, prg, 4);
-			nesCart.MapCharacterBanks(0, chr, 8);
+		// AOROM / UNROM / CNROM / GXROM / ColourDreams and the other single latch boards, mapped on load
+		if (nesCart.mapperInterface->bDiscrete && nesCart.mapper != 0) {
+			DISCRETE_LATCH = data[0];
 		}
 	}
 
@@ -470,7 +497,7 @@ struct FCEUX_File {
 		else if (nesCart.mapper == 69) {
 			uint32 regs[21];
 			memcpy(regs, data, 84);
-			for (int32 r = 0; r <= 21; r++) {
+			for (int32 r = 0; r < 21; r++) {
 				EndianSwap_Big(regs[r]);
 				nesCart.registers[r] = regs[r];
 			}
@@ -568,7 +595,7 @@ struct FCEUX_File {
 		}
 		// AVE
 		else if (nesCart.mapper == 79) {
-			Mapper79_CONTROL_CHAR = data[0];
+			DISCRETE_LATCH = (DISCRETE_LATCH & 0x08) | (data[0] & 0x07);
 		}
 	}
 
@@ -579,11 +606,11 @@ struct FCEUX_File {
 		}
 		// Camerica
 		if (nesCart.mapper == 71) {
-			nesCart.MapProgramBanks(0, data[0] * 2, 2);
+			DISCRETE_LATCH = data[0];
 		}
 		// AVE
 		else if (nesCart.mapper == 79) {
-			Mapper79_CONTROL_PRG = data[0];
+			DISCRETE_LATCH = (DISCRETE_LATCH & 0x07) | ((data[0] & 1) << 3);
 		}
 	}
 
@@ -596,12 +623,12 @@ struct FCEUX_File {
 				nesPPU.setMirrorType(nes_mirror_type::MT_VERTICAL);
 			}
 		}
-		// Camerica
+		// Camerica (Firehawk register value, mapped on load)
 		else if (nesCart.mapper == 71) {
 			if (data[0] == 2) {
-				nesPPU.setMirrorType(nes_mirror_type::MT_SINGLE);
+				DISCRETE_MIRROR_LATCH = 0x100;
 			} else if (data[0] == 3) {
-				nesPPU.setMirrorType(nes_mirror_type::MT_SINGLE_UPPER);
+				DISCRETE_MIRROR_LATCH = 0x110;
 			}
 		}
 		// RAMBO-1
@@ -649,9 +676,44 @@ struct FCEUX_File {
 		}
 	}
 
+	inline void Read_ST_NESIZM_APU(uint8* data, uint32 size) {
+		memcpy(&nesAPU, data, offsetof(nes_apu, writes));
+	}
+
+	void Read_ST_NESIZM_APUW(uint8* data, uint32 size) {
+		// queued writes were saved oldest first
+		memcpy(nesAPU.writes, data, size);
+		nesAPU.writeHead = 0;
+	}
+
+	void Read_ST_NESIZM_TIME(uint8* data, uint32 size) {
+		nes_state_timing timing;
+		memcpy(&timing, data, sizeof(timing));
+
+		mainCPU.clocks = timing.clocks;
+		mainCPU.nextClocks = timing.nextClocks;
+		mainCPU.ppuClocks = timing.ppuClocks;
+		mainCPU.apuClocks = timing.apuClocks;
+		mainCPU.irqMask = timing.irqMask;
+		for (int32 i = 0; i < 4; i++) {
+			mainCPU.irqClock[i] = timing.irqClock[i];
+		}
+		mainCPU.ppuNMI = timing.ppuNMI != 0;
+		nesPPU.scanline = timing.scanline;
+	}
+
+	// I/O registers outside the PPU ($4015 status, controller latches)
+	inline void Read_ST_NESIZM_SPEC(uint8* data, uint32 size) {
+		memcpy(mainCPU.specialMemory, data, sizeof(mainCPU.specialMemory));
+	}
+
+	// raw mapper registers, including the internal ones FCEUX chunks don't cover (IRQ clock stamps, etc)
+	inline void Read_ST_NESIZM_CART(uint8* data, uint32 size) {
+		memcpy(nesCart.registers, data, sizeof(nesCart.registers));
+	}
+
 	// write state support
 	void StartWrite() {
-		Size = 0;
 		Version = 22000;  // we are testing against FCEUX v 2.2
 	}
 
@@ -681,10 +743,12 @@ struct FCEUX_File {
 		WriteChunk("VBUF", 1, nesPPU.memoryMap[7]);
 		WriteChunk("PGEN", 1, nesPPU.memoryMap[0]);
 
-		// ST_EXTRA
-		if (nesCart.numRAMBanks) {
+		// ST_EXTRA (mapper registers are needed even without cart RAM)
+		{
 			WriteSection(ST_EXTRA);
-			WriteChunk_Data("WRAM", 0x2000, nesCart.GetWRAM());
+			if (nesCart.numRAMBanks) {
+				WriteChunk_Data("WRAM", 0x2000, nesCart.GetWRAM());
+			}
 
 			// MMC1 Mapper
 			if (nesCart.mapper == 1) {
@@ -719,11 +783,11 @@ struct FCEUX_File {
 				// PRG ROM
 				DRegs[0] |= (MMC1_PRG_BANK_MODE << 2);
 				if (MMC1_PRG_BANK_MODE == 2) {
-					DRegs[3] = (nesCart.registers[8] / 2) & 0xF;
-					if (nesCart.registers[8] & 0x20) DRegs[1] = 0x10;
+					DRegs[3] = (MMC1_PRG_BANK_2 / 2) & 0xF;
+					if (MMC1_PRG_BANK_2 & 0x20) DRegs[1] = 0x10;
 				} else {
-					DRegs[3] = (nesCart.registers[7] / 2) & 0xF;
-					if (nesCart.registers[7] & 0x20) DRegs[1] = 0x10;
+					DRegs[3] = (MMC1_PRG_BANK_1 / 2) & 0xF;
+					if (MMC1_PRG_BANK_1 & 0x20) DRegs[1] = 0x10;
 				}
 
 				if (MMC1_RAM_DISABLE) {
@@ -732,14 +796,6 @@ struct FCEUX_File {
 
 				WriteChunk("DREG", 4, DRegs[0], DRegs[1], DRegs[2], DRegs[3]);
 			}
-			// UNROM Mapper
-			else if (nesCart.mapper == 2) {
-				WriteChunk("LATC", 1, nesCart.programBanks[0] / 2);
-			}
-			// CNROM Mapper
-			else if (nesCart.mapper == 3) {
-				WriteChunk("LATC", 1, nesCart.chrBanks[0] / 8);
-			}
 			// MMC3 Mapper
 			else if (nesCart.mapper == 4) {
 				uint8 regs[8];
@@ -754,12 +810,6 @@ struct FCEUX_File {
 				WriteChunk("IRQL", 1, uint8(MMC3_IRQ_LATCH));
 				WriteChunk("IRQA", 1, uint8(MMC3_IRQ_ENABLE));
 			}
-			// AOROM Mapper
-			else if (nesCart.mapper == 7) {
-				uint8 nameTable = AOROM_CUR_NAMETABLE;
-				uint8 prgBank = nesCart.programBanks[0] / 4;
-				WriteChunk("LATC", 1, (nameTable << 4) | prgBank);
-			}
 			// MMC2 / MMC4 Mapper
 			else if (nesCart.mapper == 9 || nesCart.mapper == 10) {
 				WriteChunk("CREG", 4, uint8(MMC2_CHR_LOW_FD), uint8(MMC2_CHR_LOW_FE), uint8(MMC2_CHR_HIGH_FD), uint8(MMC2_CHR_HIGH_FE));
@@ -768,17 +818,13 @@ struct FCEUX_File {
 				WriteChunk("LAT0", 1, uint8(MMC2_LOLATCH));
 				WriteChunk("LAT1", 1, uint8(MMC2_HILATCH));
 			}
-			// ColourDreams Mapper
-			else if (nesCart.mapper == 11) {
-				WriteChunk("LATC", 1, uint8(Mapper11_PRG_SELECT / 4) | uint8(Mapper11_CHR_SELECT << 4));
-			}
 			// BNROM / Nina-1
 			else if (nesCart.mapper == 34) {
 				WriteChunk("REGS", 3, uint8(Mapper34_PRG_BANK), uint8(Mapper34_CHR1), uint8(Mapper34_CHR2));
 			}
 			// Camerica Mapper
 			else if (nesCart.mapper == 71) {
-				WriteChunk("PREG", 1, nesCart.programBanks[0] / 2);
+				WriteChunk("PREG", 1, uint8(DISCRETE_LATCH));
 				uint8 mirrorByte = 0;
 				if (nesPPU.mirror == nes_mirror_type::MT_SINGLE) {
 					mirrorByte = 2;
@@ -809,10 +855,6 @@ struct FCEUX_File {
 				}
 				WriteChunk_Data("REGS", 9, regs);
 			}
-			// GXROM Mapper
-			else if (nesCart.mapper == 66 || nesCart.mapper == 140) {
-				WriteChunk("LATC", 1, (nesCart.chrBanks[0] / 8) | ((nesCart.programBanks[0] * 4) << 4));
-			}
 			// Sunsoft-5 Mapper
 			else if (nesCart.mapper == 69) {
 				uint32 regs[21];
@@ -824,8 +866,8 @@ struct FCEUX_File {
 			}
 			// AVE Mapper
 			else if (nesCart.mapper == 79) {
-				WriteChunk("PREG", 1, uint8(Mapper79_CONTROL_PRG));
-				WriteChunk("CREG", 1, uint8(Mapper79_CONTROL_CHAR));
+				WriteChunk("PREG", 1, uint8((DISCRETE_LATCH >> 3) & 1));
+				WriteChunk("CREG", 1, uint8(DISCRETE_LATCH & 0x07));
 			}
 			// Nanjing Mapper
 			else if (nesCart.mapper == 163) {
@@ -837,65 +879,128 @@ struct FCEUX_File {
 				WriteChunk("STB", 1, uint8(Mapper163_STROBE));
 				WriteChunk("TRG", 1, uint8(Mapper163_TRIGGER));
 			}
+			// AOROM / UNROM / CNROM / GXROM / ColourDreams and the other single latch boards (NROM has no latch)
+			else if (nesCart.mapperInterface->bDiscrete && nesCart.mapper != 0) {
+				WriteChunk("LATC", 1, uint8(DISCRETE_LATCH));
+			}
 
 			// chr ram expected if there are no chr banks in the ROM
 			if (nesCart.numCHRBanks == 0) {
-				DebugAssert(nesPPU.chrPages[0] + 4096 == nesPPU.chrPages[1]);
+				DebugAssert(nesPPU.chrPages[0] + 0x1C00 == nesPPU.chrPages[7]);
 				WriteChunk_Data("CHRR", 8192, nesPPU.chrPages[0]);
 			}
 		}
 
+		// ST_NESIZM
+		{
+			WriteSection(ST_NESIZM);
+			// the write ring is most of the APU and nearly empty, so only the queued writes are kept
+			nesAPU.trimWrites(APU_STATE_WRITES);
+			nes_apu_write queued[APU_STATE_WRITES];
+			memset(queued, 0, sizeof(queued));
+			for (int32 i = 0; i < nesAPU.numWrites; i++) {
+				queued[i] = nesAPU.writes[(nesAPU.writeHead + i) & (APU_WRITE_RING - 1)];
+			}
+			WriteNativeChunk("APU", offsetof(nes_apu, writes), &nesAPU);
+			WriteNativeChunk("APUW", sizeof(queued), queued);
+
+			nes_state_timing timing;
+			timing.clocks = mainCPU.clocks;
+			timing.nextClocks = mainCPU.nextClocks;
+			timing.ppuClocks = mainCPU.ppuClocks;
+			timing.apuClocks = mainCPU.apuClocks;
+			timing.irqMask = mainCPU.irqMask;
+			for (int32 i = 0; i < 4; i++) {
+				timing.irqClock[i] = mainCPU.irqClock[i];
+			}
+			timing.scanline = nesPPU.scanline;
+			timing.ppuNMI = mainCPU.ppuNMI;
+			WriteNativeChunk("TIME", sizeof(timing), &timing);
+
+			WriteNativeChunk("SPEC", sizeof(mainCPU.specialMemory), mainCPU.specialMemory);
+			WriteNativeChunk("CART", sizeof(nesCart.registers), nesCart.registers);
+		}
+
+		EndWrite();
 		return true;
 	}
 
-	void WriteHeader() {
-		if (fileID) {
-			FCEUX_Header toWrite;
-			toWrite.FCS[0] = 'F';
-			toWrite.FCS[1] = 'C';
-			toWrite.FCS[2] = 'S';
-			toWrite.OldVersion = 'X';
-			toWrite.Size = Size;
-			toWrite.NewVersion = Version;
-			toWrite.CompressedSize = -1;
-			EndianSwap_Little(toWrite.Size);
-			EndianSwap_Little(toWrite.NewVersion);
-			EndianSwap_Little(toWrite.CompressedSize);
-			Bfile_WriteFile_OS(fileID, &toWrite, sizeof(toWrite));
+	void Write(const void* data, int32 size) {
+		if (buffer && position + size <= capacity) {
+			memcpy(buffer + position, data, size);
 		}
+		position += size;
 	}
 
-	void WriteSection(SectionTypes section) {
-		DebugAssert(section < 32);
-		WritingToSection = (int)section;
-
-		if (fileID) {
-			FCEUX_SectionHeader toWrite;
-			toWrite.sectionType = (uint8)section;
-			toWrite.sectionSize = SectionSizes[toWrite.sectionType];
-			EndianSwap_Little(toWrite.sectionSize);
-			Bfile_WriteFile_OS(fileID, &toWrite, sizeof(toWrite));
-		} else {
-			Size += sizeof(FCEUX_SectionHeader);
-			SectionSizes[WritingToSection] = 0; // online docs say this includes the section size but it doesn't appear to
+	// fills in a little endian size once the data it covers has been written
+	void PatchSize(int32 offset, uint32 size) {
+		EndianSwap_Little(size);
+		if (buffer && offset + (int32) sizeof(size) <= capacity) {
+			memcpy(buffer + offset, &size, sizeof(size));
 		}
 	}
 
-	void WriteChunk_Data(const char* name, uint32 size, void* dataArray) {
-		if (fileID) {
-			FCEUX_ChunkHeader toWrite;
-			memset(&toWrite.chunkName, 0, sizeof(toWrite.chunkName));
-			strcpy(toWrite.chunkName, name);
-			toWrite.chunkSize = size;
-			EndianSwap_Little(toWrite.chunkSize);
-			Bfile_WriteFile_OS(fileID, &toWrite, sizeof(toWrite));
-			Bfile_WriteFile_OS(fileID, dataArray, size);
-		} else {
-			Size += sizeof(FCEUX_ChunkHeader) + size;
-			SectionSizes[WritingToSection] += sizeof(FCEUX_ChunkHeader) + size;
+	void WriteHeader() {
+		FCEUX_Header toWrite;
+		toWrite.FCS[0] = 'F';
+		toWrite.FCS[1] = 'C';
+		toWrite.FCS[2] = 'S';
+		toWrite.OldVersion = 'X';
+		toWrite.Size = 0;
+		toWrite.NewVersion = Version;
+		toWrite.CompressedSize = -1;
+		EndianSwap_Little(toWrite.NewVersion);
+		EndianSwap_Little(toWrite.CompressedSize);
+		Write(&toWrite, sizeof(toWrite));
+	}
+
+	void EndSection() {
+		if (sectionStart >= 0) {
+			// online docs say this includes the section header but it doesn't appear to
+			PatchSize(sectionStart + 1, position - sectionStart - sizeof(FCEUX_SectionHeader));
+			sectionStart = -1;
 		}
 	}
 
+	void WriteSection(SectionTypes section) {
+		EndSection();
+		sectionStart = position;
+
+		FCEUX_SectionHeader toWrite;
+		toWrite.sectionType = (uint8)section;
+		toWrite.sectionSize = 0;
+		Write(&toWrite, sizeof(toWrite));
+	}
+
+	void EndWrite() {
+		EndSection();
+		Size = position - sizeof(FCEUX_Header);
+		PatchSize(4, Size);
+	}
+
+	void WriteChunk_Data(const char* name, uint32 size, const void* dataArray) {
+		FCEUX_ChunkHeader toWrite;
+		memset(&toWrite.chunkName, 0, sizeof(toWrite.chunkName));
+		memcpy(toWrite.chunkName, name, strlen(name));
+		toWrite.chunkSize = size;
+		EndianSwap_Little(toWrite.chunkSize);
+		Write(&toWrite, sizeof(toWrite));
+		Write(dataArray, size);
+	}
+
+	void WriteNativeChunk(const char* name, uint32 size, const void* dataArray) {
+		const uint8 marker[2] = { StateEndianMarker & 0xFF, StateEndianMarker >> 8 };
+
+		FCEUX_ChunkHeader toWrite;
+		memset(&toWrite.chunkName, 0, sizeof(toWrite.chunkName));
+		memcpy(toWrite.chunkName, name, strlen(name));
+		toWrite.chunkSize = sizeof(marker) + size;
+		EndianSwap_Little(toWrite.chunkSize);
+		Write(&toWrite, sizeof(toWrite));
+		Write(marker, sizeof(marker));
+		Write(dataArray, size);
+	}
+
 	void WriteChunk(const char* name, uint32 size, uint8 data0, uint8 data1 = 0, uint8 data2 = 0, uint8 data3 = 0) {
 		uint8 dataArray[4] = { data0, data1, data2, data3 };
 		WriteChunk_Data(name, size, dataArray);
@@ -904,13 +1009,71 @@ struct FCEUX_File {
 
 static void SetStateName(const char* romFile, uint16* intoName, int32 nameSize) {
 	char saveStateFile[256];
-	strcpy(saveStateFile, romFile);
-	*(strrchr(saveStateFile, '.') + 1) = 0;
-	strcat(saveStateFile, "fcs");
+	nes_cart::GetSaveFileName(romFile, ".fcs", saveStateFile);
 
 	Bfile_StrToName_ncpy(intoName, saveStateFile, nameSize-1);
 }
 
+// upper bound on the image WriteState produces, so a file save can serialize once straight into the buffer. The slack
+// covers section and chunk headers and the small mapper register chunks
+static int32 GetMaxStateSize() {
+	return sizeof(FCEUX_Header) + 0x800 /* RAM */ + 0x800 /* NTAR */ + 32 /* PRAM */ + 0x100 /* SPRA */ +
+		0x2000 /* WRAM */ + 8192 /* CHRR */ + offsetof(nes_apu, writes) + sizeof(nes_apu_write) * APU_STATE_WRITES +
+		sizeof(nes_state_timing) + sizeof(mainCPU.specialMemory) + sizeof(nesCart.registers) + 2048;
+}
+
+int32 nes_cart::GetStateSize() {
+	FCEUX_File sizer(nullptr, 0);
+	sizer.StartWrite();
+	sizer.WriteState();
+	return sizer.position;
+}
+
+int32 nes_cart::SaveToMemory(uint8* buffer, int32 capacity) {
+	mainCPU.resolveToP();
+
+	FCEUX_File fceuxFile(buffer, capacity);
+	fceuxFile.StartWrite();
+	if (!fceuxFile.WriteState() || fceuxFile.position > capacity) {
+		return 0;
+	}
+
+	return fceuxFile.position;
+}
+
+bool nes_cart::LoadFromMemory(const uint8* buffer, int32 size) {
+	// only read from
+	FCEUX_File fceuxFile(const_cast<uint8*>(buffer), size);
+
+	if (!fceuxFile.ReadHeader()) {
+		return false;
+	}
+
+	// bank mapping before the load, the mapper's stateLoaded remaps from the loaded registers
+	int32 oldProgramBanks[5];
+	int16 oldChrBanks[8];
+	memcpy(oldProgramBanks, programBanks, sizeof(programBanks));
+	memcpy(oldChrBanks, chrBanks, sizeof(chrBanks));
+
+	while (fceuxFile.ReadSection()) {
+	}
+
+	if (!fceuxFile.hasError && mapperInterface->stateLoaded) {
+		(this->*mapperInterface->stateLoaded)();
+	}
+
+	// a restore to the same bank mapping (run ahead, rewind) keeps the mapped banks and the caches as they are
+	if (memcmp(programBanks, oldProgramBanks, sizeof(programBanks)) || memcmp(chrBanks, oldChrBanks, sizeof(chrBanks))) {
+		FlushCache();
+		if (numCHRBanks) {
+			CommitChrBanks();
+		}
+	}
+	nesPPU.dirtyVideoMemory = true;
+
+	return fceuxFile.hasError == SSE_NoError;
+}
+
 // loads the default save state for this cart (filename replaces .nes with .fcs)
 bool nes_cart::LoadState() {
 
@@ -925,58 +1088,30 @@ bool nes_cart::LoadState() {
 		return false;
 	}
 
-	FCEUX_File fceuxFile(fileID);
+	// whole file in one read
+	const int32 fileSize = Bfile_GetFileSize_OS(fileID);
+	uint8* state = fileSize > 0 ? (uint8*) malloc(fileSize) : nullptr;
+	const int32 numRead = state ? Bfile_ReadFile_OS(fileID, state, fileSize, 0) : 0;
+	Bfile_CloseFile_OS(fileID);
 
-	if (!fceuxFile.ReadHeader()) {
-		return false;
-	}
+	// remaps everything if the ROM image moved, the load itself only does when the banks change
+	RebuildFileBlocks();
 
-	void* scratch = nesCart.cache[nesCart.findOldestUnusedBank()].ptr;
-	while (fceuxFile.ReadSection(scratch)) {
+	bool success = false;
+	if (numRead > 0) {
+		success = LoadFromMemory(state, numRead);
 	}
 
-	Bfile_CloseFile_OS(fileID);
-
-	nesCart.BuildFileBlocks();
-
-	if (!fceuxFile.hasError) {
-		if (mapper == 1) {
-			MMC1_StateLoaded();
-		} else if (mapper == 4) {
-			MMC3_StateLoaded();
-		} else if (mapper == 7) {
-			AOROM_StateLoaded();
-		} else if (mapper == 9 || mapper == 10) {
-			MMC2_StateLoaded();
-		} else if (mapper == 34) {
-			Mapper34_Sync();
-		} else if (mapper == 64) {
-			Mapper64_StateLoaded();
-		} else if (mapper == 67) {
-			Mapper67_StateLoaded();
-		} else if (mapper == 68) {
-			Mapper68_StateLoaded();
-		} else if (mapper == 69) {
-			Mapper69_RunCommand(true);
-		} else if (mapper == 79) {
-			Mapper79_Update();
-		} else if (mapper == 163) {
-			Mapper163_Update();
-		} 
-	}
-
-	nesCart.FlushCache();	
-	if (nesCart.numCHRBanks) {
-		nesCart.CommitChrBanks();
-	}
-
-	return fceuxFile.hasError;
+	free(state);
+	return success;
 }
 
 void nes_cart::FlushCache() {
-	for (int32 i = 0; i < cachedBankCount; i++) {
-		cache[i].clear();
-	}
+	resetPRGCache();
+	memset(programBankEntries, 0xFF, sizeof(programBankEntries));
+
+	chrCache.reset(chrCachePages, chrCacheBanks * 8);
+	memset(chrPageEntries, 0xFF, sizeof(chrPageEntries));
 
 	for (int32 i = 0; i < 4 + isLowPRGROM; i++) {
 		int curBank = programBanks[i];
@@ -986,14 +1121,18 @@ void nes_cart::FlushCache() {
 }
 
 bool nes_cart::SaveState() {
-	// if the file is set to 0, FCEUX_File will collect sizes instead
-	FCEUX_File fceuxFile(0);
-	fceuxFile.StartWrite();
-
-	if (!fceuxFile.WriteState())
+	const int32 capacity = GetMaxStateSize();
+	uint8* state = (uint8*) malloc(capacity);
+	if (!state) {
 		return false;
+	}
 
-	int32 Size = fceuxFile.GetFileSize();
+	// one pass, the size is whatever it wrote
+	const int32 Size = SaveToMemory(state, capacity);
+	if (Size == 0) {
+		free(state);
+		return false;
+	}
 
 	uint16 saveStateName[256];
 	SetStateName(romFile, saveStateName, 256);
@@ -1016,22 +1155,20 @@ bool nes_cart::SaveState() {
 	// if file is missing or deleted, create it
 	if (fileID < 0)
 	{
-		int32 result = Bfile_CreateEntry_OS(saveStateName, CREATEMODE_FILE, (size_t*) &Size);
-		if (result != 0) {
-			return false;
-		}
-
-		fileID = Bfile_OpenFile_OS(saveStateName, WRITE, 0);
-		if (fileID < 0) {
-			return false;
+		size_t createSize = Size;
+		int32 result = Bfile_CreateEntry_OS(saveStateName, CREATEMODE_FILE, &createSize);
+		if (result == 0) {
+			fileID = Bfile_OpenFile_OS(saveStateName, WRITE, 0);
 		}
 	}
 
-	// prepare data for actual writing
-	mainCPU.resolveToP();
+	// single flash write of the whole image
+	bool success = false;
+	if (fileID >= 0) {
+		success = Bfile_WriteFile_OS(fileID, state, Size) >= 0;
+		Bfile_CloseFile_OS(fileID);
+	}
 
-	fceuxFile.fileID = fileID;
-	bool success = fceuxFile.WriteState();
-	Bfile_CloseFile_OS(fileID);
+	free(state);
 	return success;
-}
\ No newline at end of file
+}
@@ -0,0 +1,199 @@
+
+// Host render thread, consumes per scanline PPU snapshots posted by nes_ppu::step
+
+#include "platform.h"
+#include "debug.h"
+#include "nes.h"
+
+#if PPU_RENDER_THREAD
+
+#include <windows.h>
+#include "render_thread.h"
+
+nes_render_thread nesRenderThread;
+
+static DWORD WINAPI RenderThreadProc(LPVOID) {
+	nesRenderThread.run();
+	return 0;
+}
+
+void nes_render_thread::start() {
+	DebugAssert(thread == nullptr);
+
+	head = 0;
+	tail = 0;
+	postedFrames = 0;
+	renderedFrames = 0;
+	curGeneration = -1;
+	nextSerial = 1;
+	lastSerial = 0;
+	bStop = false;
+
+	for (int i = 0; i < RENDER_GENERATIONS; i++) {
+		generations[i].serial = 0;
+		generations[i].lastUse = uint32(-1);
+	}
+
+	// the render thread PPU only ever sees snapshot state
+	ppu.init();
+	ppu.scanlineBuffer = (uint8*) scanlineBuffer;
+	ppu.scanlineOffset = nesPPU.scanlineOffset;
+	memcpy(ppu.rgbPaletteBank, nesPPU.rgbPaletteBank, sizeof(ppu.rgbPaletteBank));
+
+	thread = CreateThread(NULL, 0, RenderThreadProc, NULL, 0, NULL);
+}
+
+void nes_render_thread::stop() {
+	if (thread == nullptr) {
+		return;
+	}
+
+	sync();
+
+	bStop = true;
+	WaitForSingleObject((HANDLE) thread, INFINITE);
+	CloseHandle((HANDLE) thread);
+	thread = nullptr;
+}
+
+void nes_render_thread::sync() {
+	while (tail != head) {
+		Sleep(0);
+	}
+
+	// memory may be changed wholesale after a sync (reset, state load), so don't trust the last copy
+	curGeneration = -1;
+}
+
+nes_scanline_snapshot& nes_render_thread::beginPost() {
+	// wait for space in the ring
+	while (head - tail >= RENDER_RING_SIZE) {
+		Sleep(0);
+	}
+
+	return ring[head & (RENDER_RING_SIZE - 1)];
+}
+
+void nes_render_thread::endPost() {
+	// publish the snapshot only after it has been fully written
+	MemoryBarrier();
+	head = head + 1;
+}
+
+void nes_render_thread::newGeneration(const nes_ppu& fromPPU) {
+	// find the next generation no longer referenced by any unrendered snapshot
+	int next = curGeneration;
+	for (int tries = 1; ; tries++) {
+		next = (next + 1) % RENDER_GENERATIONS;
+		if (next != curGeneration && int32(generations[next].lastUse - tail) < 0) {
+			break;
+		}
+		if (tries % RENDER_GENERATIONS == 0) {
+			Sleep(0);
+		}
+	}
+
+	nes_render_generation& gen = generations[next];
+	memcpy(gen.nameTables, fromPPU.nameTables, sizeof(gen.nameTables));
+	for (int i = 0; i < 8; i++) {
+		memcpy(gen.chr + 0x400 * i, fromPPU.chrPages[i], 0x400);
+	}
+	memcpy(gen.palette, fromPPU.palette, sizeof(gen.palette));
+	memcpy(gen.oam, fromPPU.oam, sizeof(gen.oam));
+	gen.serial = nextSerial++;
+
+	curGeneration = next;
+	genNameTables = fromPPU.nameTables;
+	memcpy(genChrPages, fromPPU.chrPages, sizeof(genChrPages));
+}
+
+void nes_render_thread::postScanline(nes_ppu& fromPPU) {
+	if (curGeneration < 0 || fromPPU.dirtyVideoMemory || fromPPU.nameTables != genNameTables ||
+		memcmp(fromPPU.chrPages, genChrPages, sizeof(genChrPages))) {
+		newGeneration(fromPPU);
+		fromPPU.dirtyVideoMemory = false;
+	}
+
+	nes_scanline_snapshot& snapshot = beginPost();
+	snapshot.scanline = fromPPU.scanline;
+	snapshot.generation = curGeneration;
+	snapshot.PPUCTRL = fromPPU.PPUCTRL;
+	snapshot.PPUMASK = fromPPU.PPUMASK;
+	snapshot.SCROLLX = fromPPU.SCROLLX;
+	snapshot.mirror = fromPPU.mirror;
+	snapshot.scrollY = fromPPU.scrollY;
+	snapshot.flipY = fromPPU.flipY;
+	snapshot.frameCounter = fromPPU.frameCounter;
+	generations[curGeneration].lastUse = head;
+	endPost();
+}
+
+void nes_render_thread::postFrameEnd(const nes_ppu& fromPPU) {
+	nes_scanline_snapshot& snapshot = beginPost();
+	snapshot.scanline = 0;
+	snapshot.frameCounter = fromPPU.frameCounter;
+	endPost();
+
+	// stay at most one frame behind
+	postedFrames++;
+	while (postedFrames - renderedFrames > 1) {
+		Sleep(0);
+	}
+}
+
+void nes_render_thread::renderSnapshot(const nes_scanline_snapshot& snapshot) {
+	const nes_render_generation& gen = generations[snapshot.generation];
+	if (gen.serial != lastSerial) {
+		ppu.nameTables = (nes_nametable*) gen.nameTables;
+		ppu.mapChrPages(0, (uint8*) gen.chr, 8);
+		memcpy(ppu.palette, gen.palette, sizeof(ppu.palette));
+		memcpy(ppu.oam, gen.oam, sizeof(ppu.oam));
+		ppu.dirtyPalette = true;
+		ppu.dirtyOAM = true;
+		lastSerial = gen.serial;
+	}
+
+	if ((snapshot.PPUCTRL ^ ppu.PPUCTRL) & PPUCTRL_SPRSIZE) {
+		ppu.dirtyOAM = true;
+	}
+
+	ppu.scanline = snapshot.scanline;
+	ppu.PPUCTRL = snapshot.PPUCTRL;
+	ppu.PPUMASK = snapshot.PPUMASK;
+	ppu.selectPaletteBank();
+	ppu.SCROLLX = snapshot.SCROLLX;
+	ppu.mirror = snapshot.mirror;
+	ppu.scrollY = snapshot.scrollY;
+	ppu.flipY = snapshot.flipY;
+	ppu.causeDecrement = false;		// applied on the emulation thread
+	ppu.frameCounter = snapshot.frameCounter;
+	ppu.updateRenderScanline();
+
+	ppu.renderVisibleScanline();
+}
+
+void nes_render_thread::run() {
+	while (!bStop) {
+		if (tail == head) {
+			Sleep(0);
+			continue;
+		}
+
+		// make sure the snapshot contents are visible before reading them
+		MemoryBarrier();
+		const nes_scanline_snapshot& snapshot = ring[tail & (RENDER_RING_SIZE - 1)];
+
+		if (snapshot.scanline == 0) {
+			ppu.finishFrame(false);
+			ppu.SetPPUSTATUS(0);
+			renderedFrames = renderedFrames + 1;
+		} else {
+			renderSnapshot(snapshot);
+		}
+
+		MemoryBarrier();
+		tail = tail + 1;
+	}
+}
+
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "nes.h"
+
+// Pipelined scanline rendering for the host build. The emulation thread captures the PPU state of each visible
+// scanline and a worker thread renders and resolves it, running up to one frame behind.
+
+#if PPU_RENDER_THREAD
+
+#define RENDER_RING_SIZE 1024			// scanline snapshots in flight (power of 2)
+#define RENDER_GENERATIONS 32			// copies of PPU memory in flight
+
+// copy of the PPU memory scanlines read, taken again only when something in it was written (copy on write)
+struct nes_render_generation {
+	nes_nametable nameTables[4];
+	uint8 chr[0x2000];
+	uint8 palette[0x20];
+	uint8 oam[0x100];
+
+	// unique id of the copy currently held
+	uint32 serial;
+
+	// ring sequence of the last snapshot that references this generation
+	volatile uint32 lastUse;
+};
+
+// per scanline PPU state, everything else is in the referenced generation
+struct nes_scanline_snapshot {
+	uint16 scanline;				// 0 marks the end of a frame
+	uint16 generation;
+	uint8 PPUCTRL;
+	uint8 PPUMASK;
+	uint8 SCROLLX;
+	uint8 mirror;
+	int16 scrollY;
+	bool flipY;
+	uint32 frameCounter;
+};
+
+struct nes_render_thread {
+	void start();
+	void stop();
+
+	// waits until every posted scanline has been rendered (before anything else draws to VRAM)
+	void sync();
+
+	// whether scanlines should be posted (MMC2/4 latches have to stay on the emulation thread)
+	bool isActive() const {
+		return thread != nullptr && nesCart.renderLatch == NULL;
+	}
+
+	// emulation thread side, called from nes_ppu::step
+	void postScanline(nes_ppu& ppu);
+	void postFrameEnd(const nes_ppu& ppu);
+
+	// render thread side
+	void run();
+
+private:
+	void newGeneration(const nes_ppu& ppu);
+	nes_scanline_snapshot& beginPost();
+	void endPost();
+	void renderSnapshot(const nes_scanline_snapshot& snapshot);
+
+	void* thread;
+	volatile bool bStop;
+
+	nes_scanline_snapshot ring[RENDER_RING_SIZE];
+	volatile uint32 head;			// written by the emulation thread
+	volatile uint32 tail;			// written by the render thread
+
+	nes_render_generation generations[RENDER_GENERATIONS];
+	int curGeneration;
+	uint32 nextSerial;
+	const nes_nametable* genNameTables;
+	const uint8* genChrPages[8];
+
+	// frames posted / presented
+	uint32 postedFrames;
+	volatile uint32 renderedFrames;
+
+	// render thread's own PPU the snapshots are applied to
+	nes_ppu ppu;
+	uint32 lastSerial;
+	uint32 scanlineBuffer[(256 + 16 * 2) / 4];		// words for alignment
+};
+
+extern nes_render_thread nesRenderThread;
+
+#endif
@@ -30,7 +30,7 @@ static int curDMABuffer = 0;
 unsigned char scanlineBufferPtr[256 + 16 * 2];
 
 // resolve assembly defines used by various .S files
-uint16* ppu_workingPalette = &nesPPU.workingPalette[0];
+uint16* ppu_workingPalette = &nesPPU.workingPaletteBank[0][0];
 unsigned char* ppu_scanlineBuffer = &scanlineBufferPtr[0];
 
 void nes_ppu::initScanlineBuffer() {
@@ -206,6 +206,9 @@ func_renderScanline interlaced43Funcs[4] = {
 void nes_ppu::resolveScanline(int scrollOffset) {
 	TIME_SCOPE();
 
+	// the assembly resolvers read the palette through this, follow the currently selected bank
+	ppu_workingPalette = workingPalette;
+
 	if (nesSettings.GetSetting(ST_StretchScreen) == 1) {
 		const unsigned int bufferLines = 12;	// 600 bytes * 12 lines = 7200
 
@@ -315,8 +318,10 @@ void nes_ppu::finishFrame(bool bSkippedFrame) {
 				int rtcBackup = RTC_GetTicks();
 				int maxIter = 1000;
 				while (tmu1Clocks < accumulatedSimTime && RTC_GetTicks() - rtcBackup < 10 && maxIter--) {
-					// sleep .1 milliseconds at a time til we are ready for the frame
-					CMT_Delay_micros(100);
+					// spend the wait reading predicted banks, otherwise sleep .1 milliseconds at a time til we are ready for the frame
+					if (!nesCart.PrefetchIdle()) {
+						CMT_Delay_micros(100);
+					}
 					tmu1Clocks = counterStart - REG_TMU_TCNT_1;
 
 					condSoundUpdate();
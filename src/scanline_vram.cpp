@@ -8,25 +8,34 @@
 #include "settings.h"
 #include "imageDraw.h"
 #include "frontend.h"
+#include "capture_thread.h"
 
 // used for direct render of frame count
 #include "calctype/calctype.h"
 #include "calctype/fonts/arial_small/arial_small.h"	
 
-static unsigned char scanlineBufferMem[256 + 16 * 2] = { 0 }; 
-
 void nes_ppu::initScanlineBuffer() {
-	nesPPU.scanlineBuffer = scanlineBufferMem;
+	scanlineBuffer = nesMachine.scanlineBufferMem;
 }
 
 void nes_ppu::resolveScanline(int scrollOffset) {
 	TIME_SCOPE();
 
-	if (nesPPU.scanline >= 13 && nesPPU.scanline <= 228) {
+#if CAPTURE_THREAD
+	// resolved straight into the capture's frame, unscaled
+	if (uint16* captureRow = nesCapture.videoRow(scanline)) {
+		const unsigned char* captureSrc = &scanlineBuffer[8 + scrollOffset];
+		for (int i = 0; i < CAPTURE_WIDTH; i++) {
+			captureRow[i] = workingPalette[captureSrc[i] >> 1];
+		}
+	}
+#endif
+
+	if (scanline >= 13 && scanline <= 228) {
 		if (nesSettings.GetSetting(ST_StretchScreen) == 1) {
-			unsigned short* scanlineDest = ((unsigned short*)GetVRAMAddress()) + (nesPPU.scanline - 13) * 384 + 42 + scanlineOffset;
-			unsigned char* scanlineSrc = &nesPPU.scanlineBuffer[8 + scrollOffset];	// with clipping
-			const int interlacePixel = (nesPPU.frameCounter + nesPPU.scanline) & 3;
+			unsigned short* scanlineDest = ((unsigned short*)GetVRAMAddress()) + (scanline - 13) * 384 + 42 + scanlineOffset;
+			unsigned char* scanlineSrc = &scanlineBuffer[8 + scrollOffset];	// with clipping
+			const int interlacePixel = (frameCounter + scanline) & 3;
 			for (int i = 0; i < 60; i++) {
 				const uint16 pixels[4] = {
 					workingPalette[(*scanlineSrc++) >> 1],
@@ -41,9 +50,9 @@ void nes_ppu::resolveScanline(int scrollOffset) {
 				}
 			}
 		} else if (nesSettings.GetSetting(ST_StretchScreen) == 2) {
-			unsigned short* scanlineDest = ((unsigned short*)GetVRAMAddress()) + (nesPPU.scanline - 13) * 384 + 12 + scanlineOffset;
-			unsigned char* scanlineSrc = &nesPPU.scanlineBuffer[8 + scrollOffset];	// with clipping
-			const bool bInterlace = (nesPPU.frameCounter + nesPPU.scanline) & 1;
+			unsigned short* scanlineDest = ((unsigned short*)GetVRAMAddress()) + (scanline - 13) * 384 + 12 + scanlineOffset;
+			unsigned char* scanlineSrc = &scanlineBuffer[8 + scrollOffset];	// with clipping
+			const bool bInterlace = (frameCounter + scanline) & 1;
 			for (int i = 0; i < 120; i++) {
 				const uint16 pixel1 = workingPalette[(*scanlineSrc++) >> 1];
 				const uint16 pixel2 = workingPalette[(*scanlineSrc++) >> 1];
@@ -52,8 +61,8 @@ void nes_ppu::resolveScanline(int scrollOffset) {
 				*(scanlineDest++) = pixel2;
 			}
 		} else {
-			unsigned short* scanlineDest = ((unsigned short*)GetVRAMAddress()) + (nesPPU.scanline - 13) * 384 + 72 + scanlineOffset;
-			unsigned char* scanlineSrc = &nesPPU.scanlineBuffer[8 + scrollOffset];	// with clipping
+			unsigned short* scanlineDest = ((unsigned short*)GetVRAMAddress()) + (scanline - 13) * 384 + 72 + scanlineOffset;
+			unsigned char* scanlineSrc = &scanlineBuffer[8 + scrollOffset];	// with clipping
 			for (int i = 0; i < 240; i++, scanlineSrc++) {
 				*(scanlineDest++) = workingPalette[(*scanlineSrc) >> 1];
 			}
@@ -103,6 +112,10 @@ void nes_ppu::finishFrame(bool bSkippedFrame) {
 		return;
 	}
 
+#if CAPTURE_THREAD
+	nesCapture.frameFinished();
+#endif
+
 #if DEBUG
 	char buffer[32];
 	sprintf(buffer, "%d   ", frameCounter);
@@ -61,6 +61,9 @@ struct TimedInstance {
 
 #define TIME_SCOPE() static ScopeTimer __timer(__FUNCTION__, __LINE__); TimedInstance __timeMe(&__timer);
 #define TIME_SCOPE_NAMED(Name) static ScopeTimer __timer(#Name, __LINE__); TimedInstance __timeMe(&__timer);
+
+// event counter (shown under Num Hits) instead of a timed scope
+#define COUNT_SCOPE_NAMED(Name, Amount) { static ScopeTimer __counter(#Name, __LINE__); __counter.numCounts += (Amount); }
 #else
 struct ScopeTimer {
 	static void InitSystem() {}
@@ -73,4 +76,5 @@ struct ScopeTimer {
 #ifndef TIME_SCOPE
 #define TIME_SCOPE() 
 #define TIME_SCOPE_NAMED(Name) 
+#define COUNT_SCOPE_NAMED(Name, Amount)
 #endif
\ No newline at end of file
@@ -110,6 +110,20 @@ static const char* ClockOptions[] = {
 	"12 Hour",
 };
 
+static const char* RewindOptions[] = {
+	"Off",
+	"Short",
+	"Medium",
+	"Long",
+};
+
+static const char* RunAheadOptions[] = {
+	"Off",
+	"1 Frame",
+	"2 Frames",
+	"3 Frames",
+};
+
 static SettingInfo infos[] = {
 	{ ST_AutoSave,			SG_Deprecated,	false,	0,	2,	"Auto Save",		OffOn,				""}, // decided to go with always auto SRAM save, manual state save
 	{ ST_OverClock,			SG_System,		true,   0,  3,  "Overclock",		OverclockOptions,	"Increase calculator clock speed to\nimprove performance (costs battery)"},
@@ -120,13 +134,16 @@ static SettingInfo infos[] = {
 	{ ST_Palette,			SG_Video,		true,	0,	4,	"Palette",			PaletteOptions,		""},
 	{ ST_Background,		SG_Video,		true,	0,	4,	"Background",		BackgroundOptions,	"Select the background behind the\ngame screen when playing"},
 	{ ST_SoundEnabled,		SG_Sound,		true,	0,	2,	"Sound",			OffOn,				"Enable sound. Requires a 2.5mm\nto 3.5 mm adaptor in top port"},
-	{ ST_SoundQuality,		SG_Sound,		true,	0,  2,  "Extra FX",			OffOn,				"Enable extra sound processing.\nCloser emulation at cost of speed."},
+	{ ST_SoundQuality,		SG_Sound,		true,	0,  2,  "Extra FX",			OffOn,				"Band limited sound synthesis.\nCleaner sound at cost of speed."},
 	{ ST_DimScreen,			SG_Video,		false,	0,  2,  "Dim Screen",		OffOn,				""}, // now use the brightness option
 	{ ST_StretchScreen,		SG_Video,		true,	0,  3,  "Stretch",			StretchOptions,		"Whether to stretch game screen\n4:3 is closest to original system"},
 	{ ST_ShowClock,			SG_Video,		true,	0,  3,  "Show Clock",		ClockOptions,		"Enable to show current system\ntime in bottom corner."},
 	{ ST_Brightness,		SG_Video,		true,	5, 11,  "Brightness",		nullptr,			""},
 	{ ST_Color,				SG_Video,		true,	5, 11,  "Color",			nullptr,			""},
 	{ ST_ShowFPS,			SG_System,		true,	0,  2,  "Show FPS",			OffOn,				"Enable to show current frames\nper second in bottom right."},
+	{ ST_Rewind,			SG_System,		true,	0,  4,  "Rewind",			RewindOptions,		"Memory kept for rewinding while\nthe rewind key is held"},
+	{ ST_RunAhead,			SG_System,		false,	0,  4,  "Run Ahead",		RunAheadOptions,	"Frames to emulate ahead to hide\nthe game's own input lag"}, // host only
+	{ ST_ExpansionSound,	SG_Sound,		true,	1,  2,  "Cart Chips",		OffOn,				"Sound chips on some carts (the\nSunsoft 5B in Gimmick!, FME-7)"},
 };
 
 const char* EmulatorSettings::GetSettingName(SettingType setting) {
@@ -175,6 +192,7 @@ void EmulatorSettings::SetDefaults() {
 	keyMap[NES_FASTFORWARD] = 57;	// '^'
 	keyMap[NES_VOL_UP] = 42;	// '+'
 	keyMap[NES_VOL_DOWN] = 32;	// '-'
+	keyMap[NES_REWIND] = 53;		// 'R'
 
 	// simulator only defaults
 #if TARGET_WINSIM
@@ -213,9 +231,15 @@ void EmulatorSettings::Load() {
 				uint8 value = contents[cur++];
 				values[setting] = value;
 			}
+
+			// Cart Chips used to be Off/Lite/Full, and only the 3 channel Sunsoft 5B is emulated
+			if (values[ST_ExpansionSound] > 1) {
+				values[ST_ExpansionSound] = 1;
+			}
 			uint8 numKeys = contents[cur++];
-			if (numKeys == NES_MAX_KEYS) {
-				for (int i = 0; i < NES_MAX_KEYS; i++) {
+			// older settings don't have the newest keys, those keep their defaults
+			if (numKeys <= NES_MAX_KEYS) {
+				for (int i = 0; i < numKeys; i++) {
 					keyMap[i] = contents[cur++];
 				}
 			}
@@ -254,6 +278,10 @@ void EmulatorSettings::Load() {
 	} else {
 		infos[ST_OverClock].available = true;
 	}
+
+#if TARGET_WINSIM
+	infos[ST_RunAhead].available = true;
+#endif
 }
 
 const char* EmulatorSettings::GetContinueFile() {
@@ -20,6 +20,9 @@ enum SettingType {
 	ST_Brightness,
 	ST_Color,
 	ST_ShowFPS,
+	ST_Rewind,
+	ST_RunAhead,
+	ST_ExpansionSound,
 
 	MAX_SETTINGS
 };
@@ -33,50 +36,6 @@ enum SettingGroup {
 	SG_Deprecated
 };
 
-struct GameGenieCode {
-	GameGenieCode() {
-		clear();
-	}
-
-	// return false if invalid code is set
-	bool set(const char* withValue);
-	void clear();
-
-	bool isActive() const {
-		return code[0] != 0;
-	}
-
-	unsigned int getEffAddr() const {
-		return cachedAddr;
-	}
-
-	uint8 getCmpValue() const {
-		return cachedCmp;
-	}
-
-	uint8 getSetValue() const {
-		return cachedSet;
-	}
-
-	bool doCompare() const {
-		return bDoCompare;
-	}
-
-	const char* getText() const {
-		return code;
-	}
-
-	static void load(const char* romFile);
-private:
-	bool update();
-
-	char code[9];
-	unsigned char cachedCmp;
-	unsigned char cachedSet;
-	bool bDoCompare;
-	unsigned int cachedAddr;
-};
-
 struct EmulatorSettings {
 	int32 keyMap[NES_MAX_KEYS];
 
@@ -84,8 +43,6 @@ struct EmulatorSettings {
 
 	uint32 faqPosition;
 
-	GameGenieCode codes[10];
-
 	void SetDefaults();
 	void Load();
 	void Save();